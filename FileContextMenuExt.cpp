@@ -22,39 +22,229 @@ of selected files.
 
 #include "FileContextMenuExt.h"
 #include "resource.h"
+#include "BatchChecker.h"
+#include "DropFileList.h"
+#include "DuplicateFinder.h"
+#include "HashCache.h"
+#include "Hasher.h"
+#include "IoScheduler.h"
+#include "ParallelSort.h"
+#include "ResultChannel.h"
+#include "ResultExport.h"
+#include "TextFormat.h"
+#include "TreeWalker.h"
+#include "Reg.h"
 #include <strsafe.h>
+#include <commctrl.h>
+#include <commdlg.h>
 #include <Shlwapi.h>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <functional>
+#include <memory>
 #include <sstream>
+#include <unordered_map>
 
 #include <tchar.h>
-#include <fstream>
-
-#include "threadpool.h"
 
 #pragma comment(lib, "shlwapi.lib")
+#pragma comment(lib, "comdlg32.lib")
 
 
 extern HINSTANCE g_hInst;
 extern long g_cDllRef;
 
 #define IDM_DISPLAY             0  // The command's identifier offset
+#define IDM_FIND_DUPLICATES     1
+#define IDM_EXPORT              2
+
+//! Haponov: results not finished within this time are shown in a dialog
+//! that fills in as they come
+const DWORD progressDialogDelayMs = 300;
+
+namespace
+{
+    //! Haponov: loaded at run time, version 5 of comctl32 does not have it
+    typedef HRESULT (WINAPI *TaskDialogIndirectProc)(const TASKDIALOGCONFIG*, int*, int*, BOOL*);
+
+    //! Haponov: TaskDialogIndirect is only in version 6 of the common
+    //! controls, which Explorer uses; the module to free after the dialog,
+    //! NULL if there is no task dialog
+    HMODULE loadTaskDialog(TaskDialogIndirectProc& taskDialogIndirect)
+    {
+        HMODULE hComctl = LoadLibraryW(L"comctl32.dll");
+        if (!hComctl)
+            return NULL;
+        taskDialogIndirect = reinterpret_cast<TaskDialogIndirectProc>(
+            GetProcAddress(hComctl, "TaskDialogIndirect"));
+        if (!taskDialogIndirect)
+        {
+            FreeLibrary(hComctl);
+            return NULL;
+        }
+        return hComctl;
+    }
+
+    //! Haponov: called when the work dialog is created and on every tick
+    //! of its timer; true when the work is done and the dialog may close
+    typedef std::function<bool(HWND)> WorkTick;
+
+    struct WorkDialog
+    {
+        const WorkTick* tick;
+        bool marquee;
+    };
+
+    HRESULT CALLBACK workDialogCallback(HWND hwnd, UINT uNotification,
+        WPARAM wParam, LPARAM lParam, LONG_PTR dwRefData)
+    {
+        const WorkDialog& dialog = *reinterpret_cast<const WorkDialog*>(dwRefData);
+        if (uNotification == TDN_CREATED && dialog.marquee)
+            SendMessage(hwnd, TDM_SET_PROGRESS_BAR_MARQUEE, TRUE, 0);
+        //! Haponov: the dialog closes itself the way Cancel would, the
+        //! caller tells the two apart by the state of its work
+        if ((uNotification == TDN_CREATED || uNotification == TDN_TIMER) && (*dialog.tick)(hwnd))
+            SendMessage(hwnd, TDM_CLICK_BUTTON, IDCANCEL, 0);
+        return S_OK;
+    }
+
+    //! Haponov: a dialog with a Cancel button and a progress bar - a moving
+    //! one with marquee - for work running on the pool, shown until tick
+    //! says the work is done or the user cancels it; false if there is no
+    //! task dialog, then the caller waits without one
+    bool showWorkDialog(HWND hWnd, const wchar_t* instruction, bool marquee, const WorkTick& tick)
+    {
+        TaskDialogIndirectProc taskDialogIndirect;
+        HMODULE hComctl = loadTaskDialog(taskDialogIndirect);
+        if (!hComctl)
+            return false;
+
+        WorkDialog dialog = { &tick, marquee };
+        TASKDIALOGCONFIG config = { sizeof(config) };
+        config.hwndParent = hWnd;
+        config.hInstance = g_hInst;
+        config.dwFlags = TDF_CALLBACK_TIMER | TDF_ALLOW_DIALOG_CANCELLATION |
+                         (marquee ? TDF_SHOW_MARQUEE_PROGRESS_BAR : TDF_SHOW_PROGRESS_BAR);
+        config.dwCommonButtons = TDCBF_CANCEL_BUTTON;
+        config.pszWindowTitle = L"AvidDialog";
+        config.pszMainInstruction = instruction;
+        config.pfCallback = &workDialogCallback;
+        config.lpCallbackData = reinterpret_cast<LONG_PTR>(&dialog);
+        HRESULT hr = taskDialogIndirect(&config, NULL, NULL, NULL);
+
+        FreeLibrary(hComctl);
+        return SUCCEEDED(hr);
+    }
+
+    //! Haponov: checksums and algorithm names are plain ASCII
+    void appendWide(std::wstring& text, const char* ascii)
+    {
+        for (; *ascii; ++ascii)
+            text += static_cast<wchar_t>(static_cast<unsigned char>(*ascii));
+    }
+
+    //! Haponov: decimal number with a space between groups of three digits,
+    //! sizes over 4 GB included
+    void appendGrouped(std::wstring& text, std::uint64_t value)
+    {
+        char grouped[TextFormat::groupedSize];
+        TextFormat::grouped(value, grouped);
+        appendWide(text, grouped);
+    }
+
+    //! Haponov: CreateFileW and the volume functions take a path of MAX_PATH
+    //! characters or more only with the \\?\ prefix (\\?\UNC\ for a
+    //! share); Explorer passes full paths, which is what the prefix needs.
+    //! The path is copied to paths once, with the prefix when it needs it
+    const wchar_t* addPath(StringArena& paths, const wchar_t* path, std::size_t length)
+    {
+        std::size_t skip;
+        const wchar_t* prefix = length < MAX_PATH ? NULL : File::longPathPrefix(path, length, skip);
+        if (!prefix)
+            return paths.add(path, length);
+        return paths.add(prefix, std::wcslen(prefix), path + skip, length - skip);
+    }
+
+    //! Haponov: the path as the user knows it, without the prefix addPath
+    //! may have put in front of it
+    void appendDisplayPath(std::wstring& text, const wchar_t* path)
+    {
+        bool share;
+        const wchar_t* rest = File::withoutLongPrefix(path, share);
+        if (share)
+            text += L'\\';
+        text += rest;
+    }
+
+    std::string narrow(const std::wstring& wide)
+    {
+        std::string ascii;
+        ascii.reserve(wide.size());
+        for (wchar_t c : wide)
+            ascii += c < 0x80 ? static_cast<char>(c) : '?';
+        return ascii;
+    }
+}
 
 FileContextMenuExt::FileContextMenuExt(void) : m_cRef(1),
 //! Haponov change names
 
+m_paths(m_memory),
+m_files(ArenaAllocator<FileRecord>(m_memory)),
 m_pszMenuText(L"&Avid the Best"),
 m_pszVerb("cppdisplay"),
 m_pwszVerb(L"cppdisplay"),
 m_pszVerbCanonicalName("CppDisplayFileName"),
 m_pwszVerbCanonicalName(L"CppDisplayFileName"),
 m_pszVerbHelpText("Avid the Best"),
-m_pwszVerbHelpText(L"Avid the Best")
+m_pwszVerbHelpText(L"Avid the Best"),
+m_pszDuplicatesMenuText(L"Avid: find &duplicates"),
+m_pszDuplicatesVerb("cppfindduplicates"),
+m_pwszDuplicatesVerb(L"cppfindduplicates"),
+m_pwszDuplicatesVerbCanonicalName(L"CppFindDuplicates"),
+m_pwszDuplicatesVerbHelpText(L"Find the selected files that are copies of each other"),
+m_pszExportMenuText(L"Avid: export results..."),
+m_pszExportVerb("cppexport"),
+m_pwszExportVerb(L"cppexport"),
+m_pwszExportVerbCanonicalName(L"CppExportResults"),
+m_pwszExportVerbHelpText(L"Save the checksums of the selected files to a CSV, NDJSON or JSON file"),
+m_processingStarted(false),
+m_deadlineArmed(false),
+m_hashAlgorithm(HashAlaSum),
+m_timeoutSeconds(0),
+m_ioAtStart(),
+m_dialogVersion(0),
+m_order(ArenaAllocator<std::size_t>(m_memory)),
+m_orderReady(false),
+m_checker(ThreadPool::shared(), m_memory, m_results, m_batch, &HashCache::shared())
 //! end of Haponov change names
 {
     InterlockedIncrement(&g_cDllRef);
 
+    //! Haponov: the checksum algorithm is a per-user setting, e.g.
+    //! reg add HKCU\Software\AVID-COM /v ChecksumAlgorithm /d crc32c
+    //! the ala checksum stays the default
+    wchar_t algorithmName[32];
+    HashAlgorithm algorithm;
+    if (SUCCEEDED(GetUserSetting(L"ChecksumAlgorithm", algorithmName, sizeof(algorithmName))) &&
+        Hasher::fromName(narrow(algorithmName), algorithm))
+        m_hashAlgorithm = algorithm;
+
+    //! Haponov: size limit of the checksum cache in MB, 0 turns it off
+    wchar_t cacheLimit[16];
+    if (SUCCEEDED(GetUserSetting(L"ChecksumCacheLimitMB", cacheLimit, sizeof(cacheLimit))))
+        HashCache::shared().setSizeLimit(static_cast<std::uint64_t>(std::wcstoul(cacheLimit, NULL, 10)) << 20);
+
+    //! Haponov: files not checked within this many seconds are given up,
+    //! 0 - no limit
+    wchar_t timeout[16];
+    if (SUCCEEDED(GetUserSetting(L"ChecksumTimeoutSeconds", timeout, sizeof(timeout))))
+        m_timeoutSeconds = std::wcstoul(timeout, NULL, 10);
+
     // Load the bitmap for the menu item. 
     // If you want the menu item bitmap to be transparent, the color depth of 
     // the bitmap must not be greater than 8bpp.
@@ -64,6 +254,9 @@ m_pwszVerbHelpText(L"Avid the Best")
 
 FileContextMenuExt::~FileContextMenuExt(void)
 {
+    //! Haponov: background processing uses this object - let it finish
+    m_batch.wait();
+
     if (m_hMenuBmp)
     {
         DeleteObject(m_hMenuBmp);
@@ -87,137 +280,537 @@ std::wstring FileContextMenuExt::s2ws(const std::string & s)
 }
        */
 //! Haponov function - modified other msdn code sample
-BOOL FileContextMenuExt::GetCreationTime(HANDLE hFile, LPTSTR lpszString, DWORD dwSize)
+BOOL FileContextMenuExt::GetCreationTime(std::uint64_t creationTime, LPTSTR lpszString, DWORD dwSize)
 {
-    FILETIME ftCreate, ftAccess, ftWrite;
-    SYSTEMTIME stUTC, stLocal;
-    DWORD dwRet;
-
-    // Retrieve the file times for the file.
-    if (!GetFileTime(hFile, &ftCreate, &ftAccess, &ftWrite))
+    // Haponov: the time comes from File::info in ns since 1970 and is
+    // shown in local time, as "MM/DD/YYYY HH:MM"
+    char local[TextFormat::localTimeSize];
+    if (!TextFormat::localTime(creationTime, local))
         return FALSE;
+    std::wstring text;
+    appendWide(text, local);
+    return SUCCEEDED(StringCchCopy(lpszString, dwSize, text.c_str()));
+}
 
-    // Convert the creation time to local time.
-    FileTimeToSystemTime(&ftCreate, &stUTC);
-    SystemTimeToTzSpecificLocalTime(NULL, &stUTC, &stLocal);
+void FileContextMenuExt::OnVerbDisplayFileName(HWND hWnd)
+{
+    //! Haponov changes start here:
 
-    // Build a string showing the date and time.
-    dwRet = StringCchPrintfW(lpszString, dwSize, TEXT("%02d/%02d/%d %02d:%02d"),
-                             stLocal.wMonth, stLocal.wDay, stLocal.wYear, stLocal.wHour, stLocal.wMinute);
+    //! Haponov: the files are processed in background since QueryContextMenu;
+    //! a selection that is finished within a moment is shown in a message
+    //! box as before, a slower one in a dialog that fills in as results
+    //! come in - where there is no such dialog, all results are awaited
+    armDeadline();
+    startProcessingSelectedFiles();
+    if (!m_results.waitForAll(std::chrono::milliseconds(progressDialogDelayMs)) &&
+        showProgressDialog(hWnd))
+    {
+        if (m_results.progress().complete())
+            waitForSelectedFiles();
+        return;
+    }
+    waitForSelectedFiles();
 
-    if (S_OK == dwRet)
-        return TRUE;
-    else return FALSE;
+    //! Haponov: prepare message string to be sent to MessageBox
+    std::uint64_t version;
+    std::wstring sum = resultsText(version);
+    LPCTSTR msg = sum.c_str();
+    MessageBox(hWnd, msg, L"AvidDialog", MB_OK);
+    //! end of Haponov changes
 }
 
 //! Haponov function
-DWORD FileContextMenuExt::getCheckSum(std::wstring path)
+void FileContextMenuExt::OnVerbFindDuplicates(HWND hWnd)
 {
-    DWORD checksum = 0;
-    char byte;
-    std::ifstream in(path, std::ifstream::binary);
-    if (!in)
-        return 0;
-    else
+    //! Haponov: the checksums started for the "display" command when the
+    //! menu was shown would read every byte of every file - they are
+    //! stopped, and the sizes they found are kept; cancelled jobs end
+    //! within a block, so this wait is short
+    m_batch.cancel();
+    m_batch.wait();
+
+    //! Haponov: the search opens and reads the files, and finding their
+    //! devices may block on a network share - all of it runs on the pool;
+    //! a search finished within a moment is shown at once, a slower one
+    //! behind a dialog whose Cancel stops it
+    JobGroup search;
+    if (m_timeoutSeconds)
+        search.setDeadline(std::chrono::steady_clock::now() + std::chrono::seconds(m_timeoutSeconds));
+    std::wstring text;
+    std::atomic<bool> finished(false);
+    ThreadPool::shared().doJob(search, [this, &search, &text, &finished]()
+    {
+        findDuplicates(search.token(), text);
+        finished.store(true, std::memory_order_release);
+    });
+
+    for (DWORD waited = 0; waited < progressDialogDelayMs; waited += 10)
+    {
+        if (finished.load(std::memory_order_acquire))
+            break;
+        Sleep(10);
+    }
+    if (!finished.load(std::memory_order_acquire))
+        showWorkDialog(hWnd, L"Looking for copies...", true,
+            [&finished](HWND) { return finished.load(std::memory_order_acquire); });
+    //! Haponov: closed before the search was done - the user cancelled it
+    bool cancelled = !finished.load(std::memory_order_acquire);
+    if (cancelled)
+        search.cancel();
+    search.wait();
+    if (!cancelled)
+        MessageBox(hWnd, text.c_str(), L"AvidDialog", MB_OK);
+}
+
+//! Haponov function
+void FileContextMenuExt::findDuplicates(const CancellationToken& cancel, std::wstring& text)
+{
+    std::vector<FileRecord> records;
+    m_results.snapshot(records);
+    bool haveRecords = records.size() == m_files.size();
+
+    //------------------
+    //! Haponov: folders are not compared; a disk that seeks is read by
+    //! one thread, so a selection with a file on one is searched by one
+    std::vector<DuplicateFile> files;
+    std::vector<std::size_t> selected;
+    std::unordered_map<std::wstring, bool> folderParallel;
+    bool parallelReads = true;
+    for (std::size_t i = 0; i < m_files.size(); ++i)
+    {
+        const FileRecord& record = haveRecords ? records[i] : m_files[i];
+        bool described = record.stage == FileRecord::Described || record.stage == FileRecord::Checked;
+        if (record.directory || (!described && TreeWalker::isDirectory(record.path)))
+            continue;
+        DuplicateFile file = { record.path, record.size, described };
+        files.push_back(file);
+        selected.push_back(i);
+
+        std::wstring folder(record.path, record.nameStart);
+        auto known = folderParallel.find(folder);
+        if (known == folderParallel.end())
+            known = folderParallel.insert(std::make_pair(folder,
+                IoScheduler::shared().device(record.path).parallelReads())).first;
+        parallelReads = parallelReads && known->second;
+    }
+
+    DuplicateFinder finder(parallelReads ? &ThreadPool::shared() : NULL,
+        [this, &cancel](const File& file, const FileInfo& info, Digest& digest)
+        {
+            return m_checker.cachedCheckSum(file, info, DuplicateFinder::algorithm, false, cancel, digest);
+        });
+    std::vector<std::vector<std::size_t>> groups;
+    bool finished = finder.find(files, groups, cancel);
+
+    //------------------
+    //! Haponov: every group with the size of one copy and the full paths
+    //! of all of them - copies are usually in different folders
+    if (!finished)
+        text = L"(time limit reached - the search was stopped)";
+    else if (groups.empty())
+        text = L"No two of the selected files have the same content.";
+    for (std::size_t g = 0; finished && g < groups.size(); ++g)
     {
-        while (in)
+        const FileRecord& first = m_files[selected[groups[g][0]]];
+        if (g) text += L"\n\n";
+        appendGrouped(text, groups[g].size());
+        text += L" copies of ";
+        text += first.name();
+        text += L";   size: ";
+        appendGrouped(text, files[groups[g][0]].size);
+        text += L" bytes";
+        for (std::size_t index : groups[g])
         {
-            in.get(byte);
-            checksum += byte;
+            text += L"\n    ";
+            appendDisplayPath(text, m_files[selected[index]].path);
         }
     }
-    return checksum;
+
+    DuplicateCounters counters = finder.counters();
+    text += L"\n\nread: the first and last 64 KB of ";
+    appendGrouped(text, counters.edgeHashed);
+    text += L" files, the whole of ";
+    appendGrouped(text, counters.contentHashed);
+    text += L" files";
+    if (counters.unreadable)
+    {
+        text += L";   unreadable: ";
+        appendGrouped(text, counters.unreadable);
+    }
 }
 
-void FileContextMenuExt::OnVerbDisplayFileName(HWND hWnd)
+
+//! Haponov function
+void FileContextMenuExt::OnVerbExportResults(HWND hWnd)
 {
-    //! Haponov changes start here:
+    //------------------
+    //! Haponov: where to, and in which format - the type chosen in the
+    //! dialog, unless the name typed in has an extension of another one
+
+    std::vector<wchar_t> fileName(32768, L'\0');
+    StringCchCopy(fileName.data(), fileName.size(), L"checksums");
+    std::wstring folder;
+    if (!m_files.empty())
+        appendDisplayPath(folder, std::wstring(m_files[0].path, m_files[0].nameStart).c_str());
+
+    OPENFILENAMEW ofn = { sizeof(ofn) };
+    ofn.hwndOwner = hWnd;
+    ofn.lpstrFilter = L"CSV (*.csv)\0*.csv\0"
+                      L"NDJSON, a JSON object per line (*.ndjson)\0*.ndjson\0"
+                      L"JSON (*.json)\0*.json\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrFile = fileName.data();
+    ofn.nMaxFile = static_cast<DWORD>(fileName.size());
+    ofn.lpstrInitialDir = folder.empty() ? NULL : folder.c_str();
+    ofn.lpstrDefExt = L"csv";
+    ofn.Flags = OFN_EXPLORER | OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_NOCHANGEDIR;
+    if (!GetSaveFileNameW(&ofn))
+        return;
 
-    //! Haponov: create Message text from all strings of sortedFiles std::set
-    std::wstring sum;
-    std::set<std::wstring>::const_iterator i = sortedFiles.begin();
-    while (i != sortedFiles.end())
+    ExportFormat format = ofn.nFilterIndex == 2 ? ExportNdjson :
+                          ofn.nFilterIndex == 3 ? ExportJson : ExportCsv;
+    if (ofn.nFileExtension)
+        ResultExport::fromExtension(fileName.data() + ofn.nFileExtension, format);
+
+    std::wstring path(fileName.data());
+    File file;
+    if (!file.createForAppend(File::longPath(path)))
     {
-        sum += *i;
-        if (++i != sortedFiles.end()) sum += L"\n\n";
+        std::wstring message = L"Cannot create " + path;
+        MessageBox(hWnd, message.c_str(), L"AvidDialog", MB_OK | MB_ICONERROR);
+        return;
     }
-    //! Haponov: prepare message string to be sent to MessageBox
-    LPCTSTR msg = sum.c_str();
-    MessageBox(hWnd, msg, L"AvidDialog", MB_OK);
-    //! end of Haponov changes
+
+    //------------------
+    //! Haponov: every record goes to the file soon after it is finished,
+    //! in the order they finish, written by a job on the pool that takes
+    //! what finished since the last one - one such job at a time, queued
+    //! by the timer of the dialog; the shell thread only shows progress.
+    //! The records the time limit or Cancel stopped are written at the
+    //! end, as far as they got
+
+    armDeadline();
+    startProcessingSelectedFiles();
+    ResultExport writer(file, format, m_hashAlgorithm);
+    bool written = true;
+    BatchChecker::RecordFunc write = [&writer, &written](const FileRecord& record)
+    {
+        written = writer.write(record) && written;
+    };
+    JobGroup exporting;
+    std::atomic<bool> draining(true);
+    ThreadPool::shared().doJob(exporting, [this, &writer, &written, &write, &draining]()
+    {
+        written = writer.begin();
+        m_checker.collectFinished(write);
+        draining.store(false, std::memory_order_release);
+    });
+
+    WorkTick tick = [this, &exporting, &write, &draining](HWND hwnd)
+    {
+        if (!draining.exchange(true, std::memory_order_acq_rel))
+            ThreadPool::shared().doJob(exporting, [this, &write, &draining]()
+            {
+                m_checker.collectFinished(write);
+                draining.store(false, std::memory_order_release);
+            });
+        ResultProgress progress = m_results.progress();
+        if (hwnd)
+            SendMessage(hwnd, TDM_SET_PROGRESS_BAR_POS,
+                        progress.files ? progress.finished * 100 / progress.files : 100, 0);
+        return progress.complete() || m_batch.cancelled();
+    };
+    if (!m_results.waitForAll(std::chrono::milliseconds(progressDialogDelayMs)) &&
+        showWorkDialog(hWnd, L"Exporting the results...", false, tick))
+    {
+        //! Haponov: closed before every file was checked - Cancel
+        if (!tick(NULL))
+            m_batch.cancel();
+    }
+    else
+    {
+        //! Haponov: done within a moment, or no task dialog - wait here
+        std::uint64_t seen = m_results.version();
+        while (!tick(NULL))
+            seen = m_results.waitForChange(seen, std::chrono::milliseconds(200));
+    }
+    bool stopped = m_batch.cancelled();
+
+    //! Haponov: the cancelled jobs end within a block; the last job writes
+    //! whatever the batch left behind
+    waitForSelectedFiles();
+    exporting.wait();
+    ThreadPool::shared().doJob(exporting, [this, &writer, &written, &write, &file]()
+    {
+        m_checker.collectRest(write);
+        written = writer.end() && file.flush() && written;
+    });
+    exporting.wait();
+    file.close();
+
+    std::wstring message;
+    if (written)
+    {
+        appendGrouped(message, writer.records());
+        message += L" records written to ";
+        message += path;
+    }
+    else
+        message = L"Writing " + path + L" failed";
+    if (stopped)
+        message += L"\n\n(stopped - not every file was checked)";
+    MessageBox(hWnd, message.c_str(), L"AvidDialog", written ? MB_OK : MB_OK | MB_ICONERROR);
 }
 
 //! Haponov function
-void FileContextMenuExt::processSelectedFiles(std::wstring ws_name)
+void FileContextMenuExt::resultLine(const FileRecord& record, std::wstring& atLast)
 {
-    std::wstring atLast = ws_name;
-    
     //------------------
-    //! Haponov: get a wstring with filename only - WO full path
+    //! Haponov: filename only - WO full path
 
-    std::size_t found = atLast.find_last_of(L"/\\");
-    atLast = atLast.substr(found + 1);					
+    atLast += record.name();
 
-    //------------------
-    //! Haponov: create file handle for further usage
-
-    HANDLE hFile = CreateFile(ws_name.c_str(),
-        GENERIC_READ,
-        FILE_SHARE_READ,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
-    if (hFile == INVALID_HANDLE_VALUE)
-    {
-        atLast = L"error opening file";
+    if (record.stage == FileRecord::Failed)
+    {
+        atLast += L";   error opening file";
+        return;
+    }
+    if (record.stage == FileRecord::Waiting)
+    {
+        atLast += L";   waiting";
+        return;
+    }
+    if (record.directory)
+    {
+        //-------------------
+        // Haponov: a folder - what its tree holds, once it is walked
+        if (record.stage == FileRecord::Described)
+        {
+            //! Haponov: a walk the time limit stopped has no totals
+            atLast += m_batch.cancelled() ? L";   folder: stopped" : L";   folder: walking...";
+            return;
+        }
+        atLast += L";   folder: ";
+        appendGrouped(atLast, record.tree.files);
+        atLast += L" files in ";
+        appendGrouped(atLast, record.tree.directories);
+        atLast += L" folders;   size: ";
+        appendGrouped(atLast, record.size);
+        atLast += L" bytes;   combined checksum (";
+        appendWide(atLast, Hasher::name(m_hashAlgorithm));
+        atLast += L"): ";
+        wchar_t combined[17];
+        StringCchPrintfW(combined, ARRAYSIZE(combined), L"%016llx",
+                         static_cast<unsigned long long>(record.tree.checksum));
+        atLast += combined;
+        if (record.tree.unreadable)
+        {
+            atLast += L";   unreadable: ";
+            appendGrouped(atLast, record.tree.unreadable);
+        }
         return;
     }
 
     //-------------------
-    // Haponov: get a wstring with size of file
-
-    DWORD dwFileSize = GetFileSize(hFile, NULL);
-    std::wstring result_size = std::to_wstring(dwFileSize);
+    // Haponov: size of file, creation time of file and the checksum, the
+    // checksum follows the metadata
 
+    atLast += L";   size: ";
     // Haponov: put spaces into size - "   "
-    unsigned int curLength = result_size.length();
-    if (curLength > 3)
+    appendGrouped(atLast, record.size);
+
+    wchar_t temp_forCreationTime[TextFormat::localTimeSize] = L"";
+    GetCreationTime(record.creationTime, temp_forCreationTime, ARRAYSIZE(temp_forCreationTime));
+    atLast += L" bytes;   creation time: ";  	atLast += temp_forCreationTime; 
+
+    atLast += L"   checksum (";   appendWide(atLast, Hasher::name(m_hashAlgorithm));
+    atLast += L"): ";
+    if (record.stage == FileRecord::Described)
+        atLast += m_batch.cancelled() ? L"stopped" : L"computing...";
+    else if (record.haveChecksum)
+        appendWide(atLast, record.checksum().toString().c_str());
+    else
+        atLast += L"unavailable";
+}
+
+//! Haponov function
+std::wstring FileContextMenuExt::resultsText(std::uint64_t& version)
+{
+    std::vector<FileRecord> records;
+    version = m_results.snapshot(records);
+
+    //! Haponov: files are shown by name, in the order sorted once when
+    //! the batch was scheduled; before that no file is known anyway
+    bool ordered = m_orderReady.load(std::memory_order_acquire);
+    std::wstring sum;
+    for (std::size_t i = 0; i < records.size(); ++i)
     {
-        curLength -= 3;
-        for (int i=3; curLength < result_size.length(); i += 4, curLength -= 3)
-        {
-            if (curLength > result_size.length() || !curLength) break;
-            result_size.insert(result_size.end() - i, ' ');
-        }
+        std::size_t index = ordered ? m_order[i] : i;
+        if (i) sum += L"\n\n";
+        resultLine(records[index], sum);
     }
+    //! Haponov: the time limit cancels the files that are left
+    if (m_batch.cancelled())
+        sum += L"\n\n(time limit reached - not every file was checked)";
+    return sum;
+}
+
+//! Haponov function
+bool FileContextMenuExt::showProgressDialog(HWND hWnd)
+{
+    //! Haponov: without a task dialog the caller falls back to the
+    //! message box
+    TaskDialogIndirectProc taskDialogIndirect;
+    HMODULE hComctl = loadTaskDialog(taskDialogIndirect);
+    if (!hComctl)
+        return false;
+
+    m_dialogVersion = 0;
+    m_dialogStatus = L"Checking files...";
+    m_dialogText = resultsText(m_dialogVersion);
+
+    TASKDIALOGCONFIG config = { sizeof(config) };
+    config.hwndParent = hWnd;
+    config.hInstance = g_hInst;
+    config.dwFlags = TDF_CALLBACK_TIMER | TDF_SHOW_PROGRESS_BAR | TDF_ALLOW_DIALOG_CANCELLATION;
+    config.dwCommonButtons = TDCBF_OK_BUTTON;
+    config.pszWindowTitle = L"AvidDialog";
+    config.pszMainInstruction = m_dialogStatus.c_str();
+    config.pszContent = m_dialogText.c_str();
+    config.pfCallback = &FileContextMenuExt::progressDialogCallback;
+    config.lpCallbackData = reinterpret_cast<LONG_PTR>(this);
+    HRESULT hr = taskDialogIndirect(&config, NULL, NULL, NULL);
+
+    FreeLibrary(hComctl);
+    return SUCCEEDED(hr);
+}
+
+//! Haponov function
+HRESULT CALLBACK FileContextMenuExt::progressDialogCallback(HWND hwnd, UINT uNotification,
+    WPARAM wParam, LPARAM lParam, LONG_PTR dwRefData)
+{
+    //! Haponov: the timer ticks about every 200 ms while the dialog is up
+    if (uNotification == TDN_CREATED || uNotification == TDN_TIMER)
+        reinterpret_cast<FileContextMenuExt*>(dwRefData)->refreshProgressDialog(hwnd);
+    return S_OK;
+}
 
-    //------------------------
-    // Haponov: get a string with creation time of file
+//! Haponov function
+void FileContextMenuExt::refreshProgressDialog(HWND hwnd)
+{
+    ResultProgress progress = m_results.progress();
+    WPARAM percent = progress.files ? progress.finished * 100 / progress.files : 100;
+    SendMessage(hwnd, TDM_SET_PROGRESS_BAR_POS, percent, 0);
 
-    wchar_t temp_forCreationTime[MAX_PATH];
-    if (!GetCreationTime(hFile, temp_forCreationTime, ARRAYSIZE(temp_forCreationTime)))
+    //! Haponov: the text is rendered again only when something is new
+    if (m_results.version() == m_dialogVersion)
         return;
-    std::wstring resultCreationTime(temp_forCreationTime);	
 
-    //-------------------------
-    // Haponov: get a string with ala checksum
+    wchar_t status[128];
+    if (progress.complete())
+        StringCchPrintfW(status, ARRAYSIZE(status), L"%u files checked",
+                         static_cast<unsigned>(progress.files));
+    else
+        StringCchPrintfW(status, ARRAYSIZE(status), L"%u of %u files checked",
+                         static_cast<unsigned>(progress.finished),
+                         static_cast<unsigned>(progress.files));
+    m_dialogStatus = status;
+    m_dialogText = resultsText(m_dialogVersion);
+    SendMessage(hwnd, TDM_SET_ELEMENT_TEXT, TDE_MAIN_INSTRUCTION,
+                reinterpret_cast<LPARAM>(m_dialogStatus.c_str()));
+    SendMessage(hwnd, TDM_SET_ELEMENT_TEXT, TDE_CONTENT,
+                reinterpret_cast<LPARAM>(m_dialogText.c_str()));
+}
 
-    DWORD checksum = getCheckSum(ws_name);
-    std::wstring result_checkSum = std::to_wstring(checksum);
+//! Haponov function
+void FileContextMenuExt::startProcessingSelectedFiles()
+{
+    //! Haponov: QueryContextMenu and InvokeCommand may both get here,
+    //! the files are processed only once
+    if (m_processingStarted)
+        return;
+    m_processingStarted = true;
+    m_ioAtStart = File::counters();
+    //! Haponov: the arena is filled on this thread only, the pool threads
+    //! sort the order in place
+    m_checker.reset(m_files.data(), m_files.size(), m_hashAlgorithm);
+    m_order.resize(m_files.size());
+
+    //! Haponov: the pool is shared by all instances and keeps its threads
+    //! between right-clicks; finding the devices of the files may block on
+    //! a network share, so it is done there too, not on the shell thread
+    ThreadPool::shared().doJob(m_batch, std::bind(&FileContextMenuExt::scheduleSelectedFiles, this));
+}
 
-    //-------------------------
-    // Haponov: create a resulting string for displaying
+//! Haponov function
+void FileContextMenuExt::armDeadline()
+{
+    //! Haponov: the time limit counts from the command, not from the
+    //! menu - the batch started for the menu may wait there a long time
+    if (m_deadlineArmed)
+        return;
+    m_deadlineArmed = true;
+    if (m_timeoutSeconds)
+        m_batch.setDeadline(std::chrono::steady_clock::now() + std::chrono::seconds(m_timeoutSeconds));
+}
 
-    atLast += L";   size: ";   atLast += result_size;  
-    atLast += L" KB;   creation time: ";  	atLast += resultCreationTime; 
-    atLast += L"   checksum: ";   atLast += result_checkSum;
+//! Haponov function
+void FileContextMenuExt::sortSelectedFiles()
+{
+    //! Haponov: by file name - WO full path - as the lines begin with it;
+    //! equal names keep the order of the selection
+    for (std::size_t i = 0; i < m_order.size(); ++i)
+        m_order[i] = i;
+    const FileRecord* files = m_files.data();
+    ParallelSort::sort(m_order.begin(), m_order.end(),
+        [files](std::size_t a, std::size_t b)
+        {
+            int order = std::wcscmp(files[a].name(), files[b].name());
+            return order < 0 || (order == 0 && a < b);
+        },
+        ThreadPool::shared());
+    m_orderReady.store(true, std::memory_order_release);
+}
 
-    // Haponov: protect shared std::set<std::wstring> sortedFiles
-    mu.lock(); 
-    sortedFiles.insert(atLast);
-    mu.unlock();
-    return;
+//! Haponov function
+void FileContextMenuExt::scheduleSelectedFiles()
+{
+    //! Haponov: the order of the report is known before any result is
+    sortSelectedFiles();
+    //! Haponov: the metadata found by folder scans is published before
+    //! any file is opened, then every file is queued for its device
+    m_checker.schedule();
+}
+
+//! Haponov function
+void FileContextMenuExt::waitForSelectedFiles()
+{
+    startProcessingSelectedFiles();
+    m_batch.wait();
+
+    //! Haponov: system calls per file of each stage, for DebugView; other
+    //! instances working at the same time are counted too
+    if (m_files.empty())
+        return;
+    IoCounters io = File::counters().since(m_ioAtStart);
+    double files = static_cast<double>(m_files.size());
+    wchar_t report[256];
+    if (SUCCEEDED(StringCchPrintfW(report, ARRAYSIZE(report),
+        L"AVID-COM: %u files, system calls per file: open %.2f, metadata %.2f, "
+        L"read %.2f, write %.2f, map %.2f, close %.2f, total %.2f\n",
+        static_cast<unsigned>(m_files.size()), io.opens / files, io.metadata / files,
+        io.reads / files, io.writes / files, io.maps / files, io.closes / files,
+        io.total() / files)))
+        OutputDebugStringW(report);
+
+    //! Haponov: what the arena of this invocation served, and how few of
+    //! it reached the heap
+    ArenaCounters memory = m_memory.counters();
+    if (SUCCEEDED(StringCchPrintfW(report, ARRAYSIZE(report),
+        L"AVID-COM: arena %.2f allocations and %.1f bytes per file, %u heap chunks, %u KB\n",
+        memory.requests / files, memory.bytes / files,
+        static_cast<unsigned>(memory.chunks), static_cast<unsigned>(memory.chunkBytes >> 10))))
+        OutputDebugStringW(report);
 }
 
 
@@ -247,6 +840,10 @@ IFACEMETHODIMP_(ULONG) FileContextMenuExt::Release()
     ULONG cRef = InterlockedDecrement(&m_cRef);
     if (0 == cRef)
     {
+        //! Haponov: the menu is gone - files still queued are dropped and
+        //! the running checksums stop at their next block, so the
+        //! destructor does not wait for whole files to be read
+        m_batch.cancel();
         delete this;
     }
 
@@ -283,54 +880,48 @@ IFACEMETHODIMP FileContextMenuExt::Initialize(
         {
             //! start of Haponov CHANGES:
             //!****************************************************
-            //! Haponov: number of threads depends on number of selected files 
-            UINT nFiles = DragQueryFile(hDrop, 0xFFFFFFFF, NULL, 0);
-            if (nFiles)
+            //! Haponov: only remember the selected paths here - Explorer
+            //! waits for Initialize before it shows the menu, so every file
+            //! is opened and hashed later, off the shell thread
+            //! (see startProcessingSelectedFiles)
+            //! Haponov: the paths are read from the DROPFILES block in one
+            //! pass and copied once, into the arena - DragQueryFile would
+            //! scan the list from its start for every index and cut them at
+            //! MAX_PATH
+            DropFileList list;
+            DropPath path;
+            std::wstring converted;
+            if (list.parse(hDrop, GlobalSize(stm.hGlobal)))
             {
-                wchar_t temp_forName[MAX_PATH];
-                if (nFiles > 1) 
+                while (list.next(path))
                 {
-                    //std::vector<std::thread> threads;
-                    ThreadPool threadPool(std::thread::hardware_concurrency());
-
-                    for (UINT i = 0; i < nFiles - 1; ++i)
+                    if (list.wide())
                     {
-                        // Get full path of the file.
-                        if (0 != DragQueryFile(hDrop, i, temp_forName /*such path is written to temp_forName*/,
-                                                       ARRAYSIZE(temp_forName)))
+                        // Haponov: an odd pFiles leaves the paths at odd
+                        // addresses, which are copied out before they are
+                        // read as wchar_t
+                        const wchar_t* text = static_cast<const wchar_t*>(path.text);
+                        if (reinterpret_cast<std::uintptr_t>(path.text) % alignof(wchar_t))
                         {
-                            std::wstring ws(temp_forName);
-                            filePaths.push_back(ws);
-                            //threads.push_back(std::thread(&FileContextMenuExt::
-                            //        processSelectedFiles, this, filePaths[i]));
-                            threadPool.doJob(std::bind(&FileContextMenuExt::processSelectedFiles, this, filePaths[i]));
+                            converted.resize(path.length);
+                            std::memcpy(&converted[0], path.text, path.length * sizeof(wchar_t));
+                            text = converted.c_str();
                         }
+                        m_files.push_back(FileRecord::waiting(addPath(m_paths, text, path.length)));
+                        continue;
                     }
-                    //! Haponov: use the main thread to do part of the work -
-                    //! process the last file
-                    
-                        if (0 != DragQueryFile(hDrop, nFiles - 1, temp_forName, ARRAYSIZE(temp_forName)))
-                        {
-                            std::wstring ws(temp_forName);
-                            processSelectedFiles(ws);
-                        }
-                  //!Haponov: no need for joining here anymore  
-                    //for (auto &t : threads)
-                    //{
-                    //    t.join();
-                    //}
-                }
-                //! Haponov: use only main thread if a sinle file is selected
-                else
-                {
-                        if (0 != DragQueryFile(hDrop, 0, temp_forName, ARRAYSIZE(temp_forName)))
-                        {
-                            std::wstring ws(temp_forName);
-                            processSelectedFiles(ws);
-                        }
+
+                    // Haponov: an ANSI list comes only from old programs
+                    const char* ansi = static_cast<const char*>(path.text);
+                    int length = MultiByteToWideChar(CP_ACP, 0, ansi, static_cast<int>(path.length), NULL, 0);
+                    if (length <= 0)
+                        continue;
+                    converted.resize(length);
+                    MultiByteToWideChar(CP_ACP, 0, ansi, static_cast<int>(path.length), &converted[0], length);
+                    m_files.push_back(FileRecord::waiting(addPath(m_paths, converted.c_str(), converted.size())));
                 }
             }
-            if (sortedFiles.size()) hr = S_OK;
+            if (m_files.size()) hr = S_OK;
             //! end of Haponov changes 
             //!****************************************************
             GlobalUnlock(stm.hGlobal);
@@ -380,19 +971,54 @@ IFACEMETHODIMP FileContextMenuExt::QueryContextMenu(
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
+    //! Haponov: copies are looked for among two selected files or more
+    UINT items = 1;
+    if (m_files.size() > 1)
+    {
+        MENUITEMINFO duplicates = { sizeof(duplicates) };
+        duplicates.fMask = MIIM_STRING | MIIM_FTYPE | MIIM_ID | MIIM_STATE;
+        duplicates.wID = idCmdFirst + IDM_FIND_DUPLICATES;
+        duplicates.fType = MFT_STRING;
+        duplicates.dwTypeData = m_pszDuplicatesMenuText;
+        duplicates.fState = MFS_ENABLED;
+        if (!InsertMenuItem(hMenu, indexMenu + items, TRUE, &duplicates))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+        ++items;
+    }
+
+    //! Haponov: results of a large selection are saved to a file rather
+    //! than read in a message box
+    MENUITEMINFO exportItem = { sizeof(exportItem) };
+    exportItem.fMask = MIIM_STRING | MIIM_FTYPE | MIIM_ID | MIIM_STATE;
+    exportItem.wID = idCmdFirst + IDM_EXPORT;
+    exportItem.fType = MFT_STRING;
+    exportItem.dwTypeData = m_pszExportMenuText;
+    exportItem.fState = MFS_ENABLED;
+    if (!InsertMenuItem(hMenu, indexMenu + items, TRUE, &exportItem))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    ++items;
+
     // Add a separator.
     MENUITEMINFO sep = { sizeof(sep) };
     sep.fMask = MIIM_TYPE;
     sep.fType = MFT_SEPARATOR;
-    if (!InsertMenuItem(hMenu, indexMenu + 1, TRUE, &sep))
+    if (!InsertMenuItem(hMenu, indexMenu + items, TRUE, &sep))
     {
         return HRESULT_FROM_WIN32(GetLastError());
     }
 
+    //! Haponov: the menu is shown now - speculatively start reading the
+    //! selected files, so the results are likely ready by InvokeCommand
+    startProcessingSelectedFiles();
+
     // Return an HRESULT value with the severity set to SEVERITY_SUCCESS. 
     // Set the code value to the offset of the largest command identifier 
     // that was assigned, plus one (1).
-    return MAKE_HRESULT(SEVERITY_SUCCESS, 0, USHORT(IDM_DISPLAY + 1));
+    return MAKE_HRESULT(SEVERITY_SUCCESS, 0, USHORT(IDM_EXPORT + 1));
 }
 
 
@@ -441,6 +1067,14 @@ IFACEMETHODIMP FileContextMenuExt::InvokeCommand(LPCMINVOKECOMMANDINFO pici)
         {
             OnVerbDisplayFileName(pici->hwnd);
         }
+        else if (StrCmpIA(pici->lpVerb, m_pszDuplicatesVerb) == 0)
+        {
+            OnVerbFindDuplicates(pici->hwnd);
+        }
+        else if (StrCmpIA(pici->lpVerb, m_pszExportVerb) == 0)
+        {
+            OnVerbExportResults(pici->hwnd);
+        }
         else
         {
             // If the verb is not recognized by the context menu handler, it 
@@ -459,6 +1093,14 @@ IFACEMETHODIMP FileContextMenuExt::InvokeCommand(LPCMINVOKECOMMANDINFO pici)
         {
             OnVerbDisplayFileName(pici->hwnd);
         }
+        else if (StrCmpIW(((CMINVOKECOMMANDINFOEX*)pici)->lpVerbW, m_pwszDuplicatesVerb) == 0)
+        {
+            OnVerbFindDuplicates(pici->hwnd);
+        }
+        else if (StrCmpIW(((CMINVOKECOMMANDINFOEX*)pici)->lpVerbW, m_pwszExportVerb) == 0)
+        {
+            OnVerbExportResults(pici->hwnd);
+        }
         else
         {
             // If the verb is not recognized by the context menu handler, it 
@@ -478,6 +1120,14 @@ IFACEMETHODIMP FileContextMenuExt::InvokeCommand(LPCMINVOKECOMMANDINFO pici)
         {
             OnVerbDisplayFileName(pici->hwnd);
         }
+        else if (LOWORD(pici->lpVerb) == IDM_FIND_DUPLICATES)
+        {
+            OnVerbFindDuplicates(pici->hwnd);
+        }
+        else if (LOWORD(pici->lpVerb) == IDM_EXPORT)
+        {
+            OnVerbExportResults(pici->hwnd);
+        }
         else
         {
             // If the verb is not recognized by the context menu handler, it 
@@ -532,6 +1182,42 @@ IFACEMETHODIMP FileContextMenuExt::GetCommandString(UINT_PTR idCommand,
             hr = S_OK;
         }
     }
+    else if (idCommand == IDM_FIND_DUPLICATES)
+    {
+        switch (uFlags)
+        {
+        case GCS_HELPTEXTW:
+            hr = StringCchCopy(reinterpret_cast<PWSTR>(pszName), cchMax,
+                m_pwszDuplicatesVerbHelpText);
+            break;
+
+        case GCS_VERBW:
+            hr = StringCchCopy(reinterpret_cast<PWSTR>(pszName), cchMax,
+                m_pwszDuplicatesVerbCanonicalName);
+            break;
+
+        default:
+            hr = S_OK;
+        }
+    }
+    else if (idCommand == IDM_EXPORT)
+    {
+        switch (uFlags)
+        {
+        case GCS_HELPTEXTW:
+            hr = StringCchCopy(reinterpret_cast<PWSTR>(pszName), cchMax,
+                m_pwszExportVerbHelpText);
+            break;
+
+        case GCS_VERBW:
+            hr = StringCchCopy(reinterpret_cast<PWSTR>(pszName), cchMax,
+                m_pwszExportVerbCanonicalName);
+            break;
+
+        default:
+            hr = S_OK;
+        }
+    }
 
     // If the command (idCommand) is not supported by this context menu 
     // extension handler, return E_INVALIDARG.
@@ -15,7 +15,7 @@ an object's context menu, customized for the particular object.
 The example context menu handler adds the menu item "Avid the Best"
 to the context menu when you right-click selected files in the Windows Explorer. 
 Clicking the menu item brings up a message box that displays the full path 
-of selected files.
+of selected files, or a dialog that fills in while they are still being read.
 
 \***************************************************************************/
 
@@ -25,9 +25,16 @@ of selected files.
 #include <shlobj.h>     // For IShellExtInit and IContextMenu
 #include <string>
 #include <vector>
+#include <atomic>
 #include <thread>
 #include <mutex>
-#include <set>
+
+#include "ThreadPool.h"
+#include "BatchChecker.h"
+#include "Hasher.h"
+#include "FileRecord.h"
+#include "MonotonicArena.h"
+#include "ResultChannel.h"
 
 
 class FileContextMenuExt : public IShellExtInit, public IContextMenu
@@ -60,24 +67,32 @@ private:
     // Reference count of component.
     long m_cRef;
 
-//! Haponov: container for displaying files info
-    std::set<std::wstring> sortedFiles;
-//! Haponov: container for full paths of selected files,
-//! is used provide this info to threads of void processSelectedFiles(ws_name)
-    std::vector<std::wstring> filePaths;
+//! Haponov: results of the selected files, filled in by the pool threads
+//! as they become known
+    ResultChannel m_results;
+//! Haponov: memory of this invocation - the paths, their records and the
+//! order of the report; given back at once when the object is deleted
+    MonotonicArena m_memory;
+//! Haponov: full paths of the selected files, back to back, and a Waiting
+//! record of each; the jobs of m_checker take the path from there
+    StringArena m_paths;
+    std::vector<FileRecord, ArenaAllocator<FileRecord>> m_files;
 
     /*       not used anymore
 //! Haponov: convert string to wstring
     std::wstring s2ws(const std::string& s);
      */
 //! Haponov: get file creation time
-    BOOL GetCreationTime(HANDLE hFile, LPTSTR lpszString, DWORD dwSize);
-
-//! Haponov: calculate checksum
-    DWORD getCheckSum(std::wstring path);
+    BOOL GetCreationTime(std::uint64_t creationTime, LPTSTR lpszString, DWORD dwSize);
 
     // The method that handles the "display" verb.
     void OnVerbDisplayFileName(HWND hWnd);
+//! Haponov: the method that handles the "find duplicates" verb
+    void OnVerbFindDuplicates(HWND hWnd);
+//! Haponov: the search itself and the report of it, runs on the pool
+    void findDuplicates(const CancellationToken& cancel, std::wstring& text);
+//! Haponov: the method that handles the "export" verb
+    void OnVerbExportResults(HWND hWnd);
 
     PWSTR m_pszMenuText;
     HANDLE m_hMenuBmp;
@@ -87,12 +102,76 @@ private:
     PCWSTR m_pwszVerbCanonicalName;
     PCSTR m_pszVerbHelpText;
     PCWSTR m_pwszVerbHelpText;
-
-//! Haponov: mutex for concurrency control
-    std::mutex mu;
-
-//! Haponov: process file info:
-    //1) get file { name, size, creation date, ala checksum },
-    //2) sort file names with according info
-    void processSelectedFiles(std::wstring ws_name);
+//! Haponov: the same for the "find duplicates" command
+    PWSTR m_pszDuplicatesMenuText;
+    PCSTR m_pszDuplicatesVerb;
+    PCWSTR m_pwszDuplicatesVerb;
+    PCWSTR m_pwszDuplicatesVerbCanonicalName;
+    PCWSTR m_pwszDuplicatesVerbHelpText;
+//! Haponov: the same for the "export" command
+    PWSTR m_pszExportMenuText;
+    PCSTR m_pszExportVerb;
+    PCWSTR m_pwszExportVerb;
+    PCWSTR m_pwszExportVerbCanonicalName;
+    PCWSTR m_pwszExportVerbHelpText;
+
+//! Haponov: append one line of the report to text, showing what is known
+//! of the file so far; the only place a record is turned into text
+    void resultLine(const FileRecord& record, std::wstring& text);
+//! Haponov: lines of a snapshot of the results sorted by file name, and
+//! its version
+    std::wstring resultsText(std::uint64_t& version);
+
+//! Haponov: task dialog that shows the results while they come in, false
+//! if there is no task dialog
+    bool showProgressDialog(HWND hWnd);
+    static HRESULT CALLBACK progressDialogCallback(HWND hwnd, UINT uNotification,
+        WPARAM wParam, LPARAM lParam, LONG_PTR dwRefData);
+    void refreshProgressDialog(HWND hwnd);
+
+//! Haponov: background processing of all m_files on the shared
+//! ThreadPool, started by QueryContextMenu (or by the first verb that
+//! needs the results)
+    JobGroup m_batch;
+    bool m_processingStarted;
+//! Haponov: the time limit of m_batch is set, by the first verb invoked
+    bool m_deadlineArmed;
+
+//! Haponov: algorithm of the displayed checksum, read from the user
+//! settings when the object is created
+    HashAlgorithm m_hashAlgorithm;
+
+//! Haponov: time limit of the batch in seconds, 0 - none
+    unsigned long m_timeoutSeconds;
+
+//! Haponov: hand every selected file to the shared pool, once
+    void startProcessingSelectedFiles();
+//! Haponov: start the time limit of m_batch, once
+    void armDeadline();
+//! Haponov: sort the selected files by name into m_order, runs on the pool
+    void sortSelectedFiles();
+//! Haponov: queue every selected file for its device, runs on the pool
+    void scheduleSelectedFiles();
+//! Haponov: make sure processing is started and wait for its results
+    void waitForSelectedFiles();
+
+//! Haponov: File counters when processing started, to report the system
+//! calls made per file
+    IoCounters m_ioAtStart;
+
+//! Haponov: what the progress dialog shows, and the results version it
+//! was rendered from
+    std::wstring m_dialogStatus;
+    std::wstring m_dialogText;
+    std::uint64_t m_dialogVersion;
+
+//! Haponov: indices of m_files in the order of the report, sorted once
+//! by sortSelectedFiles; m_orderReady is set when it is
+    std::vector<std::size_t, ArenaAllocator<std::size_t>> m_order;
+    std::atomic<bool> m_orderReady;
+
+//! Haponov: the engine that opens, describes and checksums m_files on the
+//! shared pool and publishes to m_results - the same one the command line
+//! tool runs
+    BatchChecker m_checker;
 };
\ No newline at end of file
@@ -337,4 +337,53 @@ HRESULT UnregisterShellExtContextMenuHandler(
     }
 
     return hr;
-}
\ No newline at end of file
+}
+
+//
+//   FUNCTION: GetUserSetting
+//
+//   PURPOSE: Read a string setting of the extension for the current user.
+//
+//   PARAMETERS:
+//   * pszValueName - name of the value under HKCU\Software\AVID-COM.
+//   * pszData - a pointer to a buffer that receives the value's string data.
+//   * cbData - specifies the size of the buffer in bytes.
+//
+//   NOTE: The settings are optional, the caller keeps its default when the 
+//   function fails.
+//
+HRESULT GetUserSetting(PCWSTR pszValueName, PWSTR pszData, DWORD cbData)
+{
+    if (pszData == NULL || cbData < sizeof(*pszData))
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr;
+    HKEY hKey = NULL;
+    DWORD dwType = 0;
+
+    hr = HRESULT_FROM_WIN32(RegOpenKeyEx(HKEY_CURRENT_USER, 
+        L"Software\\AVID-COM", 0, KEY_READ, &hKey));
+
+    if (SUCCEEDED(hr))
+    {
+        // Leave room for the terminating null, the stored string may lack it.
+        DWORD cbRead = cbData - sizeof(*pszData);
+        hr = HRESULT_FROM_WIN32(RegQueryValueEx(hKey, pszValueName, NULL, 
+            &dwType, reinterpret_cast<LPBYTE>(pszData), &cbRead));
+
+        if (SUCCEEDED(hr) && dwType != REG_SZ)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE);
+        }
+        if (SUCCEEDED(hr))
+        {
+            pszData[cbRead / sizeof(*pszData)] = L'\0';
+        }
+
+        RegCloseKey(hKey);
+    }
+
+    return hr;
+}
@@ -108,4 +108,19 @@ HRESULT RegisterShellExtContextMenuHandler(
 //   HKCR\<File Type>\shellex\ContextMenuHandlers in the registry.
 //
 HRESULT UnregisterShellExtContextMenuHandler(
-    PCWSTR pszFileType, const CLSID& clsid);
\ No newline at end of file
+    PCWSTR pszFileType, const CLSID& clsid);
+
+//
+//   FUNCTION: GetUserSetting
+//
+//   PURPOSE: Read a string setting of the extension for the current user.
+//
+//   PARAMETERS:
+//   * pszValueName - name of the value under HKCU\Software\AVID-COM.
+//   * pszData - a pointer to a buffer that receives the value's string data.
+//   * cbData - specifies the size of the buffer in bytes.
+//
+//   NOTE: The settings are optional, the caller keeps its default when the 
+//   function fails.
+//
+HRESULT GetUserSetting(PCWSTR pszValueName, PWSTR pszData, DWORD cbData);
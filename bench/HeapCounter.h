@@ -0,0 +1,29 @@
+/****************************** Module Header ******************************\
+Module Name:  HeapCounter.h
+Project:      CppShellExtContextMenuHandler
+
+Counts the heap allocations of the whole process for avidbench, with
+replacement global operators new and delete in every form - plain, array,
+sized and nothrow - each releasing what its own counterpart allocated.
+
+The operators live in a translation unit of their own: where the compiler
+inlines them into the bench it would see malloc behind new and free
+behind delete, and warn of a mismatched pair (-Wmismatched-new-delete).
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef HEAPCOUNTER_H
+#define HEAPCOUNTER_H
+
+#include <cstdint>
+
+class HeapCounter
+{
+public:
+    //! Haponov - allocations made by operator new in any form so far
+    static std::uint64_t allocations();
+};
+
+#endif // HEAPCOUNTER_H
@@ -0,0 +1,1771 @@
+/****************************** Module Header ******************************\
+Module Name:  avidbench.cpp
+Project:      CppShellExtContextMenuHandler
+
+Benchmarks of the engine on generated file corpora, so that a claim about
+the pool, the readers or a checksum is a number that can be tracked.
+
+    avidbench [options]
+
+The corpora are made once under one folder and reused by later runs; the
+content of every file comes from a seeded generator, so a corpus is the
+same on every machine:
+  - small:  100 000 files of 4 KB, 1 000 per folder,
+  - large:  1 000 files of 100 MB,
+  - mixed:  10 000 files of 0 B to 32 MB, every tenth a copy of another,
+  - deep:   16 chains of 48 nested folders, 4 files of 1 KB in each -
+            paths of about 900 characters,
+  - sparse: 2 files of 8 GB with 1 MB of data at the start, past 4 GB and
+            at the end,
+  - sizes:  one file of each of 1, 4, 16, 64, 256 MB, 1, 4 and 10 GB, up
+            to --max-size.
+--scale multiplies the numbers of files (not their sizes).
+
+Every stage is measured on its own, and the whole engine end to end:
+  - enumerate:  TreeWalker over the corpus, without reading a file,
+  - metadata:   open + File::info per file, and File::infoOf per folder,
+  - checksum:   Hasher::ofFile per file, large files on the pool,
+  - readahead:  ReadAhead over one file for depths 1-16 and blocks of
+                64 KB-4 MB,
+  - sweep:      every file of the sizes corpus summed by the pool threads
+                and by one thread, where the parallel threshold pays off,
+  - read-path:  the files between the block read limit and the parallel
+                threshold summed mapped and in blocks, as ofFile reads
+                them on Windows and on POSIX,
+  - duplicates: DuplicateFinder over the mixed corpus,
+  - end-to-end: BatchChecker over the corpus with records written through
+                ResultExport, as avidsum does,
+  - collect:    100 000 records published by pool jobs and collected -
+                ResultChannel in the order they finish, a mutex and a
+                set of lines as before it,
+                and a std::wstring per path and per line in a std::map,
+                as before the arena,
+  - format:     ResultExport of those records in every format, the text
+                of the dialog, and that text made from std::wstring lines
+                in a std::map,
+  - scheduling: 100 000 jobs that do nothing on pools of 1-64 threads,
+                with one queue and with work stealing, given from outside
+                the pool and by its own jobs - jobs per second,
+  - pool:       1 000 batches of 64 such jobs, each on a pool made for it
+                and on the shared pool - batches per second,
+  - dropfiles:  DropFileList over a DROPFILES block of 100 000 paths,
+  - devices:    a disk, a share and a solid state disk made of sleeps
+                (seeks, round trips, one head, one link), read by 8
+                threads from one queue and from a queue per device, and
+                the disk and the share under reader limits of 1-8,
+  - initialize: what the shell handler's Initialize does with 1, 1 000 and
+                100 000 dropped paths - parsed, copied into an arena, a
+                record each; the time of one call,
+  - bytesum:    every ByteSum kernel the CPU runs, over 16 MB in memory.
+The stages that read files run "warm" - after a pass that brings the
+corpus into the page cache - and "cold", after the page cache is dropped
+(all of it when /proc/sys/vm/drop_caches can be written, else the pages of
+the corpus files; not on Windows). End to end also runs with a warm
+checksum cache.
+
+Each measurement is run several times; its median and best times, bytes,
+system calls and heap allocations per file go to the standard error as
+text and to a JSON document (the standard output, or --json).
+
+\***************************************************************************/
+
+#include "BatchChecker.h"
+#include "ByteSum.h"
+#include "CheckSum.h"
+#include "CpuFeatures.h"
+#include "DropFileList.h"
+#include "DuplicateFinder.h"
+#include "File.h"
+#include "FileRecord.h"
+#include "HashCache.h"
+#include "Hasher.h"
+#include "HeapCounter.h"
+#include "IoScheduler.h"
+#include "MonotonicArena.h"
+#include "ReadAhead.h"
+#include "ResultChannel.h"
+#include "ResultExport.h"
+#include "TextFormat.h"
+#include "ThreadPool.h"
+#include "TreeWalker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    //! Haponov: files a batch of end-to-end checks at a time, as avidsum
+    const std::size_t batchFiles = 64 << 10;
+    //! Haponov: records of the synthetic stages
+    const std::size_t syntheticRecords = 100000;
+
+    const char* const usage =
+        "usage: avidbench [options]\n"
+        "\n"
+        "  -c, --corpus FOLDER    where the corpora are made and kept\n"
+        "                         (avid-corpus)\n"
+        "  -s, --scale FACTOR     numbers of files times FACTOR (1)\n"
+        "      --sets LIST        corpora, of small,large,mixed,deep,sparse,\n"
+        "                         sizes (all)\n"
+        "      --max-size MB      the largest file of the sizes corpus (10240)\n"
+        "      --stages LIST      of enumerate,metadata,checksum,readahead,\n"
+        "                         sweep,read-path,duplicates,end-to-end,\n"
+        "                         collect,format,scheduling,pool,dropfiles,\n"
+        "                         devices,initialize,bytesum (all)\n"
+        "  -a, --algorithm NAME   checksum algorithm, or all (sum)\n"
+        "  -r, --runs COUNT       runs of every measurement (3)\n"
+        "  -j, --json FILE        the results to FILE, not to the standard\n"
+        "                         output\n"
+        "  -h, --help             this text\n";
+
+    //-------------------------
+    // Haponov: text
+
+    PathString widen(const std::string& ascii)
+    {
+        return PathString(ascii.begin(), ascii.end());
+    }
+
+    std::string narrow(const PathChar* text)
+    {
+        typedef std::make_unsigned<PathChar>::type Unit;
+        std::string ascii;
+        for (; *text; ++text)
+        {
+            Unit c = static_cast<Unit>(*text);
+            ascii += c < 0x80 ? static_cast<char>(c) : '?';
+        }
+        return ascii;
+    }
+
+    PathString join(const PathString& folder, const std::string& name)
+    {
+#ifdef _WIN32
+        return folder + L'\\' + widen(name);
+#else
+        return folder + '/' + name;
+#endif
+    }
+
+    std::string numbered(const char* prefix, std::uint64_t number, int digits)
+    {
+        char text[64];
+        std::snprintf(text, sizeof(text), "%s%0*llu", prefix, digits,
+                      static_cast<unsigned long long>(number));
+        return text;
+    }
+
+    //! Haponov: a list such as "small,mixed" has name, or is empty
+    bool listed(const std::string& list, const char* name)
+    {
+        if (list.empty())
+            return true;
+        std::string padded = "," + list + ",";
+        return padded.find("," + std::string(name) + ",") != std::string::npos;
+    }
+
+    //-------------------------
+    // Haponov: the generator of the content - splitmix64, whose every
+    // output is a function of its seed and position alone
+
+    std::uint64_t nextRandom(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    void fillRandom(std::uint64_t& state, char* buffer, std::size_t length)
+    {
+        for (std::size_t i = 0; i < length; i += 8)
+        {
+            std::uint64_t value = nextRandom(state);
+            for (std::size_t k = 0; k < 8 && i + k < length; ++k)
+                buffer[i + k] = static_cast<char>(value >> (8 * k));
+        }
+    }
+
+    //-------------------------
+    // Haponov: what the core has no use for - creating folders, removing
+    // and writing files at an offset
+
+#ifdef _WIN32
+
+    bool makeFolder(const PathString& path)
+    {
+        return CreateDirectoryW(File::longPath(path).c_str(), NULL) ||
+               GetLastError() == ERROR_ALREADY_EXISTS;
+    }
+
+    void removeFile(const PathString& path)
+    {
+        DeleteFileW(File::longPath(path).c_str());
+    }
+
+    //! Haponov: a sparse file of size bytes with data at the offsets
+    bool writeSparse(const PathString& path, std::uint64_t size,
+                     const std::vector <std::uint64_t>& offsets, const std::vector <char>& data)
+    {
+        HANDLE file = CreateFileW(File::longPath(path).c_str(), GENERIC_WRITE, 0, NULL,
+                                  CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        DWORD returned;
+        bool ok = DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL) != 0;
+        for (std::size_t i = 0; ok && i < offsets.size(); ++i)
+        {
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(offsets[i]);
+            DWORD written;
+            ok = SetFilePointerEx(file, position, NULL, FILE_BEGIN) &&
+                 WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, NULL) &&
+                 written == data.size();
+        }
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        ok = ok && SetFilePointerEx(file, end, NULL, FILE_BEGIN) && SetEndOfFile(file);
+        CloseHandle(file);
+        return ok;
+    }
+
+#else
+
+    bool makeFolder(const PathString& path)
+    {
+        struct stat st;
+        return mkdir(path.c_str(), 0755) == 0 || (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+    }
+
+    void removeFile(const PathString& path)
+    {
+        unlink(path.c_str());
+    }
+
+    bool writeSparse(const PathString& path, std::uint64_t size,
+                     const std::vector <std::uint64_t>& offsets, const std::vector <char>& data)
+    {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0;
+        for (std::size_t i = 0; ok && i < offsets.size(); ++i)
+            ok = pwrite(fd, data.data(), data.size(), static_cast<off_t>(offsets[i])) ==
+                 static_cast<ssize_t>(data.size());
+        ok = ::close(fd) == 0 && ok;
+        return ok;
+    }
+
+#endif
+
+    //-------------------------
+    // Haponov: corpora
+
+    struct CorpusFile
+    {
+        PathString path;
+        std::uint64_t size;
+    };
+
+    struct Corpus
+    {
+        std::string name;
+        PathString root;
+        std::vector <CorpusFile> files;
+        std::uint64_t bytes;
+    };
+
+    class CorpusMaker
+    {
+    public:
+        CorpusMaker(const PathString& folder, double scale, std::uint64_t maxSize) :
+            folder_(folder), scale_(scale), maxSize_(maxSize), buffer_(1 << 20), made_(0)
+        {
+        }
+
+        //! Haponov: the files of the corpus name; those already there
+        //! with the right size are kept
+        bool make(const std::string& name, Corpus& corpus)
+        {
+            corpus.name = name;
+            corpus.root = join(folder_, name);
+            corpus.files.clear();
+            corpus.bytes = 0;
+            made_ = 0;
+            if (!makeFolder(folder_) || !makeFolder(corpus.root))
+                return false;
+
+            bool ok = false;
+            if (name == "small")
+                ok = makeSmall(corpus);
+            else if (name == "large")
+                ok = makeLarge(corpus);
+            else if (name == "mixed")
+                ok = makeMixed(corpus);
+            else if (name == "deep")
+                ok = makeDeep(corpus);
+            else if (name == "sparse")
+                ok = makeSparse(corpus);
+            else if (name == "sizes")
+                ok = makeSizes(corpus);
+            if (made_)
+            {
+                std::fprintf(stderr, "avidbench: %s: %llu files written\n", name.c_str(),
+                             static_cast<unsigned long long>(made_));
+                //! Haponov: the checksum cache takes no file written this
+                //! recently, and the cached runs would find nothing in it
+                std::this_thread::sleep_for(std::chrono::nanoseconds(HashCache::recentWriteWindow) +
+                                            std::chrono::milliseconds(500));
+            }
+            return ok;
+        }
+
+    private:
+        std::uint64_t scaled(std::uint64_t count) const
+        {
+            double value = count * scale_ + 0.5;
+            return value < 1 ? 1 : static_cast<std::uint64_t>(value);
+        }
+
+        bool add(Corpus& corpus, const PathString& path, std::uint64_t size, std::uint64_t seed)
+        {
+            CorpusFile file = { path, size };
+            corpus.files.push_back(file);
+            corpus.bytes += size;
+            return writeFile(path, size, seed);
+        }
+
+        bool writeFile(const PathString& path, std::uint64_t size, std::uint64_t seed)
+        {
+            std::uint64_t existing;
+            File current(File::longPath(path));
+            if (current.isOpen() && current.size(existing) && existing == size)
+                return true;
+            current.close();
+
+            File file;
+            if (!file.createForAppend(File::longPath(path)))
+                return false;
+            std::uint64_t state = seed;
+            for (std::uint64_t done = 0; done < size; )
+            {
+                std::size_t length = static_cast<std::size_t>(
+                    std::min<std::uint64_t>(buffer_.size(), size - done));
+                fillRandom(state, buffer_.data(), length);
+                if (!file.append(buffer_.data(), length))
+                    return false;
+                done += length;
+            }
+            ++made_;
+            return file.flush();
+        }
+
+        bool makeSmall(Corpus& corpus)
+        {
+            std::uint64_t count = scaled(100000);
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                PathString folder = join(corpus.root, numbered("d", i / 1000, 3));
+                if ((i % 1000 == 0 && !makeFolder(folder)) ||
+                    !add(corpus, join(folder, numbered("f", i, 6)), 4096, 1000000 + i))
+                    return false;
+            }
+            return true;
+        }
+
+        bool makeLarge(Corpus& corpus)
+        {
+            std::uint64_t count = scaled(1000);
+            for (std::uint64_t i = 0; i < count; ++i)
+                if (!add(corpus, join(corpus.root, numbered("f", i, 4)), 100ull << 20, 2000000 + i))
+                    return false;
+            return true;
+        }
+
+        bool makeMixed(Corpus& corpus)
+        {
+            // 70% up to 64 KB, 25% up to 1 MB, 5% up to 32 MB; every tenth
+            // file has the size and content of the one five before it
+            std::uint64_t count = scaled(10000);
+            std::uint64_t state = 3000000;
+            std::vector <std::pair <std::uint64_t, std::uint64_t>> made;
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                std::uint64_t size;
+                std::uint64_t seed = 3000000 + i;
+                std::uint64_t pick = nextRandom(state) % 100;
+                std::uint64_t random = nextRandom(state);
+                if (i % 10 == 9 && i >= 5)
+                {
+                    size = made[i - 5].first;
+                    seed = made[i - 5].second;
+                }
+                else if (pick < 70)
+                    size = random % (64 << 10);
+                else if (pick < 95)
+                    size = (64 << 10) + random % (960 << 10);
+                else
+                    size = (1 << 20) + random % (31 << 20);
+                made.push_back(std::make_pair(size, seed));
+
+                PathString folder = join(corpus.root, numbered("d", i / 500, 3));
+                if ((i % 500 == 0 && !makeFolder(folder)) ||
+                    !add(corpus, join(folder, numbered("f", i, 5)), size, seed))
+                    return false;
+            }
+            return true;
+        }
+
+        bool makeDeep(Corpus& corpus)
+        {
+            std::uint64_t chains = scaled(16);
+            for (std::uint64_t chain = 0; chain < chains; ++chain)
+            {
+                PathString folder = corpus.root;
+                for (unsigned level = 0; level < 48; ++level)
+                {
+                    folder = join(folder, numbered("level-of-chain-", chain * 100 + level, 6));
+                    if (!makeFolder(folder))
+                        return false;
+                    for (unsigned i = 0; i < 4; ++i)
+                        if (!add(corpus, join(folder, numbered("f", i, 2)), 1024,
+                                 4000000 + (chain * 48 + level) * 4 + i))
+                            return false;
+                }
+            }
+            return true;
+        }
+
+        bool makeSparse(Corpus& corpus)
+        {
+            const std::uint64_t size = 8ull << 30;
+            std::uint64_t count = scaled(2);
+            std::vector <char> data(1 << 20);
+            for (std::uint64_t i = 0; i < count; ++i)
+            {
+                PathString path = join(corpus.root, numbered("f", i, 2));
+                CorpusFile file = { path, size };
+                corpus.files.push_back(file);
+                corpus.bytes += size;
+
+                std::uint64_t existing;
+                File current(File::longPath(path));
+                if (current.isOpen() && current.size(existing) && existing == size)
+                    continue;
+                current.close();
+
+                std::uint64_t state = 5000000 + i;
+                fillRandom(state, data.data(), data.size());
+                std::vector <std::uint64_t> offsets;
+                offsets.push_back(0);
+                offsets.push_back((4ull << 30) + (1 << 20));
+                offsets.push_back(size - data.size());
+                if (!writeSparse(path, size, offsets, data))
+                    return false;
+                ++made_;
+            }
+            return true;
+        }
+
+        //! Haponov: written whole, not sparse - holes are read faster
+        //! than data and would flatter the large sizes
+        bool makeSizes(Corpus& corpus)
+        {
+            for (unsigned i = 0; i < 8; ++i)
+            {
+                std::uint64_t size = (1ull << 20) << (2 * i);
+                if (i == 7)
+                    size = 10ull << 30;
+                if (size > maxSize_)
+                    break;
+                if (!add(corpus, join(corpus.root, numbered("f", i, 2)), size, 7000000 + i))
+                    return false;
+            }
+            return true;
+        }
+
+        PathString folder_;
+        double scale_;
+        std::uint64_t maxSize_;
+        std::vector <char> buffer_;
+        std::uint64_t made_;
+    };
+
+    //-------------------------
+    // Haponov: the page cache
+
+    //! Haponov: how cold a cold run is
+    enum CacheDrop
+    {
+        DropNothing,
+        DropCorpusPages,
+        DropAllPages
+    };
+
+    const char* dropName(CacheDrop drop)
+    {
+        return drop == DropAllPages ? "drop_caches" : drop == DropCorpusPages ? "fadvise" : "none";
+    }
+
+    CacheDrop dropCaches(const Corpus& corpus)
+    {
+#if defined(__linux__)
+        sync();
+        if (std::FILE* control = std::fopen("/proc/sys/vm/drop_caches", "w"))
+        {
+            bool dropped = std::fputs("3\n", control) >= 0;
+            dropped = std::fclose(control) == 0 && dropped;
+            if (dropped)
+                return DropAllPages;
+        }
+        for (const CorpusFile& file : corpus.files)
+        {
+            int fd = ::open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+        return DropCorpusPages;
+#else
+        (void)corpus;
+        return DropNothing;
+#endif
+    }
+
+    //-------------------------
+    // Haponov: measurements
+
+    //! Haponov: what one run of a measurement did
+    struct Work
+    {
+        std::uint64_t files;
+        std::uint64_t bytes;
+    };
+
+    struct Result
+    {
+        std::string corpus;
+        std::string stage;
+        std::string cache;
+        std::string variant;
+        Work work;
+        double median;
+        double best;
+        IoCounters io;
+        std::uint64_t allocations;
+    };
+
+    class Bench
+    {
+    public:
+        explicit Bench(unsigned runs) : runs_(runs), drop_(DropNothing)
+        {
+        }
+
+        //! Haponov: run body runs times, prepare before each run, and keep
+        //! the median; variant tells the measurements of one stage apart
+        void measure(const std::string& corpus, const std::string& stage, const std::string& cache,
+                     const std::string& variant, const std::function <void()>& prepare,
+                     const std::function <Work()>& body)
+        {
+            std::vector <double> seconds;
+            Result result;
+            result.corpus = corpus;
+            result.stage = stage;
+            result.cache = cache;
+            result.variant = variant;
+            for (unsigned run = 0; run < runs_; ++run)
+            {
+                if (prepare)
+                    prepare();
+                IoCounters io = File::counters();
+                std::uint64_t allocations = HeapCounter::allocations();
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                result.work = body();
+                seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                result.io = File::counters().since(io);
+                result.allocations = HeapCounter::allocations() - allocations;
+            }
+            std::sort(seconds.begin(), seconds.end());
+            result.median = seconds[seconds.size() / 2];
+            result.best = seconds[0];
+            results_.push_back(result);
+            print(result);
+        }
+
+        //! Haponov: the same as a cold run - the page cache dropped before
+        //! every run - and a warm one, after an untimed pass; cold only
+        //! where the cache can be dropped
+        void measureColdAndWarm(const Corpus& corpus, const std::string& stage, const std::string& variant,
+                                const std::function <Work()>& body)
+        {
+            CacheDrop drop = dropCaches(corpus);
+            if (drop != DropNothing)
+            {
+                drop_ = drop;
+                measure(corpus.name, stage, "cold", variant, [&corpus]() { dropCaches(corpus); }, body);
+            }
+            body();
+            measure(corpus.name, stage, "warm", variant, std::function <void()>(), body);
+        }
+
+        void writeJson(std::FILE* out, double scale, const std::string& algorithms) const
+        {
+            const CpuFeatures& cpu = CpuFeatures::get();
+            char started[TextFormat::utcTimeSize];
+            TextFormat::utcTime(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count()), started);
+
+            std::fprintf(out, "{\n  \"benchmark\": \"avidbench\",\n  \"version\": 1,\n");
+            std::fprintf(out, "  \"finished\": \"%s\",\n", started);
+            std::fprintf(out, "  \"machine\": {\"os\": \"%s\", \"threads\": %u, \"sse42\": %s, \"avx2\": %s, "
+                         "\"avx512bw\": %s, \"sha\": %s, \"readAhead\": \"%s\"},\n",
+#ifdef _WIN32
+                         "windows",
+#elif defined(__linux__)
+                         "linux",
+#else
+                         "posix",
+#endif
+                         std::thread::hardware_concurrency(),
+                         cpu.sse42 ? "true" : "false", cpu.avx2 ? "true" : "false",
+                         cpu.avx512bw ? "true" : "false", cpu.sha ? "true" : "false",
+                         ReadAhead::nativeAvailable() ? ReadAhead::name(ReadAhead::Native)
+                                                      : ReadAhead::name(ReadAhead::Blocking));
+            std::fprintf(out, "  \"options\": {\"scale\": %g, \"runs\": %u, \"algorithms\": \"%s\", "
+                         "\"cacheDrop\": \"%s\"},\n", scale, runs_, algorithms.c_str(), dropName(drop_));
+            std::fprintf(out, "  \"results\": [");
+            for (std::size_t i = 0; i < results_.size(); ++i)
+            {
+                const Result& r = results_[i];
+                double files = r.work.files ? static_cast<double>(r.work.files) : 1.0;
+                std::fprintf(out, "%s\n    {\"corpus\": \"%s\", \"stage\": \"%s\", \"cache\": \"%s\", "
+                             "\"variant\": \"%s\", \"files\": %llu, \"bytes\": %llu, "
+                             "\"seconds\": %.6f, \"bestSeconds\": %.6f, "
+                             "\"filesPerSecond\": %.1f, \"bytesPerSecond\": %.1f, "
+                             "\"syscallsPerFile\": %.3f, \"opensPerFile\": %.3f, \"readsPerFile\": %.3f, "
+                             "\"allocationsPerFile\": %.3f}",
+                             i ? "," : "", r.corpus.c_str(), r.stage.c_str(), r.cache.c_str(),
+                             r.variant.c_str(),
+                             static_cast<unsigned long long>(r.work.files),
+                             static_cast<unsigned long long>(r.work.bytes),
+                             r.median, r.best,
+                             r.median > 0 ? r.work.files / r.median : 0.0,
+                             r.median > 0 ? r.work.bytes / r.median : 0.0,
+                             r.io.total() / files, r.io.opens / files, r.io.reads / files,
+                             r.allocations / files);
+            }
+            std::fprintf(out, "\n  ]\n}\n");
+        }
+
+    private:
+        static void print(const Result& r)
+        {
+            double files = r.work.files ? static_cast<double>(r.work.files) : 1.0;
+            std::fprintf(stderr, "%-9s %-11s %-5s %-22s %10llu files %9.3f s  %12.0f files/s %8.3f GB/s"
+                         "  %.2f calls, %.2f allocations per file\n",
+                         r.corpus.c_str(), r.stage.c_str(), r.cache.c_str(), r.variant.c_str(),
+                         static_cast<unsigned long long>(r.work.files), r.median,
+                         r.median > 0 ? r.work.files / r.median : 0.0,
+                         r.median > 0 ? r.work.bytes / r.median / 1e9 : 0.0,
+                         r.io.total() / files, r.allocations / files);
+        }
+
+        unsigned runs_;
+        CacheDrop drop_;
+        std::vector <Result> results_;
+    };
+
+    //-------------------------
+    // Haponov: the stages that read a corpus
+
+    Work enumerate(const Corpus& corpus, ThreadPool& pool)
+    {
+        TreeWalker walker(&pool, TreeWalker::FileFunc());
+        TreeTotals totals;
+        walker.walk(corpus.root, totals);
+        Work work = { totals.files + totals.directories, 0 };
+        return work;
+    }
+
+    Work metadataByOpen(const Corpus& corpus)
+    {
+        Work work = { 0, 0 };
+        FileInfo info;
+        for (const CorpusFile& entry : corpus.files)
+        {
+            File file(File::longPath(entry.path));
+            if (file.isOpen() && file.info(info))
+                ++work.files;
+        }
+        return work;
+    }
+
+    //! Haponov: the corpus files grouped by folder, as infoOf takes them
+    struct FolderNames
+    {
+        PathString folder;
+        std::vector <PathString> names;
+    };
+
+    std::vector <FolderNames> byFolder(const Corpus& corpus)
+    {
+        std::map <PathString, std::vector <PathString>> folders;
+        for (const CorpusFile& entry : corpus.files)
+        {
+            std::size_t separator = entry.path.find_last_of(widen("/\\"));
+            folders[File::longPath(entry.path.substr(0, separator + 1))].push_back(entry.path.substr(separator + 1));
+        }
+        std::vector <FolderNames> grouped;
+        for (auto& folder : folders)
+        {
+            FolderNames names = { folder.first, folder.second };
+            grouped.push_back(names);
+        }
+        return grouped;
+    }
+
+    Work metadataByScan(const std::vector <FolderNames>& folders)
+    {
+        Work work = { 0, 0 };
+        std::vector <const PathChar*> names;
+        std::vector <FileInfo> infos;
+        std::unique_ptr<bool[]> found;
+        for (const FolderNames& folder : folders)
+        {
+            names.clear();
+            for (const PathString& name : folder.names)
+                names.push_back(name.c_str());
+            infos.resize(names.size());
+            found.reset(new bool[names.size()]);
+            File::infoOf(folder.folder, names.data(), names.size(), infos.data(), found.get());
+            for (std::size_t i = 0; i < names.size(); ++i)
+                work.files += found[i] ? 1 : 0;
+        }
+        return work;
+    }
+
+    Work checksum(const Corpus& corpus, HashAlgorithm algorithm, ThreadPool& pool)
+    {
+        Work work = { 0, 0 };
+        FileInfo info;
+        Digest digest;
+        for (const CorpusFile& entry : corpus.files)
+        {
+            File file(File::longPath(entry.path));
+            if (!file.isOpen() || !file.info(info) ||
+                !Hasher::ofFile(file, info.identity.size, algorithm, &pool, digest))
+                continue;
+            ++work.files;
+            work.bytes += info.identity.size;
+        }
+        return work;
+    }
+
+    Work readAhead(const CorpusFile& entry, std::size_t blockSize, unsigned depth)
+    {
+        Work work = { 1, 0 };
+        File file(File::longPath(entry.path));
+        ReadAhead reader(file, 0, entry.size, blockSize, depth);
+        const char* data;
+        std::size_t length;
+        while (reader.next(data, length))
+            work.bytes += length;
+        return work;
+    }
+
+    //! Haponov: one file summed in ranges by the pool threads and this
+    //! one, or in blocks by this thread alone
+    Work sumFile(const CorpusFile& entry, ThreadPool* pool)
+    {
+        Work work = { 1, entry.size };
+        File file(File::longPath(entry.path));
+        std::int64_t sum = 0;
+        if (!file.isOpen() || !(pool ? CheckSum::parallel(file, entry.size, *pool, sum)
+                                     : CheckSum::sumRange(file, 0, entry.size, sum)))
+            work.files = work.bytes = 0;
+        return work;
+    }
+
+    //! Haponov: the medium files mapped, or in blocks through ReadAhead
+    Work readPath(const std::vector <CorpusFile>& medium, bool map)
+    {
+        Work work = { 0, 0 };
+        for (const CorpusFile& entry : medium)
+        {
+            File file(File::longPath(entry.path));
+            std::int64_t sum = 0;
+            if (!file.isOpen() || !(map ? CheckSum::mapped(file, entry.size, sum)
+                                        : CheckSum::sumRange(file, 0, entry.size, sum)))
+                continue;
+            ++work.files;
+            work.bytes += entry.size;
+        }
+        return work;
+    }
+
+    Work duplicates(const Corpus& corpus, ThreadPool& pool, std::uint64_t& groups, DuplicateCounters& counters)
+    {
+        std::vector <DuplicateFile> files;
+        for (const CorpusFile& entry : corpus.files)
+        {
+            DuplicateFile file = { entry.path.c_str(), entry.size, true };
+            files.push_back(file);
+        }
+        DuplicateFinder finder(&pool);
+        std::vector <std::vector <std::size_t>> found;
+        finder.find(files, found);
+        groups = found.size();
+        counters = finder.counters();
+        Work work = { files.size(), counters.edgeBytes + counters.contentBytes };
+        return work;
+    }
+
+    //! Haponov: the corpus through BatchChecker and ResultExport, a batch
+    //! of paths at a time, as avidsum checks it
+    Work endToEnd(const Corpus& corpus, HashAlgorithm algorithm, ThreadPool& pool,
+                  HashCache* cache, std::FILE* sink)
+    {
+        Work work = { 0, 0 };
+        ResultChannel results;
+        ResultExport writer(sink, ExportNdjson, algorithm);
+        writer.begin();
+        for (std::size_t first = 0; first < corpus.files.size(); first += batchFiles)
+        {
+            std::size_t count = std::min(batchFiles, corpus.files.size() - first);
+            MonotonicArena memory;
+            StringArena paths(memory);
+            std::vector <FileRecord, ArenaAllocator<FileRecord>> files((ArenaAllocator<FileRecord>(memory)));
+            files.reserve(count);
+            for (std::size_t i = first; i < first + count; ++i)
+            {
+                PathString path = File::longPath(corpus.files[i].path);
+                files.push_back(FileRecord::waiting(paths.add(path.c_str(), path.size())));
+            }
+
+            JobGroup batch;
+            BatchChecker checker(pool, memory, results, batch, cache);
+            checker.reset(files.data(), files.size(), algorithm);
+            checker.schedule();
+            checker.collect([&writer, &work](const FileRecord& record)
+            {
+                writer.write(record);
+                if (record.stage == FileRecord::Checked && record.haveChecksum)
+                {
+                    ++work.files;
+                    work.bytes += record.size;
+                }
+            });
+            batch.wait();
+        }
+        writer.end();
+        return work;
+    }
+
+    //-------------------------
+    // Haponov: the synthetic stages - records that do not come from a disk
+
+    //! Haponov: syntheticRecords paths in memory, and their records
+    struct SyntheticBatch
+    {
+        MonotonicArena memory;
+        StringArena paths;
+        std::vector <FileRecord, ArenaAllocator<FileRecord>> files;
+
+        SyntheticBatch() : paths(memory), files(ArenaAllocator<FileRecord>(memory))
+        {
+            files.reserve(syntheticRecords);
+            for (std::size_t i = 0; i < syntheticRecords; ++i)
+            {
+                PathString path = widen(numbered("/synthetic/folder-", i / 1000, 3) + numbered("/file-", i, 6));
+                files.push_back(FileRecord::waiting(paths.add(path.c_str(), path.size())));
+            }
+        }
+    };
+
+    //! Haponov: the metadata and checksum of synthetic record index
+    void syntheticResult(std::size_t index, FileInfo& info, Digest& digest)
+    {
+        std::uint64_t state = index;
+        info.identity.volume = 1;
+        info.identity.fileIdLow = index;
+        info.identity.fileIdHigh = 0;
+        info.identity.size = nextRandom(state) % (1 << 20);
+        info.identity.lastWriteTime = 1700000000ull * 1000000000ull;
+        info.creationTime = info.identity.lastWriteTime;
+        digest.algorithm = HashXxh3_128;
+        digest.length = 16;
+        fillRandom(state, reinterpret_cast<char*>(digest.bytes), digest.length);
+    }
+
+    //! Haponov: pool jobs of 256 records each publish to the channel, the
+    //! calling thread collects every record as it finishes
+    Work collectByChannel(SyntheticBatch& synthetic, ThreadPool& pool, ResultChannel& results)
+    {
+        Work work = { 0, 0 };
+        MonotonicArena memory;
+        JobGroup batch;
+        BatchChecker checker(pool, memory, results, batch, NULL);
+        checker.reset(synthetic.files.data(), synthetic.files.size(), HashXxh3_128);
+        for (std::size_t first = 0; first < syntheticRecords; first += 256)
+        {
+            pool.doJob(batch, [&results, first]()
+            {
+                FileInfo info;
+                Digest digest;
+                for (std::size_t i = first; i < first + 256 && i < syntheticRecords; ++i)
+                {
+                    syntheticResult(i, info, digest);
+                    results.describe(i, info);
+                    results.check(i, true, digest);
+                }
+            });
+        }
+        checker.collect([&work](const FileRecord&)
+        {
+            ++work.files;
+        });
+        batch.wait();
+        return work;
+    }
+
+    //! Haponov: the same as the results were kept before the channel - a
+    //! line of text per file in a set under one mutex
+    Work collectByMutexAndSet(const SyntheticBatch& synthetic, ThreadPool& pool)
+    {
+        Work work = { 0, 0 };
+        std::mutex lock;
+        std::set <std::string> lines;
+        JobGroup batch;
+        for (std::size_t first = 0; first < syntheticRecords; first += 256)
+        {
+            pool.doJob(batch, [&synthetic, &lock, &lines, first]()
+            {
+                FileInfo info;
+                Digest digest;
+                for (std::size_t i = first; i < first + 256 && i < syntheticRecords; ++i)
+                {
+                    syntheticResult(i, info, digest);
+                    std::string line = narrow(synthetic.files[i].name());
+                    line += ";   size: " + std::to_string(info.identity.size);
+                    line += " bytes;   checksum: " + digest.toString();
+                    std::unique_lock <std::mutex> l(lock);
+                    lines.insert(line);
+                }
+            });
+        }
+        batch.wait();
+        work.files = lines.size();
+        return work;
+    }
+
+    //-------------------------
+    // Haponov: the per-file heap objects of the menu before the arena - a
+    // std::wstring copy of every path, bound again into every job, and a
+    // std::wstring line per file in a std::map
+
+    typedef std::map <std::wstring, std::wstring> WstringLines;
+
+    std::wstring wideCopy(const PathChar* text)
+    {
+        std::wstring wide;
+        for (; *text; ++text)
+            wide += static_cast<wchar_t>(*text);
+        return wide;
+    }
+
+    //! Haponov: the line of a file, a std::wstring per field
+    std::wstring wstringLine(const std::wstring& path, std::uint64_t size, std::uint64_t created,
+                             const Digest& digest)
+    {
+        std::wstring line = path.substr(path.find_last_of(L"/\\") + 1);
+        std::wstring sizeText = std::to_wstring(size);
+        std::wstring createdText = std::to_wstring(created / 1000000000ull);
+        std::string checksum = digest.toString();
+        line += L";   size: ";
+        line += sizeText;
+        line += L" bytes;   creation time: ";
+        line += createdText;
+        line += L"   checksum: ";
+        line += std::wstring(checksum.begin(), checksum.end());
+        return line;
+    }
+
+    void wstringResult(std::wstring path, std::size_t index, std::mutex& lock, WstringLines& lines)
+    {
+        FileInfo info;
+        Digest digest;
+        syntheticResult(index, info, digest);
+        std::wstring line = wstringLine(path, info.identity.size, info.creationTime, digest);
+        std::unique_lock <std::mutex> l(lock);
+        lines[path] = line;
+    }
+
+    //! Haponov: a job per file, bound to its own copy of the path
+    Work collectByWstringMap(const SyntheticBatch& synthetic, ThreadPool& pool)
+    {
+        std::vector <std::wstring> paths;
+        for (const FileRecord& record : synthetic.files)
+            paths.push_back(wideCopy(record.path));
+        std::mutex lock;
+        WstringLines lines;
+        JobGroup batch;
+        for (std::size_t i = 0; i < paths.size(); ++i)
+            pool.doJob(batch, std::bind(&wstringResult, paths[i], i, std::ref(lock), std::ref(lines)));
+        batch.wait();
+        Work work = { lines.size(), 0 };
+        return work;
+    }
+
+    //! Haponov: the text of the dialog from the records, the way it was
+    //! made from a std::map of lines
+    Work formatWstringMap(const std::vector <FileRecord>& records)
+    {
+        WstringLines lines;
+        for (const FileRecord& record : records)
+        {
+            std::wstring path = wideCopy(record.path);
+            lines[path] = wstringLine(path, record.size, record.creationTime, record.checksum());
+        }
+        std::wstring text;
+        for (WstringLines::const_iterator i = lines.begin(); i != lines.end(); ++i)
+        {
+            if (i != lines.begin())
+                text += L"\n\n";
+            text += i->second;
+        }
+        Work work = { lines.size(), text.size() * sizeof(wchar_t) };
+        return work;
+    }
+
+    Work format(const std::vector <FileRecord>& records, ExportFormat exportFormat, std::FILE* sink)
+    {
+        ResultExport writer(sink, exportFormat, HashXxh3_128);
+        writer.begin();
+        for (const FileRecord& record : records)
+            writer.write(record);
+        writer.end();
+        Work work = { writer.records(), 0 };
+        return work;
+    }
+
+    //! Haponov: the numbers and the time of the dialog's line
+    Work formatText(const std::vector <FileRecord>& records)
+    {
+        Work work = { 0, 0 };
+        char size[TextFormat::groupedSize];
+        char created[TextFormat::localTimeSize];
+        for (const FileRecord& record : records)
+        {
+            work.bytes += TextFormat::grouped(record.size, size);
+            TextFormat::localTime(record.creationTime, created);
+            ++work.files;
+        }
+        return work;
+    }
+
+    //! Haponov: a DROPFILES block of count wide paths
+    std::vector <unsigned char> dropBlock(std::size_t count)
+    {
+        std::vector <unsigned char> block(DropFileList::headerSize, 0);
+        block[0] = static_cast<unsigned char>(DropFileList::headerSize);
+        block[16] = 1;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::string path = numbered("C:\\synthetic\\folder-", i / 1000, 3) + numbered("\\file-", i, 6);
+            for (char c : path)
+            {
+                block.push_back(static_cast<unsigned char>(c));
+                block.push_back(0);
+            }
+            block.push_back(0);
+            block.push_back(0);
+        }
+        block.push_back(0);
+        block.push_back(0);
+        return block;
+    }
+
+    Work parseDropBlock(const std::vector <unsigned char>& block)
+    {
+        Work work = { 0, 0 };
+        DropFileList list;
+        DropPath path;
+        if (!list.parse(block.data(), block.size()))
+            return work;
+        while (list.next(path))
+        {
+            ++work.files;
+            work.bytes += path.length * 2;
+        }
+        return work;
+    }
+
+    //! Haponov: what Initialize does with the selection of a block - every
+    //! path copied once into an arena, a long one behind its prefix, and a
+    //! Waiting record for it; the arena comes and goes with the call, as
+    //! it does with a menu
+    Work initialize(const std::vector <unsigned char>& block)
+    {
+        MonotonicArena memory;
+        StringArena paths(memory);
+        std::vector <FileRecord, ArenaAllocator<FileRecord>> files((ArenaAllocator<FileRecord>(memory)));
+        DropFileList list;
+        DropPath path;
+        PathString converted;
+        if (list.parse(block.data(), block.size()))
+        {
+            while (list.next(path))
+            {
+#ifdef _WIN32
+                const PathChar* text = static_cast<const wchar_t*>(path.text);
+#else
+                // UTF-16 units as they are - the paths are ASCII
+                const unsigned char* units = static_cast<const unsigned char*>(path.text);
+                converted.resize(path.length);
+                for (std::size_t i = 0; i < path.length; ++i)
+                    converted[i] = static_cast<PathChar>(units[2 * i]);
+                const PathChar* text = converted.c_str();
+#endif
+                std::size_t skip = 0;
+                const PathChar* prefix = path.length < 260 ? NULL :
+                                         File::longPathPrefix(text, path.length, skip);
+                files.push_back(FileRecord::waiting(
+                    prefix ? paths.add(prefix, std::char_traits<PathChar>::length(prefix),
+                                       text + skip, path.length - skip)
+                           : paths.add(text, path.length)));
+            }
+        }
+        Work work = { files.size(), block.size() };
+        return work;
+    }
+
+    //! Haponov: passes of a kernel over a buffer that stays in the caches
+    //! as far as it fits
+    Work sumBytes(const ByteSum::Variant& variant, const std::vector <char>& buffer, std::int64_t& sum)
+    {
+        const unsigned passes = 8;
+        Work work = { passes, 0 };
+        for (unsigned pass = 0; pass < passes; ++pass)
+        {
+            sum += variant.kernel(buffer.data(), buffer.size());
+            work.bytes += buffer.size();
+        }
+        return work;
+    }
+
+    //! Haponov: jobs that only count themselves, so the pool is all that
+    //! is timed; given from this thread, or inside - 64 jobs each give
+    //! the pool an equal share of the rest, as a folder walk does
+    Work tinyJobs(ThreadPool& pool, std::size_t jobs, bool inside)
+    {
+        std::atomic <std::size_t> ran(0);
+        JobGroup group;
+        if (!inside)
+        {
+            for (std::size_t i = 0; i < jobs; ++i)
+                pool.doJob(group, [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+        }
+        else
+        {
+            const std::size_t givers = 64;
+            for (std::size_t g = 0; g < givers; ++g)
+            {
+                std::size_t share = jobs / givers + (g < jobs % givers ? 1 : 0);
+                pool.doJob(group, [&pool, &group, &ran, share]()
+                {
+                    for (std::size_t i = 0; i < share; ++i)
+                        pool.doJob(group, [&ran]() { ran.fetch_add(1, std::memory_order_relaxed); });
+                });
+            }
+        }
+        group.wait();
+        Work work = { ran.load(), 0 };
+        return work;
+    }
+
+    //! Haponov: batches of 64 tiny jobs on a pool made for each batch and
+    //! destroyed after it, as every menu did, or on the shared pool
+    Work poolBatches(std::size_t batches, bool perBatch)
+    {
+        Work work = { 0, 0 };
+        unsigned threads = std::thread::hardware_concurrency();
+        for (std::size_t b = 0; b < batches; ++b)
+        {
+            std::unique_ptr <ThreadPool> own;
+            if (perBatch)
+                own.reset(new ThreadPool(threads ? static_cast<int>(threads) : 1));
+            ThreadPool& pool = perBatch ? *own : ThreadPool::shared();
+            if (tinyJobs(pool, 64, false).files == 64)
+                ++work.files;
+        }
+        return work;
+    }
+
+    //-------------------------
+    // Haponov: devices made of sleeps, for the reader limits of IoScheduler
+
+    //! Haponov: blocks of every file of a simulated device
+    const unsigned slowBlocks = 4;
+    const std::size_t slowBlockSize = 1 << 20;
+
+    //! Haponov: a disk whose one head seeks whenever it moves to another
+    //! file, a share whose every block costs a round trip and then its
+    //! time on the one link, or a solid state disk with neither
+    class SlowDevice
+    {
+    public:
+        explicit SlowDevice(IoScheduler::Media media) : media_(media), lastFile_(~std::size_t(0))
+        {
+        }
+
+        void read(std::size_t file, std::size_t bytes)
+        {
+            const std::chrono::microseconds seek(8000);
+            const std::chrono::microseconds roundTrip(5000);
+            if (media_ == IoScheduler::Rotational)
+            {
+                std::lock_guard <std::mutex> head(lock_);
+                if (lastFile_ != file)
+                    std::this_thread::sleep_for(seek);
+                lastFile_ = file;
+                std::this_thread::sleep_for(transfer(bytes, 150));
+            }
+            else if (media_ == IoScheduler::Remote)
+            {
+                std::this_thread::sleep_for(roundTrip);
+                std::lock_guard <std::mutex> link(lock_);
+                std::this_thread::sleep_for(transfer(bytes, 110));
+            }
+            else
+                std::this_thread::sleep_for(transfer(bytes, 2000));
+        }
+
+    private:
+        static std::chrono::microseconds transfer(std::size_t bytes, unsigned megabytesPerSecond)
+        {
+            return std::chrono::microseconds(bytes / megabytesPerSecond);
+        }
+
+        IoScheduler::Media media_;
+        std::mutex lock_;
+        std::size_t lastFile_;
+    };
+
+    struct SlowFile
+    {
+        SlowDevice* device;
+        IoScheduler::Device* queue;
+    };
+
+    //! Haponov: every file read block by block by a pool job - through
+    //! the device queues of scheduler, or straight to the pool's queue
+    //! when there is no scheduler
+    Work readSlowFiles(ThreadPool& pool, IoScheduler* scheduler, const std::vector <SlowFile>& files)
+    {
+        JobGroup group;
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            const SlowFile& file = files[i];
+            std::function <void(void)> job = [&file, i]()
+            {
+                for (unsigned block = 0; block < slowBlocks; ++block)
+                    file.device->read(i, slowBlockSize);
+            };
+            if (scheduler)
+                scheduler->doJob(pool, group, *file.queue, job);
+            else
+                pool.doJob(group, job);
+        }
+        group.wait();
+        Work work = { files.size(), files.size() * slowBlocks * slowBlockSize };
+        return work;
+    }
+
+    //-------------------------
+    // Haponov: options
+
+    struct Options
+    {
+        PathString corpus;
+        double scale;
+        std::uint64_t maxSize;
+        std::string sets;
+        std::string stages;
+        std::vector <HashAlgorithm> algorithms;
+        std::string algorithmNames;
+        unsigned runs;
+        PathString json;
+        bool help;
+    };
+
+    bool isOption(const PathChar* argument, const char* shortName, const char* longName)
+    {
+        std::string text = narrow(argument);
+        return (shortName && text == shortName) || text == longName;
+    }
+
+    bool parseArguments(int argc, PathChar** argv, Options& options)
+    {
+        options.corpus = widen("avid-corpus");
+        options.scale = 1;
+        options.maxSize = 10ull << 30;
+        options.runs = 3;
+        options.algorithms.push_back(HashAlaSum);
+        options.algorithmNames = Hasher::name(HashAlaSum);
+        options.help = false;
+
+        for (int i = 1; i < argc; ++i)
+        {
+            const PathChar* argument = argv[i];
+            if (isOption(argument, "-h", "--help"))
+            {
+                options.help = true;
+                return true;
+            }
+            if (i + 1 == argc)
+                return false;
+            const PathChar* value = argv[++i];
+            std::string text = narrow(value);
+
+            if (isOption(argument, "-c", "--corpus"))
+                options.corpus = value;
+            else if (isOption(argument, "-s", "--scale"))
+            {
+                char* end;
+                options.scale = std::strtod(text.c_str(), &end);
+                if (*end || !(options.scale > 0))
+                    return false;
+            }
+            else if (isOption(argument, NULL, "--max-size"))
+            {
+                char* end;
+                options.maxSize = std::strtoull(text.c_str(), &end, 10) << 20;
+                if (*end || !options.maxSize)
+                    return false;
+            }
+            else if (isOption(argument, NULL, "--sets"))
+                options.sets = text;
+            else if (isOption(argument, NULL, "--stages"))
+                options.stages = text;
+            else if (isOption(argument, "-a", "--algorithm"))
+            {
+                options.algorithms.clear();
+                options.algorithmNames = text;
+                HashAlgorithm algorithm;
+                if (text == "all")
+                {
+                    for (int a = 0; a < HashAlgorithmCount; ++a)
+                        options.algorithms.push_back(static_cast<HashAlgorithm>(a));
+                }
+                else if (Hasher::fromName(text, algorithm))
+                    options.algorithms.push_back(algorithm);
+                else
+                    return false;
+            }
+            else if (isOption(argument, "-r", "--runs"))
+            {
+                options.runs = static_cast<unsigned>(std::strtoul(text.c_str(), NULL, 10));
+                if (options.runs < 1)
+                    return false;
+            }
+            else if (isOption(argument, "-j", "--json"))
+                options.json = value;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    std::FILE* openNull()
+    {
+#ifdef _WIN32
+        return std::fopen("NUL", "wb");
+#else
+        return std::fopen("/dev/null", "wb");
+#endif
+    }
+
+    int run(int argc, PathChar** argv)
+    {
+        Options options;
+        if (!parseArguments(argc, argv, options))
+        {
+            std::fputs(usage, stderr);
+            return 2;
+        }
+        if (options.help)
+        {
+            std::fputs(usage, stdout);
+            return 0;
+        }
+
+        std::FILE* sink = openNull();
+        if (!sink)
+        {
+            std::fputs("avidbench: cannot open the null device\n", stderr);
+            return 2;
+        }
+
+        ThreadPool& pool = ThreadPool::shared();
+        Bench bench(options.runs);
+        CorpusMaker maker(options.corpus, options.scale, options.maxSize);
+        const char* const sets[] = { "small", "large", "mixed", "deep", "sparse", "sizes" };
+        const char* const corpusStages[] = { "enumerate", "metadata", "checksum", "readahead",
+                                             "sweep", "read-path", "duplicates", "end-to-end" };
+
+        //------------------
+        //! Haponov: the corpora, one after the other - and none is made
+        //! when no stage chosen reads one
+
+        bool readsCorpus = false;
+        for (const char* stage : corpusStages)
+            readsCorpus = readsCorpus || listed(options.stages, stage);
+        for (const char* set : sets)
+        {
+            if (!readsCorpus || !listed(options.sets, set))
+                continue;
+            Corpus corpus;
+            if (!maker.make(set, corpus))
+            {
+                std::fprintf(stderr, "avidbench: cannot make the %s corpus in %s\n", set,
+                             narrow(options.corpus.c_str()).c_str());
+                return 2;
+            }
+
+            if (listed(options.stages, "enumerate"))
+                bench.measureColdAndWarm(corpus, "enumerate", "tree-walker",
+                                         [&corpus, &pool]() { return enumerate(corpus, pool); });
+
+            if (listed(options.stages, "metadata"))
+            {
+                std::vector <FolderNames> folders = byFolder(corpus);
+                bench.measureColdAndWarm(corpus, "metadata", "open-and-info",
+                                         [&corpus]() { return metadataByOpen(corpus); });
+                bench.measureColdAndWarm(corpus, "metadata", "folder-scan",
+                                         [&folders]() { return metadataByScan(folders); });
+            }
+
+            if (listed(options.stages, "checksum"))
+            {
+                for (HashAlgorithm algorithm : options.algorithms)
+                    bench.measureColdAndWarm(corpus, "checksum", Hasher::name(algorithm),
+                        [&corpus, algorithm, &pool]() { return checksum(corpus, algorithm, pool); });
+            }
+
+            if (listed(options.stages, "readahead") && (corpus.name == "large" || corpus.name == "sparse"))
+            {
+                const CorpusFile& entry = corpus.files[0];
+                Corpus one = { corpus.name, corpus.root, std::vector <CorpusFile>(1, entry), entry.size };
+                for (unsigned depth : { 1u, 2u, 4u, 8u, 16u })
+                {
+                    for (std::size_t block : { std::size_t(64) << 10, std::size_t(256) << 10,
+                                               std::size_t(1) << 20, std::size_t(4) << 20 })
+                    {
+                        char variant[64];
+                        std::snprintf(variant, sizeof(variant), "depth-%u-block-%uk", depth,
+                                      static_cast<unsigned>(block >> 10));
+                        bench.measureColdAndWarm(one, "readahead", variant,
+                            [&entry, block, depth]() { return readAhead(entry, block, depth); });
+                    }
+                }
+            }
+
+            if (listed(options.stages, "sweep") && corpus.name == "sizes")
+            {
+                for (const CorpusFile& entry : corpus.files)
+                {
+                    Corpus one = { corpus.name, corpus.root, std::vector <CorpusFile>(1, entry), entry.size };
+                    char size[16];
+                    if (entry.size >= (1ull << 30))
+                        std::snprintf(size, sizeof(size), "%ug", static_cast<unsigned>(entry.size >> 30));
+                    else
+                        std::snprintf(size, sizeof(size), "%um", static_cast<unsigned>(entry.size >> 20));
+                    bench.measureColdAndWarm(one, "sweep", std::string("parallel-") + size,
+                        [&entry, &pool]() { return sumFile(entry, &pool); });
+                    bench.measureColdAndWarm(one, "sweep", std::string("sequential-") + size,
+                        [&entry]() { return sumFile(entry, NULL); });
+                }
+            }
+
+            if (listed(options.stages, "read-path"))
+            {
+                //! Haponov: the corpora are written once and never
+                //! truncated, so mapping them is safe on POSIX too
+                Corpus medium = { corpus.name, corpus.root, std::vector <CorpusFile>(), 0 };
+                for (const CorpusFile& entry : corpus.files)
+                {
+                    if (entry.size <= CheckSum::blockReadLimit || entry.size >= CheckSum::parallelThreshold)
+                        continue;
+                    medium.files.push_back(entry);
+                    medium.bytes += entry.size;
+                }
+                if (!medium.files.empty())
+                {
+                    bench.measureColdAndWarm(medium, "read-path", "mapped",
+                        [&medium]() { return readPath(medium.files, true); });
+                    bench.measureColdAndWarm(medium, "read-path", "blocks",
+                        [&medium]() { return readPath(medium.files, false); });
+                }
+            }
+
+            if (listed(options.stages, "duplicates") && corpus.name == "mixed")
+            {
+                std::uint64_t groups = 0;
+                DuplicateCounters counters = {};
+                bench.measureColdAndWarm(corpus, "duplicates", "xxh3-128-edges",
+                    [&corpus, &pool, &groups, &counters]() { return duplicates(corpus, pool, groups, counters); });
+                std::fprintf(stderr, "%-9s duplicates: %llu groups; read %.1f%% of %llu bytes - "
+                             "edges of %llu files, whole %llu files\n",
+                             corpus.name.c_str(), static_cast<unsigned long long>(groups),
+                             corpus.bytes ? 100.0 * (counters.edgeBytes + counters.contentBytes) / corpus.bytes : 0.0,
+                             static_cast<unsigned long long>(corpus.bytes),
+                             static_cast<unsigned long long>(counters.edgeHashed),
+                             static_cast<unsigned long long>(counters.contentHashed));
+            }
+
+            if (listed(options.stages, "end-to-end"))
+            {
+                for (HashAlgorithm algorithm : options.algorithms)
+                {
+                    const char* name = Hasher::name(algorithm);
+                    bench.measureColdAndWarm(corpus, "end-to-end", name,
+                        [&corpus, algorithm, &pool, sink]() { return endToEnd(corpus, algorithm, pool, NULL, sink); });
+
+                    //! Haponov: a checksum cache of its own, filled by an
+                    //! untimed pass - every file is then found in it
+                    PathString cachePath = join(options.corpus, "bench-" + corpus.name + ".cache");
+                    removeFile(cachePath);
+                    {
+                        HashCache cache(cachePath, 1ull << 40);
+                        endToEnd(corpus, algorithm, pool, &cache, sink);
+                        bench.measure(corpus.name, "end-to-end", "cached", name, std::function <void()>(),
+                            [&corpus, algorithm, &pool, &cache, sink]()
+                            {
+                                return endToEnd(corpus, algorithm, pool, &cache, sink);
+                            });
+                    }
+                    removeFile(cachePath);
+                }
+            }
+        }
+
+        //------------------
+        //! Haponov: the stages that need no corpus
+
+        bool collect = listed(options.stages, "collect");
+        bool formats = listed(options.stages, "format");
+        if (collect || formats)
+        {
+            SyntheticBatch synthetic;
+            ResultChannel results;
+            if (collect)
+            {
+                bench.measure("synthetic", "collect", "memory", "result-channel", std::function <void()>(),
+                    [&synthetic, &pool, &results]() { return collectByChannel(synthetic, pool, results); });
+                bench.measure("synthetic", "collect", "memory", "mutex-and-set", std::function <void()>(),
+                    [&synthetic, &pool]() { return collectByMutexAndSet(synthetic, pool); });
+                bench.measure("synthetic", "collect", "memory", "wstring-map", std::function <void()>(),
+                    [&synthetic, &pool]() { return collectByWstringMap(synthetic, pool); });
+            }
+            if (formats)
+            {
+                if (!collect)
+                    collectByChannel(synthetic, pool, results);
+                std::vector <FileRecord> records;
+                results.snapshot(records);
+                const ExportFormat exportFormats[] = { ExportCsv, ExportNdjson, ExportJson };
+                const char* const names[] = { "csv", "ndjson", "json" };
+                for (int f = 0; f < 3; ++f)
+                {
+                    ExportFormat exportFormat = exportFormats[f];
+                    bench.measure("synthetic", "format", "memory", names[f], std::function <void()>(),
+                        [&records, exportFormat, sink]() { return format(records, exportFormat, sink); });
+                }
+                bench.measure("synthetic", "format", "memory", "dialog-text", std::function <void()>(),
+                    [&records]() { return formatText(records); });
+                bench.measure("synthetic", "format", "memory", "wstring-map", std::function <void()>(),
+                    [&records]() { return formatWstringMap(records); });
+            }
+        }
+
+        if (listed(options.stages, "scheduling"))
+        {
+            //! Haponov: a pool per size and kind, its threads all started
+            //! before the first run
+            for (int threads : { 1, 2, 4, 8, 16, 32, 64 })
+            {
+                const ThreadPool::Scheduling kinds[] = { ThreadPool::SharedQueue, ThreadPool::WorkStealing };
+                for (ThreadPool::Scheduling kind : kinds)
+                {
+                    ThreadPool tiny(threads, kind);
+                    for (bool inside : { false, true })
+                    {
+                        char variant[64];
+                        std::snprintf(variant, sizeof(variant), "%s-%d-%s",
+                                      kind == ThreadPool::SharedQueue ? "shared-queue" : "work-stealing",
+                                      threads, inside ? "inside" : "outside");
+                        bench.measure("synthetic", "scheduling", "memory", variant, std::function <void()>(),
+                            [&tiny, inside]() { return tinyJobs(tiny, syntheticRecords, inside); });
+                    }
+                }
+            }
+        }
+
+        if (listed(options.stages, "pool"))
+        {
+            const std::size_t batches = 1000;
+            bench.measure("synthetic", "pool", "memory", "per-batch", std::function <void()>(),
+                [batches]() { return poolBatches(batches, true); });
+            bench.measure("synthetic", "pool", "memory", "shared", std::function <void()>(),
+                [batches]() { return poolBatches(batches, false); });
+        }
+
+        if (listed(options.stages, "devices"))
+        {
+            //! Haponov: 8 files on each of a simulated disk, share and
+            //! solid state disk read by 8 threads, all from one queue and
+            //! with a queue and a reader limit per device; then the files
+            //! of the disk and of the share alone under every limit
+            ThreadPool slowPool(8);
+            SlowDevice disk(IoScheduler::Rotational);
+            SlowDevice share(IoScheduler::Remote);
+            SlowDevice flash(IoScheduler::SolidState);
+            IoScheduler scheduler;
+            std::vector <SlowFile> mixed;
+            SlowDevice* const devices[] = { &disk, &share, &flash };
+            const IoScheduler::Media media[] = { IoScheduler::Rotational, IoScheduler::Remote,
+                                                 IoScheduler::SolidState };
+            for (int d = 0; d < 3; ++d)
+            {
+                IoScheduler::Device& queue = scheduler.device(widen(IoScheduler::name(media[d])), media[d],
+                                                              IoScheduler::readersFor(media[d]));
+                for (int i = 0; i < 8; ++i)
+                {
+                    SlowFile file = { devices[d], &queue };
+                    mixed.push_back(file);
+                }
+            }
+            bench.measure("simulated", "devices", "memory", "one-queue", std::function <void()>(),
+                [&slowPool, &mixed]() { return readSlowFiles(slowPool, NULL, mixed); });
+            bench.measure("simulated", "devices", "memory", "per-device", std::function <void()>(),
+                [&slowPool, &scheduler, &mixed]() { return readSlowFiles(slowPool, &scheduler, mixed); });
+
+            for (int d = 0; d < 2; ++d)
+            {
+                for (unsigned readers : { 1u, 2u, 4u, 8u })
+                {
+                    std::string name = std::string(IoScheduler::name(media[d])) + "-readers-" +
+                                       std::to_string(readers);
+                    IoScheduler::Device& queue = scheduler.device(widen(name), media[d], readers);
+                    std::vector <SlowFile> files(8);
+                    for (SlowFile& file : files)
+                    {
+                        file.device = devices[d];
+                        file.queue = &queue;
+                    }
+                    bench.measure("simulated", "devices", "memory", name, std::function <void()>(),
+                        [&slowPool, &scheduler, files]() { return readSlowFiles(slowPool, &scheduler, files); });
+                }
+            }
+        }
+
+        if (listed(options.stages, "initialize"))
+        {
+            //! Haponov: one call is one run - the median is the latency
+            //! of a menu over that many files
+            for (std::size_t count : { std::size_t(1), std::size_t(1000), std::size_t(100000) })
+            {
+                std::vector <unsigned char> block = dropBlock(count);
+                bench.measure("synthetic", "initialize", "memory", "files-" + std::to_string(count),
+                              std::function <void()>(), [&block]() { return initialize(block); });
+            }
+        }
+
+        if (listed(options.stages, "dropfiles"))
+        {
+            std::vector <unsigned char> block = dropBlock(syntheticRecords);
+            bench.measure("synthetic", "dropfiles", "memory", "parse", std::function <void()>(),
+                [&block]() { return parseDropBlock(block); });
+        }
+
+        if (listed(options.stages, "bytesum"))
+        {
+            std::vector <char> buffer(16 << 20);
+            std::uint64_t state = 6000000;
+            fillRandom(state, buffer.data(), buffer.size());
+            std::int64_t expected = ByteSum::scalar(buffer.data(), buffer.size());
+            for (const ByteSum::Variant& variant : ByteSum::supported())
+            {
+                std::int64_t sum = 0;
+                bench.measure("synthetic", "bytesum", "memory", variant.name, std::function <void()>(),
+                    [&variant, &buffer, &sum]() { return sumBytes(variant, buffer, sum); });
+                //! Haponov: a kernel is timed only as long as it is right
+                if (sum != expected * 8 * static_cast<std::int64_t>(options.runs))
+                    std::fprintf(stderr, "avidbench: the %s kernel sums to %lld, not %lld\n", variant.name,
+                                 static_cast<long long>(sum),
+                                 static_cast<long long>(expected * 8 * options.runs));
+            }
+        }
+
+        std::fclose(sink);
+
+        //------------------
+        //! Haponov: the results
+
+        std::FILE* out = stdout;
+        if (!options.json.empty())
+        {
+#ifdef _WIN32
+            out = _wfopen(options.json.c_str(), L"wb");
+#else
+            out = std::fopen(options.json.c_str(), "wb");
+#endif
+            if (!out)
+            {
+                std::fprintf(stderr, "avidbench: cannot create %s\n", narrow(options.json.c_str()).c_str());
+                return 2;
+            }
+        }
+        bench.writeJson(out, options.scale, options.algorithmNames);
+        bool written = std::fflush(out) == 0;
+        if (out != stdout)
+            written = std::fclose(out) == 0 && written;
+        return written ? 0 : 2;
+    }
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv)
+#else
+int main(int argc, char** argv)
+#endif
+{
+    return run(argc, argv);
+}
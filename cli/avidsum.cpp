@@ -0,0 +1,527 @@
+/****************************** Module Header ******************************\
+Module Name:  avidsum.cpp
+Project:      CppShellExtContextMenuHandler
+
+The command line tool: checks files and folders with the same engine as
+the context menu (BatchChecker on the shared ThreadPool, through the
+IoScheduler and the HashCache) and writes a record of each one as CSV,
+NDJSON or JSON, for bulk runs on servers with no desktop.
+
+    avidsum [options] [path ...]
+
+Paths come from the arguments, from the standard input ("-") and from
+list files (--list), one per line, in the order they are given. They are
+read and checked in batches of a fixed size, so millions of them take no
+more memory than one batch; every record is written as soon as its file
+is done. At the end the throughput goes to the standard error.
+
+\***************************************************************************/
+
+#include "BatchChecker.h"
+#include "File.h"
+#include "FileRecord.h"
+#include "HashCache.h"
+#include "Hasher.h"
+#include "MonotonicArena.h"
+#include "ResultChannel.h"
+#include "ResultExport.h"
+#include "TextFormat.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace
+{
+    //! Haponov: paths read and checked at a time; a batch takes about
+    //! 200 bytes per file, its path aside
+    const std::size_t batchFiles = 64 << 10;
+
+    const char* const usage =
+        "usage: avidsum [options] [path ...]\n"
+        "\n"
+        "Checks files and folders and writes a record of each one.\n"
+        "\n"
+        "  path                   a file or a folder; - reads paths from the\n"
+        "                         standard input, one per line\n"
+        "  -l, --list FILE        read paths from FILE, one per line\n"
+        "  -a, --algorithm NAME   sum (default), sum64, crc32c, xxh3-64,\n"
+        "                         xxh3-128 or sha256\n"
+        "  -f, --format FORMAT    csv (default), ndjson or json\n"
+        "  -o, --output FILE      write the records to FILE, in the format of\n"
+        "                         its extension, not to the standard output\n"
+        "  -t, --timeout SECONDS  stop checking after that many seconds\n"
+        "      --no-cache         neither use nor fill the checksum cache\n"
+        "  -q, --quiet            no summary on the standard error\n"
+        "  -h, --help             this text\n";
+
+    //! Haponov: where the paths come from, in the order of the arguments
+    struct PathSource
+    {
+        enum Kind
+        {
+            Argument,
+            StandardInput,
+            ListFile
+        };
+
+        Kind kind;
+        PathString path;
+    };
+
+    struct Options
+    {
+        std::vector <PathSource> sources;
+        HashAlgorithm algorithm;
+        ExportFormat format;
+        bool formatGiven;
+        PathString output;
+        unsigned long timeoutSeconds;
+        bool useCache;
+        bool quiet;
+        bool help;
+    };
+
+    //! Haponov: what the records written so far add up to
+    struct Summary
+    {
+        std::uint64_t files;
+        std::uint64_t folders;
+        std::uint64_t bytes;
+        std::uint64_t unreadable;
+        std::uint64_t failed;
+        std::uint64_t stopped;
+
+        void add(const FileRecord& record)
+        {
+            if (record.stage == FileRecord::Failed)
+            {
+                ++failed;
+                return;
+            }
+            if (record.stage != FileRecord::Checked)
+            {
+                ++stopped;
+                return;
+            }
+            if (record.directory)
+            {
+                ++folders;
+                files += record.tree.files;
+                unreadable += record.tree.unreadable;
+                bytes += record.size;
+                return;
+            }
+            ++files;
+            if (record.haveChecksum)
+                bytes += record.size;
+            else
+                ++unreadable;
+        }
+    };
+
+    //! Haponov: an option such as "-a" or "--algorithm", compared as ASCII
+    bool isOption(const PathChar* argument, const char* shortName, const char* longName)
+    {
+        for (const char* name : { shortName, longName })
+        {
+            if (!name)
+                continue;
+            const PathChar* a = argument;
+            const char* n = name;
+            for (; *a && *n && *a == static_cast<PathChar>(*n); ++a, ++n)
+                ;
+            if (!*a && !*n)
+                return true;
+        }
+        return false;
+    }
+
+    //! Haponov: option values are names and numbers, plain ASCII
+    std::string narrow(const PathChar* text)
+    {
+        typedef std::make_unsigned<PathChar>::type Unit;
+        std::string ascii;
+        for (; *text; ++text)
+        {
+            Unit c = static_cast<Unit>(*text);
+            ascii += c < 0x80 ? static_cast<char>(c) : '?';
+        }
+        return ascii;
+    }
+
+    bool parseSeconds(const std::string& text, unsigned long& seconds)
+    {
+        if (text.empty() || text.size() > 9)
+            return false;
+        seconds = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+                return false;
+            seconds = seconds * 10 + static_cast<unsigned long>(c - '0');
+        }
+        return true;
+    }
+
+    bool parseArguments(int argc, PathChar** argv, Options& options)
+    {
+        options.algorithm = HashAlaSum;
+        options.format = ExportCsv;
+        options.formatGiven = false;
+        options.timeoutSeconds = 0;
+        options.useCache = true;
+        options.quiet = false;
+        options.help = false;
+
+        bool optionsDone = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            const PathChar* argument = argv[i];
+            bool dash = argument[0] == '-';
+            if (optionsDone || !dash || !argument[1])
+            {
+                PathSource source = { dash && !argument[1] && !optionsDone ?
+                                      PathSource::StandardInput : PathSource::Argument,
+                                      PathString(argument) };
+                options.sources.push_back(source);
+                continue;
+            }
+            if (isOption(argument, NULL, "--"))
+            {
+                optionsDone = true;
+                continue;
+            }
+            if (isOption(argument, "-h", "--help"))
+            {
+                options.help = true;
+                return true;
+            }
+            if (isOption(argument, "-q", "--quiet"))
+            {
+                options.quiet = true;
+                continue;
+            }
+            if (isOption(argument, NULL, "--no-cache"))
+            {
+                options.useCache = false;
+                continue;
+            }
+
+            // Haponov: the options that take a value
+            bool list = isOption(argument, "-l", "--list");
+            bool algorithm = isOption(argument, "-a", "--algorithm");
+            bool format = isOption(argument, "-f", "--format");
+            bool output = isOption(argument, "-o", "--output");
+            bool timeout = isOption(argument, "-t", "--timeout");
+            if (!(list || algorithm || format || output || timeout) || i + 1 == argc)
+                return false;
+            const PathChar* value = argv[++i];
+
+            if (list)
+            {
+                PathSource source = { PathSource::ListFile, PathString(value) };
+                options.sources.push_back(source);
+            }
+            else if (algorithm && !Hasher::fromName(narrow(value), options.algorithm))
+                return false;
+            else if (format && !ResultExport::fromExtension(value, options.format))
+                return false;
+            else if (output)
+                options.output = value;
+            else if (timeout && !parseSeconds(narrow(value), options.timeoutSeconds))
+                return false;
+            options.formatGiven = options.formatGiven || format;
+        }
+        return !options.sources.empty();
+    }
+
+    //! Haponov: reads the paths of the sources one after the other into
+    //! the records of a batch
+    class PathReader
+    {
+    public:
+        explicit PathReader(const std::vector <PathSource>& sources) :
+            sources_(sources), next_(0), stream_(NULL), failed_(false)
+        {
+        }
+
+        ~PathReader()
+        {
+            closeStream();
+        }
+
+        //! Haponov: up to count more records; false once every source is
+        //! read to its end
+        bool fill(StringArena& paths, std::vector <FileRecord, ArenaAllocator<FileRecord>>& files,
+                  std::size_t count)
+        {
+            while (files.size() < count)
+            {
+                if (stream_)
+                {
+                    if (readLine())
+                    {
+                        if (!line_.empty())
+                            files.push_back(FileRecord::waiting(addPath(paths, line_)));
+                        continue;
+                    }
+                    closeStream();
+                }
+                if (next_ == sources_.size())
+                    return false;
+
+                const PathSource& source = sources_[next_++];
+                if (source.kind == PathSource::Argument)
+                    files.push_back(FileRecord::waiting(addPath(paths, source.path)));
+                else if (source.kind == PathSource::StandardInput)
+                    stream_ = stdin;
+                else if (!(stream_ = openList(source.path)))
+                {
+                    std::fprintf(stderr, "avidsum: cannot open the list %s\n",
+                                 narrow(source.path.c_str()).c_str());
+                    failed_ = true;
+                }
+            }
+            return true;
+        }
+
+        //! Haponov: a list could not be opened
+        bool failed() const
+        {
+            return failed_;
+        }
+
+    private:
+        PathReader(const PathReader&);
+        PathReader& operator=(const PathReader&);
+
+        //! Haponov: the next line without its end into line_, false at the
+        //! end of the stream
+        bool readLine()
+        {
+            bytes_.clear();
+            char buffer[4096];
+            while (std::fgets(buffer, sizeof(buffer), stream_))
+            {
+                bytes_ += buffer;
+                if (!bytes_.empty() && bytes_[bytes_.size() - 1] == '\n')
+                    break;
+            }
+            if (bytes_.empty())
+                return false;
+            while (!bytes_.empty() && (bytes_[bytes_.size() - 1] == '\n' || bytes_[bytes_.size() - 1] == '\r'))
+                bytes_.resize(bytes_.size() - 1);
+#ifdef _WIN32
+            // Haponov: lists are UTF-8, as the records written
+            line_.clear();
+            int length = MultiByteToWideChar(CP_UTF8, 0, bytes_.data(), static_cast<int>(bytes_.size()), NULL, 0);
+            if (length > 0)
+            {
+                line_.resize(length);
+                MultiByteToWideChar(CP_UTF8, 0, bytes_.data(), static_cast<int>(bytes_.size()), &line_[0], length);
+            }
+#else
+            line_ = bytes_;
+#endif
+            return true;
+        }
+
+        static std::FILE* openList(const PathString& path)
+        {
+#ifdef _WIN32
+            return _wfopen(path.c_str(), L"rb");
+#else
+            return std::fopen(path.c_str(), "rb");
+#endif
+        }
+
+        void closeStream()
+        {
+            if (stream_ && stream_ != stdin)
+                std::fclose(stream_);
+            stream_ = NULL;
+        }
+
+        //! Haponov: a full path, with the long path prefix when it needs
+        //! it, copied once into paths
+        static const PathChar* addPath(StringArena& paths, const PathString& path)
+        {
+#ifdef _WIN32
+            DWORD length = GetFullPathNameW(path.c_str(), 0, NULL, NULL);
+            if (length)
+            {
+                std::wstring full(length, L'\0');
+                length = GetFullPathNameW(path.c_str(), length, &full[0], NULL);
+                if (length && length < full.size())
+                {
+                    full.resize(length);
+                    PathString prefixed = File::longPath(full);
+                    return paths.add(prefixed.c_str(), prefixed.size());
+                }
+            }
+#endif
+            return paths.add(path.c_str(), path.size());
+        }
+
+        const std::vector <PathSource>& sources_;
+        std::size_t next_;
+        std::FILE* stream_;
+        std::string bytes_;
+        PathString line_;
+        bool failed_;
+    };
+
+    std::string groupedText(std::uint64_t value)
+    {
+        char text[TextFormat::groupedSize];
+        TextFormat::grouped(value, text);
+        return text;
+    }
+
+    void printSummary(const Summary& summary, double seconds, bool timedOut)
+    {
+        double gigabytes = summary.bytes / 1e9;
+        double files = static_cast<double>(summary.files);
+        std::fprintf(stderr, "avidsum: %s files and %s folders, %.2f GB in %.2f s - %.0f files/s, %.2f GB/s\n",
+                     groupedText(summary.files).c_str(), groupedText(summary.folders).c_str(),
+                     gigabytes, seconds,
+                     seconds > 0 ? files / seconds : 0.0, seconds > 0 ? gigabytes / seconds : 0.0);
+        if (summary.unreadable || summary.failed)
+            std::fprintf(stderr, "avidsum: %s unreadable, %s not found or not opened\n",
+                         groupedText(summary.unreadable).c_str(), groupedText(summary.failed).c_str());
+        if (timedOut)
+            std::fprintf(stderr, "avidsum: time limit reached - %s files were stopped, "
+                         "the paths after them were not read\n", groupedText(summary.stopped).c_str());
+
+        //! Haponov: system calls per file of each stage, as the context
+        //! menu reports them
+        if (!summary.files)
+            return;
+        IoCounters io = File::counters();
+        std::fprintf(stderr, "avidsum: system calls per file: open %.2f, metadata %.2f, "
+                     "read %.2f, write %.2f, map %.2f, close %.2f, total %.2f\n",
+                     io.opens / files, io.metadata / files, io.reads / files,
+                     io.writes / files, io.maps / files, io.closes / files, io.total() / files);
+    }
+
+    int run(int argc, PathChar** argv)
+    {
+        Options options;
+        if (!parseArguments(argc, argv, options))
+        {
+            std::fputs(usage, stderr);
+            return 2;
+        }
+        if (options.help)
+        {
+            std::fputs(usage, stdout);
+            return 0;
+        }
+
+        //------------------
+        //! Haponov: the records go to a file, in the format of its
+        //! extension unless one is given, or to the standard output
+
+        File file;
+        std::FILE* stream = NULL;
+        if (!options.output.empty())
+        {
+            std::size_t dot = options.output.find_last_of('.');
+            std::size_t separator = options.output.find_last_of(PathString(1, '/') + PathString(1, '\\'));
+            if (!options.formatGiven && dot != PathString::npos &&
+                (separator == PathString::npos || dot > separator))
+                ResultExport::fromExtension(options.output.c_str() + dot + 1, options.format);
+            if (!file.createForAppend(File::longPath(options.output)))
+            {
+                std::fprintf(stderr, "avidsum: cannot create %s\n", narrow(options.output.c_str()).c_str());
+                return 2;
+            }
+        }
+        else
+        {
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            stream = stdout;
+        }
+        std::unique_ptr<ResultExport> writer(stream ?
+            new ResultExport(stream, options.format, options.algorithm) :
+            new ResultExport(file, options.format, options.algorithm));
+        bool written = writer->begin();
+
+        //------------------
+        //! Haponov: a batch at a time - its paths, records and work memory
+        //! are given back at once when it is done; the deadline is the
+        //! same for all of them
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = start + std::chrono::seconds(options.timeoutSeconds);
+        ThreadPool& pool = ThreadPool::shared();
+        HashCache* cache = options.useCache ? &HashCache::shared() : NULL;
+        ResultChannel results;
+        PathReader reader(options.sources);
+        Summary summary = {};
+        bool timedOut = false;
+        for (bool more = true; more && !timedOut; )
+        {
+            MonotonicArena memory;
+            StringArena paths(memory);
+            std::vector <FileRecord, ArenaAllocator<FileRecord>> files((ArenaAllocator<FileRecord>(memory)));
+            files.reserve(batchFiles);
+            more = reader.fill(paths, files, batchFiles);
+            if (files.empty())
+                break;
+
+            JobGroup batch;
+            if (options.timeoutSeconds)
+                batch.setDeadline(deadline);
+            BatchChecker checker(pool, memory, results, batch, cache);
+            checker.reset(files.data(), files.size(), options.algorithm);
+            checker.schedule();
+            checker.collect([&writer, &written, &summary](const FileRecord& record)
+            {
+                written = writer->write(record) && written;
+                summary.add(record);
+            });
+            batch.wait();
+            timedOut = batch.cancelled();
+        }
+        written = writer->end() && (stream || file.flush()) && written;
+        file.close();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (cache)
+            HashCache::releaseShared();
+        ThreadPool::releaseShared();
+
+        if (!written)
+            std::fputs("avidsum: writing the records failed\n", stderr);
+        if (!options.quiet)
+            printSummary(summary, seconds, timedOut);
+        if (!written || reader.failed())
+            return 2;
+        return summary.unreadable || summary.failed || timedOut ? 1 : 0;
+    }
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv)
+#else
+int main(int argc, char** argv)
+#endif
+{
+    return run(argc, argv);
+}
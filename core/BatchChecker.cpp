@@ -0,0 +1,263 @@
+
+#include "BatchChecker.h"
+#include "HashCache.h"
+#include "IoScheduler.h"
+#include "ResultChannel.h"
+#include "ThreadPool.h"
+#include "TreeWalker.h"
+
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+const std::size_t BatchChecker::batchedMetadataFiles;
+
+BatchChecker::BatchChecker(ThreadPool& pool, MonotonicArena& memory, ResultChannel& results,
+                           JobGroup& batch, HashCache* cache) :
+    pool_(pool), results_(results), batch_(batch), cache_(cache),
+    files_(NULL), count_(0), algorithm_(HashAlaSum),
+    scannedInfo_(ArenaAllocator<FileInfo>(memory)),
+    scanned_(ArenaAllocator<unsigned char>(memory)), collected_(0)
+{
+}
+
+void BatchChecker::reset(const FileRecord* files, std::size_t count, HashAlgorithm algorithm)
+{
+    files_ = files;
+    count_ = count;
+    algorithm_ = algorithm;
+    results_.reset(files, count);
+    scannedInfo_.resize(count);
+    scanned_.assign(count, 0);
+    collected_ = 0;
+}
+
+void BatchChecker::schedule()
+{
+    //! Haponov: the metadata found by folder scans is published before
+    //! any file is opened, and spares the open of a file whose checksum
+    //! is in the cache; without a cache, or where the scan reads only the
+    //! directory entry (Windows), every file is opened anyway and its
+    //! handle gives the metadata, so the scan would only add I/O
+    if (cache_ && File::infoOfIsCurrent)
+        describeFiles();
+
+    //! Haponov: files go to the pool through the queues of their devices,
+    //! so a disk that seeks is read by one job at a time
+    IoScheduler& scheduler = IoScheduler::shared();
+    for (std::size_t i = 0; i < count_; ++i)
+    {
+        IoScheduler::Device& device = scheduler.device(files_[i].path);
+        scheduler.doJob(pool_, batch_, device,
+            std::bind(&BatchChecker::checkFile, this, i, device.parallelReads()));
+    }
+}
+
+void BatchChecker::collect(const RecordFunc& finished)
+{
+    for (;;)
+    {
+        std::uint64_t seen = results_.version();
+        if (collectFinished(finished))
+            return;
+        if (batch_.cancelled())
+        {
+            batch_.wait();
+            collectRest(finished);
+            return;
+        }
+        results_.waitForChange(seen, std::chrono::milliseconds(200));
+    }
+}
+
+bool BatchChecker::collectFinished(const RecordFunc& finished)
+{
+    //! Haponov: the results keep the order the files finish in, so every
+    //! call goes on from where the last one stopped and nothing is read
+    //! twice, however many files are pending
+    FileRecord record;
+    std::size_t index;
+    while (results_.finishedAt(collected_, index))
+    {
+        results_.record(index, record);
+        finished(record);
+        ++collected_;
+    }
+    return collected_ == count_;
+}
+
+void BatchChecker::collectRest(const RecordFunc& finished)
+{
+    collectFinished(finished);
+    if (collected_ == count_)
+        return;
+
+    //! Haponov: the records the batch stopped are the ones that never
+    //! took a place in the order
+    std::vector <unsigned char> given(count_, 0);
+    std::size_t index;
+    for (std::size_t position = 0; position < collected_; ++position)
+        if (results_.finishedAt(position, index))
+            given[index] = 1;
+    FileRecord record;
+    for (std::size_t i = 0; i < count_; ++i)
+    {
+        if (given[i])
+            continue;
+        results_.record(i, record);
+        finished(record);
+    }
+    collected_ = count_;
+}
+
+bool BatchChecker::checkSum(const File& file, std::uint64_t size, HashAlgorithm algorithm,
+                            bool parallelReads, const CancellationToken& cancel, Digest& digest)
+{
+    //! Haponov: the ala checksum picks block reads, a mapping or parallel
+    //! ranges on the pool by file size and still counts the last byte
+    //! twice, so its values do not change; the other algorithms stream
+    //! the file in order. A disk that seeks is read by one thread.
+    //! Reading stops between two blocks once cancel is cancelled
+    return Hasher::ofFile(file, size, algorithm, parallelReads ? &pool_ : NULL, digest, cancel);
+}
+
+bool BatchChecker::cachedCheckSum(const File& file, const FileInfo& info, HashAlgorithm algorithm,
+                                  bool parallelReads, const CancellationToken& cancel, Digest& digest)
+{
+    if (cache_ && cache_->lookup(info.identity, algorithm, digest))
+        return true;
+    if (!checkSum(file, info.identity.size, algorithm, parallelReads, cancel, digest))
+        return false;
+    if (cache_)
+        cache_->store(info.identity, digest);
+    return true;
+}
+
+void BatchChecker::describeFiles()
+{
+    //! Haponov: the folder of a file is its path up to the name
+    std::unordered_map <PathString, std::vector <std::size_t>> folders;
+    for (std::size_t i = 0; i < count_; ++i)
+        folders[PathString(files_[i].path, files_[i].nameStart)].push_back(i);
+
+    std::vector <const PathChar*> names;
+    std::vector <FileInfo> infos;
+    for (auto& folder : folders)
+    {
+        const std::vector <std::size_t>& indices = folder.second;
+        if (indices.size() < batchedMetadataFiles || batch_.cancelled())
+            continue;
+
+        names.clear();
+        for (std::size_t index : indices)
+            names.push_back(files_[index].name());
+        infos.resize(indices.size());
+        std::unique_ptr<bool[]> found(new bool[indices.size()]);
+        File::infoOf(folder.first, names.data(), names.size(), infos.data(), found.get());
+
+        //! Haponov: a file the scan did not find is opened as before
+        for (std::size_t k = 0; k < indices.size(); ++k)
+        {
+            if (!found[k])
+                continue;
+            scannedInfo_[indices[k]] = infos[k];
+            scanned_[indices[k]] = 1;
+            results_.describe(indices[k], infos[k]);
+        }
+    }
+}
+
+void BatchChecker::checkFile(std::size_t index, bool parallelReads)
+{
+    //! Haponov: a file described by the scan of its folder is not opened
+    //! at all when its checksum is in the cache - where the scan reads
+    //! the file itself; a directory entry of Windows may be stale, so
+    //! there the scan only shows the file and the handle keys the cache
+    Digest digest;
+    const FileInfo* scanned = scanned_[index] ? &scannedInfo_[index] : NULL;
+    bool scanIsCurrent = scanned && File::infoOfIsCurrent;
+    if (scanIsCurrent && cache_ && cache_->lookup(scanned->identity, algorithm_, digest))
+    {
+        results_.check(index, true, digest);
+        return;
+    }
+
+    //------------------
+    //! Haponov: open the file once - the same handle gives the size, the
+    //! times and the content, and is closed when file goes out of scope;
+    //! metadata a current scan has read is not asked for again
+
+    File file(files_[index].path);
+    FileInfo info;
+    if (scanIsCurrent && file.isOpen())
+        info = *scanned;
+    else if (file.isOpen() && !file.info(info))
+        file.close();
+    if (!file.isOpen())
+    {
+        //! Haponov: a scanned file that is gone has no checksum; a folder
+        //! has no info as a file, it is walked
+        if (scanned)
+            results_.check(index, false, digest);
+        else if (TreeWalker::isDirectory(files_[index].path))
+            checkDirectory(index, parallelReads);
+        else
+            results_.fail(index);
+        return;
+    }
+
+    //! Haponov: name, size and creation time can be shown from now on,
+    //! before the file is read
+    if (!scanned)
+        results_.describe(index, info);
+
+    //-------------------------
+    // Haponov: get the checksum of the configured algorithm, taken from
+    // the cache when the file has not changed since it was read
+
+    bool haveChecksum = cachedCheckSum(file, info, algorithm_, parallelReads, batch_.token(), digest);
+    //! Haponov: a checksum the batch stopped is not a file that cannot be
+    //! read - the file stays Described and is reported as stopped, as a
+    //! folder is
+    if (!haveChecksum && batch_.cancelled())
+        return;
+    results_.check(index, haveChecksum, digest);
+}
+
+void BatchChecker::checkDirectory(std::size_t index, bool parallelReads)
+{
+    results_.describeDirectory(index);
+
+    //------------------
+    //! Haponov: the files of the tree are checksummed one by one on the
+    //! threads of the walk, through the same cache as the files of the
+    //! batch; the first 8 bytes of each digest are added up, so the
+    //! combined checksum does not depend on the order the files are found
+    //! in. A disk that seeks is walked by the calling thread alone
+    CancellationToken cancel = batch_.token();
+    TreeWalker::FileFunc checkTreeFile = [this, cancel](const PathString& path, std::uint64_t size,
+                                                        std::uint64_t& checksum) -> bool
+    {
+        (void)size;
+        File file(path);
+        FileInfo info;
+        Digest digest;
+        if (!file.isOpen() || !file.info(info) ||
+            !cachedCheckSum(file, info, algorithm_, false, cancel, digest))
+            return false;
+        checksum = 0;
+        for (std::size_t i = 0; i < digest.length && i < 8; ++i)
+            checksum = (checksum << 8) | digest.bytes[i];
+        return true;
+    };
+
+    TreeWalker walker(parallelReads ? &pool_ : NULL, checkTreeFile);
+    TreeTotals totals;
+    //! Haponov: a walk the batch stopped has partial totals, which are
+    //! not published - the folder stays Described and is reported as
+    //! stopped
+    if (walker.walk(files_[index].path, totals, cancel))
+        results_.checkDirectory(index, totals);
+    else if (!batch_.cancelled())
+        results_.fail(index);
+}
@@ -0,0 +1,129 @@
+/****************************** Module Header ******************************\
+Module Name:  BatchChecker.h
+Project:      CppShellExtContextMenuHandler
+
+Checks a batch of files and publishes what it finds to a ResultChannel -
+the engine of the context menu and of the command line tool alike:
+  - the files of a folder that holds many of them are described from one
+    scan of the folder (File::infoOf), where the scan reads the files
+    themselves and a cache may spare their opens,
+  - every file is queued for its device on the IoScheduler and runs as a
+    job of the batch on a ThreadPool,
+  - a job opens its file once, describes it and takes its checksum from
+    the HashCache, or reads it,
+  - a directory is walked with TreeWalker and gets the totals of its tree.
+The caller owns the records, the results and the JobGroup of the batch,
+and decides when to cancel it; nothing here knows of windows or consoles.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef BATCHCHECKER_H
+#define BATCHCHECKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Cancellation.h"
+#include "File.h"
+#include "FileRecord.h"
+#include "Hasher.h"
+#include "MonotonicArena.h"
+
+class HashCache;
+class JobGroup;
+class ResultChannel;
+class ThreadPool;
+
+class BatchChecker
+{
+public:
+    //! Haponov - a folder with at least this many files of the batch is
+    //            scanned once for their metadata; fewer are opened one by
+    //            one, as the scan of a large folder costs more than a few
+    //            opens
+    static const std::size_t batchedMetadataFiles = 8;
+
+    //! Haponov - a record that is checked or failed, or that the batch
+    //            was cancelled before it got there
+    typedef std::function <void(const FileRecord& record)> RecordFunc;
+
+    //! Haponov - jobs run on pool, which also reads large files in
+    //            parallel; work memory comes from memory; without a cache
+    //            every checksum is computed
+    BatchChecker(ThreadPool& pool, MonotonicArena& memory, ResultChannel& results,
+                 JobGroup& batch, HashCache* cache);
+
+    //! Haponov - start over with count Waiting records, which stay where
+    //            they are until the batch is done, and reset the results;
+    //            one thread at a time, as it fills memory
+    void reset(const FileRecord* files, std::size_t count, HashAlgorithm algorithm);
+
+    //! Haponov - describe the files of crowded folders, then queue every
+    //            file for its device; finding the devices may block on a
+    //            network share
+    void schedule();
+
+    //! Haponov - call finished for every record as soon as it is checked
+    //            or failed, in the order they finish, waiting for them;
+    //            once the batch is cancelled it is waited for and the
+    //            records left are given as far as they got
+    void collect(const RecordFunc& finished);
+
+    //! Haponov - the same without waiting: call finished for the records
+    //            checked or failed since the last call; true once every
+    //            record has been given. One consumer at a time, which may
+    //            be a pool job
+    bool collectFinished(const RecordFunc& finished);
+    //! Haponov - once the batch is done (cancelled, usually): call
+    //            finished for every record not given yet, as far as it got
+    void collectRest(const RecordFunc& finished);
+
+    //! Haponov - the checksum of algorithm, false if the file cannot be
+    //            read or cancel is cancelled; parallelReads lets the
+    //            threads of the pool read the file
+    bool checkSum(const File& file, std::uint64_t size, HashAlgorithm algorithm,
+                  bool parallelReads, const CancellationToken& cancel, Digest& digest);
+    //! Haponov - the same through the cache, which is filled when the
+    //            checksum has to be computed; may run on any thread
+    bool cachedCheckSum(const File& file, const FileInfo& info, HashAlgorithm algorithm,
+                        bool parallelReads, const CancellationToken& cancel, Digest& digest);
+
+private:
+    BatchChecker(const BatchChecker&);
+    BatchChecker& operator=(const BatchChecker&);
+
+    //! Haponov - publish the size and times of files that share a folder
+    //            with many others, from one scan of the folder
+    void describeFiles();
+    //! Haponov - the job of files_[index]: publish its metadata as soon
+    //            as it is open, then its checksum
+    void checkFile(std::size_t index, bool parallelReads);
+    //! Haponov - walk the directory files_[index] and publish the totals
+    //            of its tree, every file of it checksummed as checkFile
+    //            does
+    void checkDirectory(std::size_t index, bool parallelReads);
+
+    ThreadPool& pool_;
+    ResultChannel& results_;
+    JobGroup& batch_;
+    HashCache* cache_;
+
+    const FileRecord* files_;
+    std::size_t count_;
+    HashAlgorithm algorithm_;
+
+    //! Haponov - metadata of files_[i] found by describeFiles when
+    //            scanned_[i] is set - such a file is opened only to be read
+    std::vector <FileInfo, ArenaAllocator<FileInfo>> scannedInfo_;
+    std::vector <unsigned char, ArenaAllocator<unsigned char>> scanned_;
+
+    //! Haponov - how many records in the order of finishing the collect
+    //            functions have given
+    std::size_t collected_;
+};
+
+#endif // BATCHCHECKER_H
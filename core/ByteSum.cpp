@@ -0,0 +1,181 @@
+
+#include "ByteSum.h"
+#include "CpuFeatures.h"
+
+#ifdef CPUFEATURES_X86
+#define BYTESUM_X86
+#include <immintrin.h>
+#endif
+
+// AVX-512 intrinsics come with Visual Studio 2017
+#if defined(BYTESUM_X86) && (!defined(_MSC_VER) || _MSC_VER >= 1910)
+#define BYTESUM_AVX512
+#endif
+
+std::int64_t ByteSum::scalar(const char* data, std::size_t length)
+{
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i < length; ++i)
+        sum += static_cast<signed char>(data[i]);
+    return sum;
+}
+
+#ifdef BYTESUM_X86
+
+namespace
+{
+    // Bytes up to the next multiple of alignment
+    std::size_t headLength(const char* data, std::size_t length, std::size_t alignment)
+    {
+        std::size_t head = (alignment - reinterpret_cast<std::uintptr_t>(data) % alignment) % alignment;
+        return head < length ? head : length;
+    }
+
+    CPU_TARGET("sse2")
+    std::int64_t sumSse2(const char* data, std::size_t length)
+    {
+        std::size_t head = headLength(data, length, 16);
+        std::int64_t sum = ByteSum::scalar(data, head);
+        data += head;
+        length -= head;
+
+        const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc0 = zero, acc1 = zero;
+
+        std::size_t i = 0;
+        for (; i + 32 <= length; i += 32)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+            acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_xor_si128(a, flip), zero));
+            acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_xor_si128(b, flip), zero));
+        }
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(data + i));
+            acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_xor_si128(a, flip), zero));
+        }
+
+        std::uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(acc0, acc1));
+        sum += static_cast<std::int64_t>(lanes[0] + lanes[1]) - 128 * static_cast<std::int64_t>(i);
+        return sum + ByteSum::scalar(data + i, length - i);
+    }
+
+    CPU_TARGET("avx2")
+    std::int64_t sumAvx2(const char* data, std::size_t length)
+    {
+        std::size_t head = headLength(data, length, 32);
+        std::int64_t sum = ByteSum::scalar(data, head);
+        data += head;
+        length -= head;
+
+        const __m256i flip = _mm256_set1_epi8(static_cast<char>(0x80));
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+        std::size_t i = 0;
+        for (; i + 128 <= length; i += 128)
+        {
+            const __m256i* p = reinterpret_cast<const __m256i*>(data + i);
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(_mm256_xor_si256(_mm256_load_si256(p), flip), zero));
+            acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(_mm256_xor_si256(_mm256_load_si256(p + 1), flip), zero));
+            acc2 = _mm256_add_epi64(acc2, _mm256_sad_epu8(_mm256_xor_si256(_mm256_load_si256(p + 2), flip), zero));
+            acc3 = _mm256_add_epi64(acc3, _mm256_sad_epu8(_mm256_xor_si256(_mm256_load_si256(p + 3), flip), zero));
+        }
+        for (; i + 32 <= length; i += 32)
+        {
+            const __m256i* p = reinterpret_cast<const __m256i*>(data + i);
+            acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(_mm256_xor_si256(_mm256_load_si256(p), flip), zero));
+        }
+
+        std::uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes),
+            _mm256_add_epi64(_mm256_add_epi64(acc0, acc1), _mm256_add_epi64(acc2, acc3)));
+        sum += static_cast<std::int64_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) -
+               128 * static_cast<std::int64_t>(i);
+        return sum + ByteSum::scalar(data + i, length - i);
+    }
+
+#ifdef BYTESUM_AVX512
+    CPU_TARGET("avx512f,avx512bw")
+    std::int64_t sumAvx512(const char* data, std::size_t length)
+    {
+        std::size_t head = headLength(data, length, 64);
+        std::int64_t sum = ByteSum::scalar(data, head);
+        data += head;
+        length -= head;
+
+        const __m512i flip = _mm512_set1_epi8(static_cast<char>(0x80));
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+
+        std::size_t i = 0;
+        for (; i + 256 <= length; i += 256)
+        {
+            const char* p = data + i;
+            acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(_mm512_xor_si512(_mm512_load_si512(p), flip), zero));
+            acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(_mm512_xor_si512(_mm512_load_si512(p + 64), flip), zero));
+            acc2 = _mm512_add_epi64(acc2, _mm512_sad_epu8(_mm512_xor_si512(_mm512_load_si512(p + 128), flip), zero));
+            acc3 = _mm512_add_epi64(acc3, _mm512_sad_epu8(_mm512_xor_si512(_mm512_load_si512(p + 192), flip), zero));
+        }
+        for (; i + 64 <= length; i += 64)
+            acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(_mm512_xor_si512(_mm512_load_si512(data + i), flip), zero));
+
+        std::uint64_t lanes[8];
+        _mm512_storeu_si512(lanes,
+            _mm512_add_epi64(_mm512_add_epi64(acc0, acc1), _mm512_add_epi64(acc2, acc3)));
+        std::uint64_t total = 0;
+        for (int k = 0; k < 8; ++k)
+            total += lanes[k];
+        sum += static_cast<std::int64_t>(total) - 128 * static_cast<std::int64_t>(i);
+        return sum + ByteSum::scalar(data + i, length - i);
+    }
+#endif
+}
+
+#endif // BYTESUM_X86
+
+std::vector<ByteSum::Variant> ByteSum::supported()
+{
+    std::vector<Variant> variants;
+    Variant plain = { "scalar", &ByteSum::scalar };
+    variants.push_back(plain);
+#ifdef BYTESUM_X86
+    if (CpuFeatures::get().sse2)
+    {
+        Variant v = { "sse2", &sumSse2 };
+        variants.push_back(v);
+    }
+    if (CpuFeatures::get().avx2)
+    {
+        Variant v = { "avx2", &sumAvx2 };
+        variants.push_back(v);
+    }
+#ifdef BYTESUM_AVX512
+    if (CpuFeatures::get().avx512bw)
+    {
+        Variant v = { "avx512bw", &sumAvx512 };
+        variants.push_back(v);
+    }
+#endif
+#endif
+    return variants;
+}
+
+namespace
+{
+    // Chosen when the module is loaded, the last supported is the fastest
+    const ByteSum::Variant selected = ByteSum::supported().back();
+}
+
+std::int64_t ByteSum::sum(const char* data, std::size_t length)
+{
+    return selected.kernel(data, length);
+}
+
+const char* ByteSum::selectedName()
+{
+    return selected.name;
+}
@@ -0,0 +1,51 @@
+/****************************** Module Header ******************************\
+Module Name:  ByteSum.h
+Project:      CppShellExtContextMenuHandler
+
+Sum of a buffer taking every byte as a signed char - the inner loop of the
+checksum. Besides the plain loop there are SSE2, AVX2 and AVX-512BW kernels:
+they flip the sign bit of every byte, which turns a signed char s into the
+unsigned char s + 128, add those with PSADBW and take 128 per byte off the
+total, so the result is exactly the one of the plain loop.
+
+The fastest kernel the CPU and the OS support is picked once, when the
+module is loaded.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef BYTESUM_H
+#define BYTESUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ByteSum
+{
+public:
+    typedef std::int64_t (*Kernel)(const char* data, std::size_t length);
+
+    //! Haponov - a kernel and its name, for tests and benchmarks
+    struct Variant
+    {
+        const char* name;
+        Kernel kernel;
+    };
+
+    //! Haponov - sum of length bytes taken as signed chars, computed by the
+    //            kernel selected at load time
+    static std::int64_t sum(const char* data, std::size_t length);
+
+    //! Haponov - name of the selected kernel
+    static const char* selectedName();
+
+    //! Haponov - every kernel this CPU can run, the plain loop first
+    static std::vector<Variant> supported();
+
+    //! Haponov - the plain loop, reference for the other kernels
+    static std::int64_t scalar(const char* data, std::size_t length);
+};
+
+#endif // BYTESUM_H
@@ -0,0 +1,54 @@
+
+#include "Cancellation.h"
+
+#include <limits>
+
+CancellationToken::CancellationToken()
+{
+}
+
+bool CancellationToken::cancelled() const
+{
+    if (!state_)
+        return false;
+    if (state_->cancelled.load(std::memory_order_relaxed))
+        return true;
+
+    std::int64_t deadline = state_->deadline.load(std::memory_order_relaxed);
+    if (deadline == (std::numeric_limits<std::int64_t>::max)())
+        return false;
+    if (std::chrono::steady_clock::now().time_since_epoch().count() < deadline)
+        return false;
+
+    // Later checks need not read the clock
+    state_->cancelled.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+CancellationSource::CancellationSource()
+{
+    token_.state_ = std::make_shared<CancellationToken::State>();
+    token_.state_->cancelled = false;
+    token_.state_->deadline = (std::numeric_limits<std::int64_t>::max)();
+}
+
+void CancellationSource::cancel()
+{
+    token_.state_->cancelled.store(true, std::memory_order_relaxed);
+}
+
+void CancellationSource::setDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    token_.state_->deadline.store(static_cast<std::int64_t>(deadline.time_since_epoch().count()),
+                                  std::memory_order_relaxed);
+}
+
+bool CancellationSource::cancelled() const
+{
+    return token_.cancelled();
+}
+
+CancellationToken CancellationSource::token() const
+{
+    return token_;
+}
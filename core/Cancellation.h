@@ -0,0 +1,67 @@
+/****************************** Module Header ******************************\
+Module Name:  Cancellation.h
+Project:      CppShellExtContextMenuHandler
+
+Cooperative cancellation. A CancellationSource belongs to the owner of some
+work; the work gets CancellationTokens of it and checks them between its
+steps (a read block, a range, a file), stopping as soon as it sees that the
+source was cancelled or its deadline has passed. Nothing is interrupted
+from outside. A check costs one atomic load, plus one reading of the steady
+clock while a deadline is set.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+class CancellationToken
+{
+public:
+    //! Haponov - a token that is never cancelled
+    CancellationToken();
+
+    //! Haponov - the source was cancelled or its deadline has passed
+    bool cancelled() const;
+
+private:
+    friend class CancellationSource;
+
+    struct State
+    {
+        std::atomic <bool> cancelled;
+        //! steady clock ticks, the maximum - no deadline
+        std::atomic <std::int64_t> deadline;
+    };
+
+    std::shared_ptr <State> state_;
+};
+
+class CancellationSource
+{
+public:
+    CancellationSource();
+
+    //! Haponov - every token of the source is cancelled from now on
+    void cancel();
+
+    //! Haponov - the tokens are cancelled once the steady clock reaches
+    //            deadline
+    void setDeadline(std::chrono::steady_clock::time_point deadline);
+
+    bool cancelled() const;
+
+    //! Haponov - a token that may outlive the source
+    CancellationToken token() const;
+
+private:
+    CancellationToken token_;
+};
+
+#endif // CANCELLATION_H
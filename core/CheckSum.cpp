@@ -0,0 +1,160 @@
+
+#include "CheckSum.h"
+#include "ByteSum.h"
+#include "ReadAhead.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+const std::uint64_t CheckSum::blockReadLimit;
+const std::uint64_t CheckSum::parallelThreshold;
+const bool CheckSum::mapsFiles;
+const std::uint64_t CheckSum::rangeSize;
+const std::size_t CheckSum::blockSize;
+const std::size_t CheckSum::blockAlignment;
+const unsigned CheckSum::readAheadDepth;
+
+namespace
+{
+    // Ranges of one file, claimed one at a time by whoever is free:
+    // pool threads and the thread that waits for the result
+    struct ParallelSum
+    {
+        const File* file;
+        std::uint64_t size;
+        std::uint64_t ranges;
+        CancellationToken cancel;
+
+        std::atomic <std::uint64_t> nextRange;
+        std::atomic <std::int64_t> sum;
+        std::atomic <bool> failed;
+
+        std::mutex lock;
+        std::condition_variable condVar;
+        std::uint64_t rangesLeft;
+
+        // Sum ranges until none is left to claim
+        void run()
+        {
+            std::uint64_t range;
+            while ((range = nextRange++) < ranges)
+            {
+                std::uint64_t offset = range * CheckSum::rangeSize;
+                std::uint64_t length = (std::min)(CheckSum::rangeSize, size - offset);
+
+                std::int64_t partial = 0;
+                if (!failed && CheckSum::sumRange(*file, offset, length, partial, cancel))
+                    sum += partial;
+                else
+                    failed = true;
+
+                std::unique_lock <std::mutex> l(lock);
+                if (--rangesLeft == 0)
+                    condVar.notify_all();
+            }
+        }
+    };
+}
+
+std::int64_t CheckSum::sumBytes(const char* data, std::size_t length,
+                                std::int64_t sum)
+{
+    return sum + ByteSum::sum(data, length);
+}
+
+bool CheckSum::sumRange(const File& file, std::uint64_t offset,
+                        std::uint64_t length, std::int64_t& sum,
+                        const CancellationToken& cancel)
+{
+    // The next blocks are read while the current one is summed
+    ReadAhead reader(file, offset, length, blockSize, readAheadDepth);
+    const char* data;
+    std::size_t read;
+    while (!cancel.cancelled() && reader.next(data, read))
+    {
+        sum = sumBytes(data, read, sum);
+        length -= read;
+    }
+    return !reader.failed() && !length;
+}
+
+bool CheckSum::mapped(const File& file, std::uint64_t size, std::int64_t& sum,
+                      const CancellationToken& cancel)
+{
+    FileView view(file, size);
+    if (!view.isValid())
+        return false;
+
+    // Summed a block at a time, the page faults are the reads here
+    for (std::size_t offset = 0; offset < view.size(); offset += blockSize)
+    {
+        if (cancel.cancelled())
+            return false;
+        sum = sumBytes(view.data() + offset, (std::min)(blockSize, view.size() - offset), sum);
+    }
+    return true;
+}
+
+bool CheckSum::parallel(const File& file, std::uint64_t size,
+                        ThreadPool& pool, std::int64_t& sum,
+                        const CancellationToken& cancel)
+{
+    // The state is shared with pool jobs that may start only after the
+    // result is known - they find no range left and just drop it
+    std::shared_ptr<ParallelSum> state = std::make_shared<ParallelSum>();
+    state->file = &file;
+    state->size = size;
+    state->ranges = (size + rangeSize - 1) / rangeSize;
+    state->cancel = cancel;
+    state->nextRange = 0;
+    state->sum = 0;
+    state->failed = false;
+    state->rangesLeft = state->ranges;
+    if (!state->ranges)
+        return true;
+
+    unsigned helpers = std::thread::hardware_concurrency();
+    if (static_cast<std::uint64_t>(helpers) >= state->ranges)
+        helpers = static_cast<unsigned>(state->ranges) - 1;
+    for (unsigned i = 0; i < helpers; ++i)
+        pool.doJob([state]() { state->run(); });
+
+    // The calling thread may itself be a pool thread - it works on the
+    // ranges too instead of blocking one of them
+    state->run();
+
+    {
+        std::unique_lock <std::mutex> l(state->lock);
+        while (state->rangesLeft)
+            state->condVar.wait(l);
+    }
+
+    sum += state->sum;
+    return !state->failed;
+}
+
+bool CheckSum::ofFile(const File& file, std::uint64_t size, ThreadPool* pool,
+                      std::int64_t& checksum, unsigned flags,
+                      const CancellationToken& cancel)
+{
+    std::int64_t sum = 0;
+    bool ok;
+    if (size <= blockReadLimit)
+        ok = sumRange(file, 0, size, sum, cancel);
+    else if (size >= parallelThreshold && pool)
+        ok = parallel(file, size, *pool, sum, cancel);
+    else if (size < parallelThreshold && mapsFiles)
+        // A file that cannot be mapped is still read in blocks
+        ok = mapped(file, size, sum, cancel) ||
+             (!cancel.cancelled() && sumRange(file, 0, size, sum, cancel));
+    else
+        ok = sumRange(file, 0, size, sum, cancel);
+
+    if (ok && size && (flags & LegacyEndOfFile))
+        ok = sumRange(file, size - 1, 1, sum);
+
+    if (ok)
+        checksum = sum;
+    return ok;
+}
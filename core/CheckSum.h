@@ -0,0 +1,103 @@
+/****************************** Module Header ******************************\
+Module Name:  CheckSum.h
+Project:      CppShellExtContextMenuHandler
+
+The "ala checksum" of a file: every byte taken as a signed char and added
+up. The sum is kept in 64 bits, so it does not overflow for any file size;
+the checksum shown by the first versions is its low 32 bits.
+
+How a file is read depends on its size:
+  - small files are read with one block read,
+  - medium files are mapped into memory and summed in place on Windows,
+    which refuses to truncate a mapped file; on POSIX a file truncated by
+    another process under a mapping kills the reader with SIGBUS, so they
+    are read in blocks there too,
+  - large files are split into fixed-size ranges that threads of a
+    ThreadPool sum independently with aligned block reads; being a plain
+    sum, the result does not depend on the order of the partial sums.
+
+Block reads go through ReadAhead, which keeps the next blocks in flight
+while the current one is summed. A cancelled token stops the work between
+two blocks; the checksum then fails as if the file could not be read.
+
+The original istream loop added the last byte of a file a second time when
+it hit the end of file. That is kept behind the LegacyEndOfFile flag, so
+the displayed checksums stay the same as before.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Cancellation.h"
+#include "File.h"
+
+class ThreadPool;
+
+class CheckSum
+{
+public:
+    //! Haponov - compatibility flags of ofFile
+    enum Flags
+    {
+        //! every byte is counted once
+        Exact = 0,
+        //! the last byte of a non-empty file is counted twice, as the
+        //! istream loop of the first versions did
+        LegacyEndOfFile = 1
+    };
+
+    //! Haponov - files up to this size are read with one block read
+    static const std::uint64_t blockReadLimit = 64 << 10;
+    //! Haponov - files smaller than this are mapped where mapsFiles,
+    //            larger are read in blocks, in parallel ranges when a pool
+    //            is given
+    static const std::uint64_t parallelThreshold = 64ull << 20;
+#ifdef _WIN32
+    static const bool mapsFiles = true;
+#else
+    static const bool mapsFiles = false;
+#endif
+    //! Haponov - size of one range handed to a pool thread
+    static const std::uint64_t rangeSize = 8ull << 20;
+    //! Haponov - size and alignment of one positioned read
+    static const std::size_t blockSize = 1 << 20;
+    static const std::size_t blockAlignment = 4096;
+    //! Haponov - blocks of one read stream in flight at a time
+    static const unsigned readAheadDepth = 4;
+
+    //! Haponov - checksum of an open file of the given size, the read path
+    //            is chosen by the size; pool may be NULL; false on a read
+    //            error or when cancel is cancelled
+    static bool ofFile(const File& file, std::uint64_t size, ThreadPool* pool,
+                       std::int64_t& checksum, unsigned flags = LegacyEndOfFile,
+                       const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - add the bytes of a file mapped into memory to sum; on
+    //            POSIX only for a file nobody truncates meanwhile
+    static bool mapped(const File& file, std::uint64_t size, std::int64_t& sum,
+                       const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - add the bytes of a file to sum, its ranges are summed by
+    //            the pool threads and by the calling thread
+    static bool parallel(const File& file, std::uint64_t size,
+                         ThreadPool& pool, std::int64_t& sum,
+                         const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - add the bytes [offset, offset + length) of file to sum,
+    //            read in aligned blocks
+    static bool sumRange(const File& file, std::uint64_t offset,
+                         std::uint64_t length, std::int64_t& sum,
+                         const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - add length bytes of memory to sum
+    static std::int64_t sumBytes(const char* data, std::size_t length,
+                                 std::int64_t sum);
+};
+
+#endif // CHECKSUM_H
@@ -0,0 +1,93 @@
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+
+#ifdef CPUFEATURES_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CPUFEATURES_X86
+
+namespace
+{
+    void cpuid(int info[4], int leaf)
+    {
+#if defined(_MSC_VER)
+        __cpuidex(info, leaf, 0);
+#else
+        unsigned a, b, c, d;
+        __cpuid_count(leaf, 0, a, b, c, d);
+        info[0] = static_cast<int>(a);
+        info[1] = static_cast<int>(b);
+        info[2] = static_cast<int>(c);
+        info[3] = static_cast<int>(d);
+#endif
+    }
+
+    // Register state the OS saves on context switches (XCR0)
+    CPU_TARGET("xsave")
+    std::uint64_t enabledState()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned lo, hi;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<std::uint64_t>(hi) << 32) | lo;
+#endif
+    }
+}
+
+CpuFeatures::CpuFeatures() :
+    sse2(false), ssse3(false), sse41(false), sse42(false),
+    avx2(false), avx512bw(false), sha(false)
+{
+    int info[4];
+    cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    cpuid(info, 1);
+    sse2 = (info[3] & (1 << 26)) != 0;
+    ssse3 = (info[2] & (1 << 9)) != 0;
+    sse41 = (info[2] & (1 << 19)) != 0;
+    sse42 = (info[2] & (1 << 20)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf < 7)
+        return;
+
+    cpuid(info, 7);
+    // SHA extensions work on XMM registers only
+    sha = (info[1] & (1 << 29)) != 0;
+    if (!osxsave || !avx)
+        return;
+
+    // XMM/YMM state, plus opmask and ZMM state for AVX-512
+    std::uint64_t state = enabledState();
+    bool ymm = (state & 0x6) == 0x6;
+    bool zmm = (state & 0xE6) == 0xE6;
+
+    avx2 = ymm && (info[1] & (1 << 5)) != 0;
+    avx512bw = zmm && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+}
+
+#else
+
+CpuFeatures::CpuFeatures() :
+    sse2(false), ssse3(false), sse41(false), sse42(false),
+    avx2(false), avx512bw(false), sha(false)
+{
+}
+
+#endif // CPUFEATURES_X86
+
+const CpuFeatures& CpuFeatures::get()
+{
+    static const CpuFeatures cpu;
+    return cpu;
+}
@@ -0,0 +1,47 @@
+/****************************** Module Header ******************************\
+Module Name:  CpuFeatures.h
+Project:      CppShellExtContextMenuHandler
+
+Instruction set extensions of the CPU the module runs on, detected once
+with CPUID. The AVX flags also check with XGETBV that the OS saves the
+wider registers, otherwise they could not be used.
+
+The kernels of ByteSum and of the hashers pick their variant from here.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPUFEATURES_X86
+#endif
+
+// MSVC compiles any intrinsic, GCC and clang only inside functions that
+// are marked for the instruction set they need
+#if defined(_MSC_VER)
+#define CPU_TARGET(isa)
+#else
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+struct CpuFeatures
+{
+    bool sse2;
+    bool ssse3;
+    bool sse41;
+    bool sse42;
+    bool avx2;
+    bool avx512bw;
+    bool sha;
+
+    //! Haponov - features of this CPU, detected on the first call
+    static const CpuFeatures& get();
+
+private:
+    CpuFeatures();
+};
+
+#endif // CPUFEATURES_H
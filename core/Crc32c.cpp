@@ -0,0 +1,154 @@
+
+#include "Crc32c.h"
+#include "CpuFeatures.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef CPUFEATURES_X86
+#define CRC32C_X86
+#include <nmmintrin.h>
+#endif
+
+namespace
+{
+    const std::uint32_t polynomial = 0x82F63B78;
+
+    // table[k][b] is the CRC of byte b followed by k zero bytes
+    struct Tables
+    {
+        std::uint32_t table[8][256];
+
+        Tables()
+        {
+            for (std::uint32_t b = 0; b < 256; ++b)
+            {
+                std::uint32_t crc = b;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc >> 1) ^ (polynomial & (0u - (crc & 1)));
+                table[0][b] = crc;
+            }
+            for (std::uint32_t b = 0; b < 256; ++b)
+                for (int k = 1; k < 8; ++k)
+                    table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+        }
+    };
+
+    const Tables& tables()
+    {
+        static const Tables t;
+        return t;
+    }
+
+#ifdef CRC32C_X86
+    CPU_TARGET("sse4.2")
+    std::uint32_t hardware(std::uint32_t crc, const char* data, std::size_t length)
+    {
+        crc = ~crc;
+        for (; length && reinterpret_cast<std::uintptr_t>(data) % 8; --length)
+            crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data++));
+#if defined(_M_X64) || defined(__x86_64__)
+        std::uint64_t crc64 = crc;
+        for (; length >= 8; length -= 8, data += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data, 8);
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = static_cast<std::uint32_t>(crc64);
+#endif
+        for (; length >= 4; length -= 4, data += 4)
+        {
+            std::uint32_t word;
+            std::memcpy(&word, data, 4);
+            crc = _mm_crc32_u32(crc, word);
+        }
+        for (; length; --length)
+            crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data++));
+        return ~crc;
+    }
+#endif
+
+    struct Kernel
+    {
+        const char* name;
+        std::uint32_t (*extend)(std::uint32_t crc, const char* data, std::size_t length);
+    };
+
+    std::vector<Kernel> variants()
+    {
+        std::vector<Kernel> v;
+        Kernel plain = { "software", &Crc32c::software };
+        v.push_back(plain);
+#ifdef CRC32C_X86
+        if (CpuFeatures::get().sse42)
+        {
+            Kernel k = { "sse4.2", &hardware };
+            v.push_back(k);
+        }
+#endif
+        return v;
+    }
+
+    // Found when the module is loaded, the last one is the fastest
+    const std::vector<Kernel> available = variants();
+}
+
+std::uint32_t Crc32c::software(std::uint32_t crc, const char* data, std::size_t length)
+{
+    const Tables& t = tables();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+
+    crc = ~crc;
+    for (; length >= 8; length -= 8, p += 8)
+    {
+        std::uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) |
+                                  (static_cast<std::uint32_t>(p[3]) << 24));
+        crc = t.table[7][lo & 0xFF] ^ t.table[6][(lo >> 8) & 0xFF] ^
+              t.table[5][(lo >> 16) & 0xFF] ^ t.table[4][lo >> 24] ^
+              t.table[3][p[4]] ^ t.table[2][p[5]] ^ t.table[1][p[6]] ^ t.table[0][p[7]];
+    }
+    for (; length; --length)
+        crc = (crc >> 8) ^ t.table[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+std::uint32_t Crc32c::extend(std::uint32_t crc, const char* data, std::size_t length)
+{
+    return available.back().extend(crc, data, length);
+}
+
+Crc32c::Crc32c() : variant_(available.size() - 1), crc_(0)
+{
+}
+
+Crc32c::Crc32c(std::size_t variant) :
+    variant_(variant < available.size() ? variant : available.size() - 1), crc_(0)
+{
+}
+
+void Crc32c::update(const char* data, std::size_t length)
+{
+    crc_ = available[variant_].extend(crc_, data, length);
+}
+
+void Crc32c::finalize(Digest& digest)
+{
+    digest.algorithm = HashCrc32c;
+    digest.length = 4;
+    for (int i = 0; i < 4; ++i)
+        digest.bytes[i] = static_cast<unsigned char>(crc_ >> (24 - 8 * i));
+}
+
+void Crc32c::reset()
+{
+    crc_ = 0;
+}
+
+std::vector<const char*> Crc32c::supported()
+{
+    std::vector<const char*> names;
+    for (const Kernel& kernel : available)
+        names.push_back(kernel.name);
+    return names;
+}
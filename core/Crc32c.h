@@ -0,0 +1,47 @@
+/****************************** Module Header ******************************\
+Module Name:  Crc32c.h
+Project:      CppShellExtContextMenuHandler
+
+CRC-32C (Castagnoli polynomial, reflected 0x82F63B78), the CRC of iSCSI
+and ext4. CPUs with SSE4.2 compute it with the CRC32 instruction eight
+bytes at a time, others with slicing-by-8 tables.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include "Hasher.h"
+
+#include <vector>
+
+class Crc32c : public Hasher
+{
+public:
+    Crc32c();
+    //! Haponov - hasher with the kernel supported()[variant]
+    explicit Crc32c(std::size_t variant);
+
+    void update(const char* data, std::size_t length);
+    void finalize(Digest& digest);
+    void reset();
+
+    //! Haponov - CRC of crc's data followed by length more bytes, 0 is the
+    //            CRC of no data
+    static std::uint32_t extend(std::uint32_t crc, const char* data, std::size_t length);
+
+    //! Haponov - the table-driven extend(), reference for the instruction
+    static std::uint32_t software(std::uint32_t crc, const char* data, std::size_t length);
+
+    //! Haponov - every kernel this CPU can run, "software" first; the
+    //            last is the one extend() uses
+    static std::vector<const char*> supported();
+
+private:
+    std::size_t variant_;
+    std::uint32_t crc_;
+};
+
+#endif // CRC32C_H
@@ -0,0 +1,72 @@
+
+#include "DropFileList.h"
+
+#include <cstring>
+
+const std::size_t DropFileList::headerSize;
+
+DropFileList::DropFileList() : cursor_(NULL), end_(NULL), wide_(false)
+{
+}
+
+bool DropFileList::parse(const void* block, std::size_t size)
+{
+    cursor_ = NULL;
+    end_ = NULL;
+    if (!block || size < headerSize)
+        return false;
+
+    // DWORD pFiles at 0, BOOL fWide at 16, both little endian
+    const unsigned char* bytes = static_cast<const unsigned char*>(block);
+    std::uint32_t files;
+    std::int32_t wide;
+    std::memcpy(&files, bytes, sizeof(files));
+    std::memcpy(&wide, bytes + 16, sizeof(wide));
+    if (files < headerSize || files > size)
+        return false;
+
+    cursor_ = bytes + files;
+    end_ = bytes + size;
+    wide_ = wide != 0;
+    return true;
+}
+
+bool DropFileList::wide() const
+{
+    return wide_;
+}
+
+bool DropFileList::next(DropPath& path)
+{
+    if (!cursor_)
+        return false;
+
+    const unsigned char* start = cursor_;
+    std::size_t length = 0;
+    if (wide_)
+    {
+        // Two bytes a character, a trailing odd byte is not one
+        const unsigned char* p = start;
+        while (end_ - p >= 2 && (p[0] | p[1]))
+            p += 2;
+        length = static_cast<std::size_t>(p - start) / 2;
+        cursor_ = end_ - p >= 2 ? p + 2 : end_;
+    }
+    else
+    {
+        const void* nul = std::memchr(start, 0, static_cast<std::size_t>(end_ - start));
+        const unsigned char* p = nul ? static_cast<const unsigned char*>(nul) : end_;
+        length = static_cast<std::size_t>(p - start);
+        cursor_ = nul ? p + 1 : end_;
+    }
+
+    // The empty path ends the list
+    if (!length)
+    {
+        cursor_ = NULL;
+        return false;
+    }
+    path.text = start;
+    path.length = length;
+    return true;
+}
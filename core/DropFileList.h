@@ -0,0 +1,65 @@
+/****************************** Module Header ******************************\
+Module Name:  DropFileList.h
+Project:      CppShellExtContextMenuHandler
+
+Walks the paths of a DROPFILES block (the memory behind CF_HDROP) in one
+pass. DragQueryFile(hDrop, i) scans the list from its start for every
+index, which makes a large selection quadratic, and cuts every path at
+the buffer it is given; the list is read here directly instead.
+
+The block is a DROPFILES header followed, at pFiles, by NUL-terminated
+paths and an empty one at the end: UTF-16 when fWide is set, otherwise
+bytes of the ANSI code page. A path is handed out as a view into the block
+- nothing is copied, the block has to stay locked while the views are
+used. Any path length is allowed; a list that is not terminated ends with
+the block.
+
+The header is read by its byte offsets, so the parser does not need
+<windows.h> and takes a block of any alignment. The views are not
+realigned: a wide path is at an odd address when pFiles is odd, and is
+then to be copied out before it is read as wchar_t.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef DROPFILELIST_H
+#define DROPFILELIST_H
+
+#include <cstddef>
+#include <cstdint>
+
+//! Haponov - one path of the list, in the memory of the block
+struct DropPath
+{
+    //! UTF-16 code units when the list is wide, else ANSI bytes
+    const void* text;
+    //! in characters, the NUL not counted
+    std::size_t length;
+};
+
+class DropFileList
+{
+public:
+    //! Haponov - size of DROPFILES: pFiles, pt, fNC, fWide
+    static const std::size_t headerSize = 20;
+
+    DropFileList();
+
+    //! Haponov - start on the block of size bytes, false when it is not
+    //            a DROPFILES block
+    bool parse(const void* block, std::size_t size);
+
+    //! Haponov - the paths are UTF-16, not ANSI
+    bool wide() const;
+
+    //! Haponov - the next path, false after the last one
+    bool next(DropPath& path);
+
+private:
+    const unsigned char* cursor_;
+    const unsigned char* end_;
+    bool wide_;
+};
+
+#endif // DROPFILELIST_H
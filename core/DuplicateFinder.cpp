@@ -0,0 +1,215 @@
+
+#include "DuplicateFinder.h"
+#include "ParallelSort.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+const std::size_t DuplicateFinder::edgeSize;
+const HashAlgorithm DuplicateFinder::algorithm;
+
+namespace
+{
+    // A file still in the running, with the key of the last stage
+    struct Entry
+    {
+        std::size_t index;
+        std::uint64_t size;
+        Digest key;
+        bool readable;
+    };
+
+    int compareKeys(const Entry& a, const Entry& b)
+    {
+        if (a.size != b.size)
+            return a.size < b.size ? -1 : 1;
+        if (a.key.length != b.key.length)
+            return a.key.length < b.key.length ? -1 : 1;
+        return std::memcmp(a.key.bytes, b.key.bytes, a.key.length);
+    }
+
+    // Largest files first, equal keys next to each other and in the order
+    // of the selection
+    bool keyOrder(const Entry& a, const Entry& b)
+    {
+        int order = compareKeys(a, b);
+        return order > 0 || (order == 0 && a.index < b.index);
+    }
+}
+
+DuplicateFinder::DuplicateFinder(ThreadPool* pool, ContentFunc content) :
+    pool_(pool), content_(std::move(content)),
+    sized_(0), edgeHashed_(0), edgeBytes_(0), contentHashed_(0), contentBytes_(0), unreadable_(0)
+{
+}
+
+void DuplicateFinder::forEach(std::size_t count, const std::function <void(std::size_t)>& step)
+{
+    if (pool_)
+    {
+        ParallelSort::forEach(*pool_, count, step);
+        return;
+    }
+    for (std::size_t i = 0; i < count; ++i)
+        step(i);
+}
+
+bool DuplicateFinder::find(const std::vector <DuplicateFile>& files,
+                           std::vector <std::vector <std::size_t>>& groups,
+                           const CancellationToken& cancel)
+{
+    groups.clear();
+    sized_ = 0;
+    edgeHashed_ = 0;
+    edgeBytes_ = 0;
+    contentHashed_ = 0;
+    contentBytes_ = 0;
+    unreadable_ = 0;
+
+    std::vector <Entry> entries(files.size());
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        Entry& entry = entries[i];
+        entry.index = i;
+        entry.size = files[i].size;
+        entry.key.algorithm = algorithm;
+        entry.key.length = 0;
+        entry.readable = true;
+    }
+
+    // Sort by the key and keep the files that share it with another one
+    auto keepShared = [this, &entries]()
+    {
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry& entry) { return !entry.readable; }),
+                      entries.end());
+        if (pool_)
+            ParallelSort::sort(entries.begin(), entries.end(), keyOrder, *pool_);
+        else
+            std::sort(entries.begin(), entries.end(), keyOrder);
+
+        std::size_t kept = 0;
+        for (std::size_t first = 0, last; first < entries.size(); first = last)
+        {
+            for (last = first + 1; last < entries.size() && compareKeys(entries[first], entries[last]) == 0; ++last)
+                ;
+            if (last - first < 2)
+                continue;
+            for (std::size_t i = first; i < last; ++i)
+                entries[kept++] = entries[i];
+        }
+        entries.resize(kept);
+    };
+
+    //-------------------------
+    // Haponov: the size - from the caller where it is known
+
+    forEach(entries.size(), [&](std::size_t i)
+    {
+        Entry& entry = entries[i];
+        if (files[entry.index].sizeKnown)
+            return;
+        File file(files[entry.index].path);
+        ++sized_;
+        entry.readable = !cancel.cancelled() && file.isOpen() && file.size(entry.size);
+        if (!entry.readable)
+            ++unreadable_;
+    });
+    if (cancel.cancelled())
+        return false;
+    keepShared();
+
+    //-------------------------
+    // Haponov: the first and the last edgeSize bytes - the part of a file
+    // that differs most often, files of one format share their headers
+    // but rarely their ends; empty files are all the same. A file written
+    // since its size was taken is read, and then sorted, at its size now
+
+    forEach(entries.size(), [&](std::size_t i)
+    {
+        Entry& entry = entries[i];
+        if (!entry.size || cancel.cancelled())
+            return;
+
+        File file(files[entry.index].path);
+        if (!file.isOpen() || !file.size(entry.size))
+        {
+            entry.readable = false;
+            ++unreadable_;
+            return;
+        }
+        if (!entry.size)
+            return;
+
+        std::uint64_t head = std::min<std::uint64_t>(entry.size, edgeSize);
+        std::uint64_t tail = entry.size > 2 * edgeSize ? edgeSize : entry.size - head;
+        std::unique_ptr<char[]> buffer(new char[static_cast<std::size_t>(head + tail)]);
+        ++edgeHashed_;
+        entry.readable =
+            file.readAt(0, buffer.get(), static_cast<std::size_t>(head)) ==
+                static_cast<std::int64_t>(head) &&
+            (!tail || file.readAt(entry.size - tail, buffer.get() + head, static_cast<std::size_t>(tail)) ==
+                static_cast<std::int64_t>(tail));
+        if (!entry.readable)
+        {
+            ++unreadable_;
+            return;
+        }
+        edgeBytes_ += head + tail;
+
+        std::unique_ptr<Hasher> hasher = Hasher::create(algorithm);
+        hasher->update(buffer.get(), static_cast<std::size_t>(head + tail));
+        hasher->finalize(entry.key);
+    });
+    if (cancel.cancelled())
+        return false;
+    keepShared();
+
+    //-------------------------
+    // Haponov: the whole content of the files the edges do not cover
+
+    forEach(entries.size(), [&](std::size_t i)
+    {
+        Entry& entry = entries[i];
+        if (entry.size <= 2 * edgeSize || cancel.cancelled())
+            return;
+
+        File file(files[entry.index].path);
+        FileInfo info;
+        ++contentHashed_;
+        entry.readable = file.isOpen() && file.info(info) && info.identity.size == entry.size &&
+            (content_ ? content_(file, info, entry.key)
+                      : Hasher::ofFile(file, entry.size, algorithm, NULL, entry.key, cancel));
+        if (!entry.readable)
+        {
+            ++unreadable_;
+            return;
+        }
+        contentBytes_ += entry.size;
+    });
+    if (cancel.cancelled())
+        return false;
+    keepShared();
+
+    for (std::size_t first = 0, last; first < entries.size(); first = last)
+    {
+        groups.push_back(std::vector <std::size_t>());
+        for (last = first; last < entries.size() && compareKeys(entries[first], entries[last]) == 0; ++last)
+            groups.back().push_back(entries[last].index);
+    }
+    return true;
+}
+
+DuplicateCounters DuplicateFinder::counters() const
+{
+    DuplicateCounters counters;
+    counters.sized = sized_;
+    counters.edgeHashed = edgeHashed_;
+    counters.edgeBytes = edgeBytes_;
+    counters.contentHashed = contentHashed_;
+    counters.contentBytes = contentBytes_;
+    counters.unreadable = unreadable_;
+    return counters;
+}
@@ -0,0 +1,106 @@
+/****************************** Module Header ******************************\
+Module Name:  DuplicateFinder.h
+Project:      CppShellExtContextMenuHandler
+
+Finds the files of a selection that have the same content, reading as
+little of them as it can. The files go through three stages, and only the
+files that still share a bucket with another one go on to the next:
+  - size: a file whose size no other file has is unique and never read,
+  - edges: a hash of the first and the last 64 KB of the file; for a file
+    of up to 128 KB that is all of it. The size is taken again here, so
+    a file written since it was listed is compared at its size now,
+  - content: a hash of the whole file, for the longer files.
+A stage hashes its files on the threads of a ThreadPool and the calling
+thread (ParallelSort::forEach), then sorts them by size and hash, so the
+files of a bucket end up next to each other.
+
+Hashes are XXH3-128. The content hash may be given by the caller, which
+can take it from HashCache.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef DUPLICATEFINDER_H
+#define DUPLICATEFINDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Cancellation.h"
+#include "File.h"
+#include "Hasher.h"
+
+class ThreadPool;
+
+//! Haponov - one file of the selection; a file whose size is not known is
+//            opened to find it
+struct DuplicateFile
+{
+    const PathChar* path;
+    std::uint64_t size;
+    bool sizeKnown;
+};
+
+//! Haponov - how many files each stage had to open, and what it read
+struct DuplicateCounters
+{
+    std::uint64_t sized;
+    std::uint64_t edgeHashed;
+    std::uint64_t edgeBytes;
+    std::uint64_t contentHashed;
+    //! bytes of the files whose content was hashed - read unless the
+    //! content function found the hash elsewhere
+    std::uint64_t contentBytes;
+    std::uint64_t unreadable;
+};
+
+class DuplicateFinder
+{
+public:
+    //! Haponov - bytes hashed at each end of a file by the edge stage
+    static const std::size_t edgeSize = 64 << 10;
+    //! Haponov - algorithm of the edge and content hashes
+    static const HashAlgorithm algorithm = HashXxh3_128;
+
+    //! Haponov - the content hash of an open file, false when it cannot be
+    //            read; called on several threads at once
+    typedef std::function <bool(const File& file, const FileInfo& info,
+                                Digest& digest)> ContentFunc;
+
+    //! Haponov - pool may be NULL, the calling thread then reads alone;
+    //            without content the files are hashed with algorithm
+    DuplicateFinder(ThreadPool* pool, ContentFunc content = ContentFunc());
+
+    //! Haponov - groups of indices of files with the same content, two
+    //            files or more each, the largest files first; a file that
+    //            cannot be read is in none; false when cancelled
+    bool find(const std::vector <DuplicateFile>& files,
+              std::vector <std::vector <std::size_t>>& groups,
+              const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - counters of the last find
+    DuplicateCounters counters() const;
+
+private:
+    DuplicateFinder(const DuplicateFinder&);
+    DuplicateFinder& operator=(const DuplicateFinder&);
+
+    //! Haponov - call step(0) .. step(count - 1) on the pool, if any
+    void forEach(std::size_t count, const std::function <void(std::size_t)>& step);
+
+    ThreadPool* pool_;
+    ContentFunc content_;
+
+    std::atomic <std::uint64_t> sized_;
+    std::atomic <std::uint64_t> edgeHashed_;
+    std::atomic <std::uint64_t> edgeBytes_;
+    std::atomic <std::uint64_t> contentHashed_;
+    std::atomic <std::uint64_t> contentBytes_;
+    std::atomic <std::uint64_t> unreadable_;
+};
+
+#endif // DUPLICATEFINDER_H
@@ -0,0 +1,677 @@
+
+#include "File.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#ifdef _WIN32
+#include <cwchar>
+#include <cwctype>
+#include <unordered_map>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+const bool File::infoOfIsCurrent;
+
+namespace
+{
+    enum Stage { OpenStage, MetadataStage, ReadStage, WriteStage, MapStage, CloseStage, StageCount };
+
+    std::atomic <std::uint64_t> calls[StageCount];
+
+    void count(Stage stage, std::uint64_t n = 1)
+    {
+        calls[stage].fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+#ifdef _WIN32
+
+File::File() : handle_(INVALID_HANDLE_VALUE)
+{
+}
+
+bool File::open(const PathChar* path)
+{
+    close();
+
+    // Overlapped, so that positioned reads of several threads are not
+    // serialized on the file object
+    count(OpenStage);
+    handle_ = CreateFileW(path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+        NULL);
+    return isOpen();
+}
+
+bool File::openForAppend(const PathString& path)
+{
+    close();
+
+    count(OpenStage);
+    handle_ = CreateFileW(path.c_str(),
+        GENERIC_READ | FILE_APPEND_DATA,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+        NULL);
+    return isOpen();
+}
+
+bool File::createForAppend(const PathString& path)
+{
+    close();
+
+    // Cutting an existing file needs write access, not only appending
+    count(OpenStage);
+    handle_ = CreateFileW(path.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+        NULL);
+    return isOpen();
+}
+
+void File::close()
+{
+    if (isOpen())
+    {
+        count(CloseStage);
+        CloseHandle(handle_);
+        handle_ = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool File::isOpen() const
+{
+    return handle_ != INVALID_HANDLE_VALUE;
+}
+
+bool File::size(std::uint64_t& bytes) const
+{
+    LARGE_INTEGER fileSize;
+    count(MetadataStage);
+    if (!GetFileSizeEx(handle_, &fileSize))
+        return false;
+    bytes = static_cast<std::uint64_t>(fileSize.QuadPart);
+    return true;
+}
+
+std::int64_t File::readAt(std::uint64_t offset, void* buffer, std::size_t length) const
+{
+    char* out = static_cast<char*>(buffer);
+    std::size_t total = 0;
+
+    // The event and its handle are part of the cost of a read
+    count(ReadStage, 2);
+    HANDLE hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!hEvent)
+        return -1;
+
+    while (total < length)
+    {
+        OVERLAPPED ov = {};
+        ov.Offset = static_cast<DWORD>(offset + total);
+        ov.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+        ov.hEvent = hEvent;
+
+        std::size_t chunk = length - total;
+        DWORD toRead = chunk > 0x40000000 ? 0x40000000 : static_cast<DWORD>(chunk);
+        DWORD read = 0;
+        count(ReadStage, 2);
+        if (!ReadFile(handle_, out + total, toRead, NULL, &ov) &&
+            GetLastError() != ERROR_IO_PENDING)
+        {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            CloseHandle(hEvent);
+            return -1;
+        }
+        if (!GetOverlappedResult(handle_, &ov, &read, TRUE))
+        {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            CloseHandle(hEvent);
+            return -1;
+        }
+        if (!read)
+            break;
+        total += read;
+    }
+
+    CloseHandle(hEvent);
+    return static_cast<std::int64_t>(total);
+}
+
+namespace
+{
+    // FILETIME counts 100 ns from 1601
+    std::uint64_t unixNanoseconds(const FILETIME& time)
+    {
+        const std::uint64_t epochDifference = 116444736000000000ull;
+        std::uint64_t ticks = (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) |
+                              time.dwLowDateTime;
+        return ticks > epochDifference ? (ticks - epochDifference) * 100 : 0;
+    }
+}
+
+bool File::info(FileInfo& info) const
+{
+    BY_HANDLE_FILE_INFORMATION data;
+    count(MetadataStage);
+    if (!GetFileInformationByHandle(handle_, &data))
+        return false;
+
+    FileIdentity& id = info.identity;
+    id.volume = data.dwVolumeSerialNumber;
+    id.fileIdLow = (static_cast<std::uint64_t>(data.nFileIndexHigh) << 32) | data.nFileIndexLow;
+    id.fileIdHigh = 0;
+    id.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    id.lastWriteTime = unixNanoseconds(data.ftLastWriteTime);
+    info.creationTime = unixNanoseconds(data.ftCreationTime);
+    return true;
+}
+
+bool File::append(const void* data, std::size_t length)
+{
+    if (length > 0xFFFFFFFF)
+        return false;
+
+    count(WriteStage, 4);
+    HANDLE hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!hEvent)
+        return false;
+
+    // An offset of all ones writes at the end of file
+    OVERLAPPED ov = {};
+    ov.Offset = 0xFFFFFFFF;
+    ov.OffsetHigh = 0xFFFFFFFF;
+    ov.hEvent = hEvent;
+
+    DWORD written = 0;
+    bool ok = (WriteFile(handle_, data, static_cast<DWORD>(length), NULL, &ov) ||
+               GetLastError() == ERROR_IO_PENDING) &&
+              GetOverlappedResult(handle_, &ov, &written, TRUE) &&
+              written == length;
+
+    CloseHandle(hEvent);
+    return ok;
+}
+
+bool File::flush()
+{
+    count(WriteStage);
+    return FlushFileBuffers(handle_) != FALSE;
+}
+
+bool File::infoOf(const PathString& directory, const PathChar* const* names,
+                  std::size_t nameCount, FileInfo* infos, bool* found)
+{
+    std::fill(found, found + nameCount, false);
+
+    count(OpenStage);
+    HANDLE hDirectory = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (hDirectory == INVALID_HANDLE_VALUE)
+        return false;
+
+    // Every entry is on the volume of the directory
+    BY_HANDLE_FILE_INFORMATION data;
+    count(MetadataStage);
+    if (!GetFileInformationByHandle(hDirectory, &data))
+    {
+        count(CloseStage);
+        CloseHandle(hDirectory);
+        return false;
+    }
+    std::uint64_t volume = data.dwVolumeSerialNumber;
+
+    // Names differ in case only as far as towlower tells
+    std::unordered_map <std::wstring, std::size_t> wanted;
+    std::wstring key;
+    for (std::size_t i = 0; i < nameCount; ++i)
+    {
+        key = names[i];
+        for (std::size_t k = 0; k < key.size(); ++k)
+            key[k] = static_cast<wchar_t>(std::towlower(key[k]));
+        wanted.insert(std::make_pair(key, i));
+    }
+
+    // One call returns as many entries as fit into the buffer, with
+    // their ids, sizes and times; the scan stops once every name is found
+    std::vector<LONGLONG> buffer((64 << 10) / sizeof(LONGLONG));
+    FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+    std::size_t left = wanted.size();
+    bool ok = true;
+    while (left)
+    {
+        count(MetadataStage);
+        if (!GetFileInformationByHandleEx(hDirectory, infoClass, buffer.data(),
+                                          static_cast<DWORD>(buffer.size() * sizeof(LONGLONG))))
+        {
+            ok = GetLastError() == ERROR_NO_MORE_FILES;
+            break;
+        }
+        infoClass = FileIdBothDirectoryInfo;
+
+        const char* at = reinterpret_cast<const char*>(buffer.data());
+        for (;;)
+        {
+            const FILE_ID_BOTH_DIR_INFO& entry = *reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(at);
+            if (!(entry.FileAttributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_REPARSE_POINT)))
+            {
+                key.assign(entry.FileName, entry.FileNameLength / sizeof(wchar_t));
+                for (std::size_t k = 0; k < key.size(); ++k)
+                    key[k] = static_cast<wchar_t>(std::towlower(key[k]));
+                auto named = wanted.find(key);
+                if (named != wanted.end() && !found[named->second])
+                {
+                    FILETIME lastWrite = { entry.LastWriteTime.LowPart,
+                                           static_cast<DWORD>(entry.LastWriteTime.HighPart) };
+                    FILETIME creation = { entry.CreationTime.LowPart,
+                                          static_cast<DWORD>(entry.CreationTime.HighPart) };
+                    FileInfo& info = infos[named->second];
+                    info.identity.volume = volume;
+                    info.identity.fileIdLow = static_cast<std::uint64_t>(entry.FileId.QuadPart);
+                    info.identity.fileIdHigh = 0;
+                    info.identity.size = static_cast<std::uint64_t>(entry.EndOfFile.QuadPart);
+                    info.identity.lastWriteTime = unixNanoseconds(lastWrite);
+                    info.creationTime = unixNanoseconds(creation);
+                    found[named->second] = true;
+                    --left;
+                }
+            }
+            if (!entry.NextEntryOffset)
+                break;
+            at += entry.NextEntryOffset;
+        }
+    }
+
+    count(CloseStage);
+    CloseHandle(hDirectory);
+    return ok;
+}
+
+bool File::replace(const PathString& from, const PathString& to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+}
+
+const PathChar* File::longPathPrefix(const PathChar* path, std::size_t length, std::size_t& skip)
+{
+    // \\?\ turns off the parsing of the path, so only full paths with
+    // backslashes get it
+    skip = 0;
+    bool share = length >= 2 && path[0] == L'\\' && path[1] == L'\\';
+    if (share && length >= 4 && (path[2] == L'?' || path[2] == L'.') && path[3] == L'\\')
+        return NULL;
+    if (share)
+    {
+        skip = 1;
+        return L"\\\\?\\UNC";
+    }
+    if (length >= 3 && path[1] == L':' && path[2] == L'\\')
+        return L"\\\\?\\";
+    return NULL;
+}
+
+const PathChar* File::withoutLongPrefix(const PathChar* path, bool& share)
+{
+    // "\\?\UNC\server\share" is "\\server\share", "\\?\C:\" is "C:\"
+    share = std::wcsncmp(path, L"\\\\?\\UNC\\", 8) == 0;
+    if (share)
+        return path + 7;
+    if (std::wcsncmp(path, L"\\\\?\\", 4) == 0)
+        return path + 4;
+    return path;
+}
+
+FileView::FileView(const File& file, std::uint64_t size) :
+    data_(NULL), size_(0), mapping_(NULL)
+{
+    if (!size || size > static_cast<SIZE_T>(-1))
+        return;
+
+    count(MapStage);
+    mapping_ = CreateFileMappingW(file.handle_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_)
+        return;
+
+    count(MapStage);
+    data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0,
+                                                   static_cast<SIZE_T>(size)));
+    if (data_)
+        size_ = static_cast<std::size_t>(size);
+}
+
+FileView::~FileView()
+{
+    if (data_)
+    {
+        count(MapStage);
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_)
+    {
+        count(MapStage);
+        CloseHandle(mapping_);
+    }
+}
+
+#else
+
+File::File() : fd_(-1)
+{
+}
+
+bool File::open(const PathChar* path)
+{
+    close();
+    count(OpenStage);
+    fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+    return isOpen();
+}
+
+bool File::openForAppend(const PathString& path)
+{
+    close();
+    count(OpenStage);
+    fd_ = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    return isOpen();
+}
+
+bool File::createForAppend(const PathString& path)
+{
+    close();
+    count(OpenStage);
+    fd_ = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    return isOpen();
+}
+
+void File::close()
+{
+    if (isOpen())
+    {
+        count(CloseStage);
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool File::isOpen() const
+{
+    return fd_ >= 0;
+}
+
+bool File::size(std::uint64_t& bytes) const
+{
+    struct stat st;
+    count(MetadataStage);
+    if (fstat(fd_, &st) != 0)
+        return false;
+    bytes = static_cast<std::uint64_t>(st.st_size);
+    return true;
+}
+
+std::int64_t File::readAt(std::uint64_t offset, void* buffer, std::size_t length) const
+{
+    char* out = static_cast<char*>(buffer);
+    std::size_t total = 0;
+
+    while (total < length)
+    {
+        count(ReadStage);
+        ssize_t read = pread(fd_, out + total, length - total,
+                             static_cast<off_t>(offset + total));
+        if (read < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (!read)
+            break;
+        total += static_cast<std::size_t>(read);
+    }
+    return static_cast<std::int64_t>(total);
+}
+
+namespace
+{
+    void infoFromStat(const struct stat& st, FileInfo& info)
+    {
+        FileIdentity& id = info.identity;
+        id.volume = static_cast<std::uint64_t>(st.st_dev);
+        id.fileIdLow = static_cast<std::uint64_t>(st.st_ino);
+        id.fileIdHigh = 0;
+        id.size = static_cast<std::uint64_t>(st.st_size);
+#if defined(__APPLE__)
+        id.lastWriteTime = static_cast<std::uint64_t>(st.st_mtimespec.tv_sec) * 1000000000ull +
+                           static_cast<std::uint64_t>(st.st_mtimespec.tv_nsec);
+        info.creationTime = static_cast<std::uint64_t>(st.st_birthtimespec.tv_sec) * 1000000000ull +
+                            static_cast<std::uint64_t>(st.st_birthtimespec.tv_nsec);
+#else
+        id.lastWriteTime = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000ull +
+                           static_cast<std::uint64_t>(st.st_mtim.tv_nsec);
+        // stat has no birth time here
+        info.creationTime = 0;
+#endif
+    }
+}
+
+bool File::info(FileInfo& info) const
+{
+    struct stat st;
+    count(MetadataStage);
+    if (fstat(fd_, &st) != 0 || S_ISDIR(st.st_mode))
+        return false;
+
+    infoFromStat(st, info);
+    return true;
+}
+
+bool File::infoOf(const PathString& directory, const PathChar* const* names,
+                  std::size_t nameCount, FileInfo* infos, bool* found)
+{
+    std::fill(found, found + nameCount, false);
+
+    // Names are looked up relative to the open directory, so its path is
+    // resolved once; nothing is opened per file
+    count(OpenStage);
+    int dirFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0)
+        return false;
+
+    for (std::size_t i = 0; i < nameCount; ++i)
+    {
+        struct stat st;
+        count(MetadataStage);
+        if (fstatat(dirFd, names[i], &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode))
+        {
+            infoFromStat(st, infos[i]);
+            found[i] = true;
+        }
+    }
+
+    count(CloseStage);
+    ::close(dirFd);
+    return true;
+}
+
+bool File::append(const void* data, std::size_t length)
+{
+    // O_APPEND moves to the end of file and writes in one step
+    const char* in = static_cast<const char*>(data);
+    while (length)
+    {
+        count(WriteStage);
+        ssize_t written = write(fd_, in, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        in += written;
+        length -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+bool File::flush()
+{
+    count(WriteStage);
+    return fsync(fd_) == 0;
+}
+
+bool File::replace(const PathString& from, const PathString& to)
+{
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+const PathChar* File::longPathPrefix(const PathChar* path, std::size_t length, std::size_t& skip)
+{
+    (void)path;
+    (void)length;
+    skip = 0;
+    return NULL;
+}
+
+const PathChar* File::withoutLongPrefix(const PathChar* path, bool& share)
+{
+    share = false;
+    return path;
+}
+
+FileView::FileView(const File& file, std::uint64_t size) : data_(NULL), size_(0)
+{
+    if (!size || size > static_cast<std::size_t>(-1))
+        return;
+
+    count(MapStage, 2);
+    void* data = mmap(NULL, static_cast<std::size_t>(size), PROT_READ, MAP_PRIVATE,
+                      file.fd_, 0);
+    if (data == MAP_FAILED)
+        return;
+
+    // The view is read once from front to back
+    madvise(data, static_cast<std::size_t>(size), MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<std::size_t>(size);
+}
+
+FileView::~FileView()
+{
+    if (data_)
+    {
+        count(MapStage);
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+#endif
+
+bool FileView::isValid() const
+{
+    return data_ != NULL;
+}
+
+const char* FileView::data() const
+{
+    return data_;
+}
+
+std::size_t FileView::size() const
+{
+    return size_;
+}
+
+bool File::identity(FileIdentity& id) const
+{
+    FileInfo data;
+    if (!info(data))
+        return false;
+    id = data.identity;
+    return true;
+}
+
+IoCounters File::counters()
+{
+    IoCounters c;
+    c.opens = calls[OpenStage].load(std::memory_order_relaxed);
+    c.metadata = calls[MetadataStage].load(std::memory_order_relaxed);
+    c.reads = calls[ReadStage].load(std::memory_order_relaxed);
+    c.writes = calls[WriteStage].load(std::memory_order_relaxed);
+    c.maps = calls[MapStage].load(std::memory_order_relaxed);
+    c.closes = calls[CloseStage].load(std::memory_order_relaxed);
+    return c;
+}
+
+void File::countReads(std::uint64_t calls)
+{
+    count(ReadStage, calls);
+}
+
+std::uint64_t IoCounters::total() const
+{
+    return opens + metadata + reads + writes + maps + closes;
+}
+
+IoCounters IoCounters::since(const IoCounters& earlier) const
+{
+    IoCounters c;
+    c.opens = opens - earlier.opens;
+    c.metadata = metadata - earlier.metadata;
+    c.reads = reads - earlier.reads;
+    c.writes = writes - earlier.writes;
+    c.maps = maps - earlier.maps;
+    c.closes = closes - earlier.closes;
+    return c;
+}
+
+PathString File::longPath(const PathString& path)
+{
+    std::size_t skip;
+    const PathChar* prefix = longPathPrefix(path.c_str(), path.size(), skip);
+    if (!prefix)
+        return path;
+    return prefix + path.substr(skip);
+}
+
+File::File(const PathString& path) : File()
+{
+    open(path);
+}
+
+File::File(const PathChar* path) : File()
+{
+    open(path);
+}
+
+bool File::open(const PathString& path)
+{
+    return open(path.c_str());
+}
+
+File::~File()
+{
+    close();
+}
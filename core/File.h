@@ -0,0 +1,205 @@
+/****************************** Module Header ******************************\
+Module Name:  File.h
+Project:      CppShellExtContextMenuHandler
+
+Read-only file that is closed when the object goes away. Reads are
+positioned (they take an offset and do not use a shared file pointer), so
+several threads may read different parts of one file at the same time.
+FileView maps a whole file read-only into memory. On POSIX a mapped file
+that another process truncates faults on the pages past its new end
+(SIGBUS), so only files nobody else writes are mapped there.
+
+A file may also be opened for appending: every append goes to the end of
+the file as one write, also when other processes append to it.
+
+Every system call made by File and FileView is counted by stage (open,
+metadata, read, write, map, close), so the cost of handling a file can be
+seen per file.
+
+infoOf gives the metadata of several files of one directory without
+opening any of them: the directory is opened once and its entries are
+read in large batches (FileIdBothDirectoryInfo) on Windows, or each file
+is looked up relative to it (fstatat) on POSIX. The entries of an NTFS
+directory are brought up to date lazily, so there the size and last
+write time of a file still being written may lag behind what its handle
+says - see infoOfIsCurrent.
+
+Builds on Windows (CreateFile, overlapped ReadFile) and on POSIX systems
+(open, pread).
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef FILE_H
+#define FILE_H
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//! Haponov - native path string of the platform
+#ifdef _WIN32
+typedef std::wstring PathString;
+#else
+typedef std::string PathString;
+#endif
+
+//! Haponov - one character of a PathString
+typedef PathString::value_type PathChar;
+
+//! Haponov - what tells whether a file is still the one seen before: the
+//            file on its volume, its size and its last write time in
+//            nanoseconds since 1970 (dev/inode and st_mtim on POSIX)
+struct FileIdentity
+{
+    std::uint64_t volume;
+    std::uint64_t fileIdLow;
+    std::uint64_t fileIdHigh;
+    std::uint64_t size;
+    std::uint64_t lastWriteTime;
+};
+
+//! Haponov - everything one metadata query tells about an open file;
+//            creationTime is in nanoseconds since 1970, 0 where the file
+//            system does not keep it
+struct FileInfo
+{
+    FileIdentity identity;
+    std::uint64_t creationTime;
+};
+
+//! Haponov - system calls made by File and FileView in this process
+struct IoCounters
+{
+    std::uint64_t opens;
+    std::uint64_t metadata;
+    std::uint64_t reads;
+    std::uint64_t writes;
+    std::uint64_t maps;
+    std::uint64_t closes;
+
+    std::uint64_t total() const;
+    //! Haponov - the calls made after earlier was taken
+    IoCounters since(const IoCounters& earlier) const;
+};
+
+class File
+{
+public:
+    File();
+    //! Haponov - open path for reading, check isOpen()
+    explicit File(const PathString& path);
+    explicit File(const PathChar* path);
+    ~File();
+
+    bool open(const PathString& path);
+    bool open(const PathChar* path);
+    //! Haponov - open path for reading and appending, create it if missing
+    bool openForAppend(const PathString& path);
+    //! Haponov - the same for a file that starts empty, an existing one is
+    //            cut to nothing
+    bool createForAppend(const PathString& path);
+    void close();
+    bool isOpen() const;
+
+    //! Haponov - size in bytes, false on error
+    bool size(std::uint64_t& bytes) const;
+
+    //! Haponov - read up to length bytes at offset, returns the number of
+    //            bytes read (less than length only at the end of file)
+    //            or -1 on error; safe to call from several threads
+    std::int64_t readAt(std::uint64_t offset, void* buffer, std::size_t length) const;
+
+    //! Haponov - size, identity and times of the open file with one
+    //            query, false on error and for a directory, which POSIX
+    //            opens as well
+    bool info(FileInfo& info) const;
+
+    //! Haponov - identity of the open file, false on error
+    bool identity(FileIdentity& id) const;
+
+    //! Haponov - what info() would give for each of the nameCount files named
+    //            in directory, without opening them; found[i] is false for
+    //            a name that is missing, not a regular file or a link (it
+    //            is left to open()); false when directory cannot be read
+    static bool infoOf(const PathString& directory, const PathChar* const* names,
+                       std::size_t nameCount, FileInfo* infos, bool* found);
+    //! Haponov - whether infoOf reads the file itself, as info() does, so
+    //            that its identity may key a cache; on Windows it reads the
+    //            directory entry, which is good to show the file only
+#ifdef _WIN32
+    static const bool infoOfIsCurrent = false;
+#else
+    static const bool infoOfIsCurrent = true;
+#endif
+
+    //! Haponov - write length bytes at the end of a file opened for
+    //            appending, false unless all of them were written
+    bool append(const void* data, std::size_t length);
+
+    //! Haponov - push written data to the disk
+    bool flush();
+
+    //! Haponov - put the file from in place of to, replacing to at once
+    static bool replace(const PathString& from, const PathString& to);
+
+    //! Haponov - what goes in front of a full path so that it opens
+    //            whatever its length: "\\?\" for a drive path, "\\?\UNC"
+    //            for a share, in place of its first skip characters; NULL
+    //            for a path that is prefixed already or relative, and on POSIX
+    static const PathChar* longPathPrefix(const PathChar* path, std::size_t length,
+                                          std::size_t& skip);
+    //! Haponov - path with that prefix
+    static PathString longPath(const PathString& path);
+    //! Haponov - path as the user knows it, without that prefix: the rest
+    //            of path, after one backslash when share comes back true
+    static const PathChar* withoutLongPrefix(const PathChar* path, bool& share);
+
+    //! Haponov - counters of the whole process so far
+    static IoCounters counters();
+
+private:
+    File(const File&);
+    File& operator=(const File&);
+
+#ifdef _WIN32
+    HANDLE handle_;
+#else
+    int fd_;
+#endif
+
+    //! Haponov - count calls made to read the file outside of File
+    static void countReads(std::uint64_t calls);
+
+    friend class FileView;
+    friend class ReadAhead;
+};
+
+class FileView
+{
+public:
+    //! Haponov - map size bytes of an open file, check isValid()
+    FileView(const File& file, std::uint64_t size);
+    ~FileView();
+
+    bool isValid() const;
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    FileView(const FileView&);
+    FileView& operator=(const FileView&);
+
+    const char* data_;
+    std::size_t size_;
+#ifdef _WIN32
+    HANDLE mapping_;
+#endif
+};
+
+#endif // FILE_H
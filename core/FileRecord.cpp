@@ -0,0 +1,91 @@
+
+#include "FileRecord.h"
+
+#include <cstring>
+
+static_assert(sizeof(FileRecord) == 64, "FileRecord fits one cache line");
+
+StringArena::StringArena(MonotonicArena& memory) : memory_(memory), size_(0)
+{
+}
+
+const PathChar* StringArena::add(const PathChar* text, std::size_t length)
+{
+    return add(NULL, 0, text, length);
+}
+
+const PathChar* StringArena::add(const PathChar* prefix, std::size_t prefixLength,
+                                 const PathChar* text, std::size_t length)
+{
+    std::size_t total = prefixLength + length;
+    PathChar* copy = static_cast<PathChar*>(
+        memory_.allocate((total + 1) * sizeof(PathChar), alignof(PathChar)));
+    if (prefixLength)
+        std::memcpy(copy, prefix, prefixLength * sizeof(PathChar));
+    std::memcpy(copy + prefixLength, text, length * sizeof(PathChar));
+    copy[total] = 0;
+    size_ += total + 1;
+    return copy;
+}
+
+std::size_t StringArena::size() const
+{
+    return size_;
+}
+
+FileRecord FileRecord::waiting(const PathChar* path)
+{
+    FileRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.path = path;
+    record.stage = Waiting;
+
+    // The name follows the last separator; a path too long for nameStart
+    // is shown whole
+    std::size_t start = 0;
+    for (std::size_t i = 0; path[i]; ++i)
+    {
+        if (path[i] == '/' || path[i] == '\\')
+            start = i + 1;
+    }
+    if (start <= 0xFFFF)
+        record.nameStart = static_cast<std::uint16_t>(start);
+    return record;
+}
+
+const PathChar* FileRecord::name() const
+{
+    return path + nameStart;
+}
+
+void FileRecord::describe(const FileInfo& info)
+{
+    size = info.identity.size;
+    creationTime = info.creationTime;
+}
+
+void FileRecord::setTotals(const TreeTotals& totals)
+{
+    size = totals.bytes;
+    tree.files = totals.files;
+    tree.directories = totals.directories;
+    tree.unreadable = totals.unreadable;
+    tree.checksum = totals.checksum;
+}
+
+void FileRecord::setChecksum(const Digest& checksum)
+{
+    algorithm = static_cast<std::uint8_t>(checksum.algorithm);
+    digestLength = static_cast<std::uint8_t>(checksum.length);
+    std::memcpy(digest, checksum.bytes, sizeof(digest));
+    haveChecksum = true;
+}
+
+Digest FileRecord::checksum() const
+{
+    Digest result;
+    result.algorithm = static_cast<HashAlgorithm>(algorithm);
+    result.length = digestLength;
+    std::memcpy(result.bytes, digest, sizeof(result.bytes));
+    return result;
+}
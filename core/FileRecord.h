@@ -0,0 +1,119 @@
+/****************************** Module Header ******************************\
+Module Name:  FileRecord.h
+Project:      CppShellExtContextMenuHandler
+
+What the report knows about one file, kept as a plain record of numbers
+that fits one cache line: the path points into a StringArena shared by the
+batch, times are nanoseconds since 1970 and the checksum is the raw
+digest. Nothing is turned into text until a record is rendered or
+exported, so a large selection, or results that only go to the cache,
+build no strings at all.
+
+A selected directory gets a record too: size is then the bytes of the
+whole tree under it, and the place of the digest holds its totals.
+
+StringArena copies the paths of a batch back to back into the chunks of a
+MonotonicArena, each ending with a NUL, instead of one allocation per
+file; a copy never moves, so records point at it.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef FILERECORD_H
+#define FILERECORD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "File.h"
+#include "Hasher.h"
+#include "MonotonicArena.h"
+#include "TreeWalker.h"
+
+class StringArena
+{
+public:
+    //! Haponov - the copies live as long as memory is not released
+    explicit StringArena(MonotonicArena& memory);
+
+    //! Haponov - copy length characters of text and a NUL
+    const PathChar* add(const PathChar* text, std::size_t length);
+    //! Haponov - copy prefix, then text, as one string
+    const PathChar* add(const PathChar* prefix, std::size_t prefixLength,
+                        const PathChar* text, std::size_t length);
+
+    //! Haponov - characters copied so far, the NULs included
+    std::size_t size() const;
+
+private:
+    StringArena(const StringArena&);
+    StringArena& operator=(const StringArena&);
+
+    MonotonicArena& memory_;
+    std::size_t size_;
+};
+
+//! Haponov - one file of the batch
+struct FileRecord
+{
+    //! Haponov - the stages a file goes through, in this order
+    enum Stage
+    {
+        //! only the path is known
+        Waiting,
+        //! size and times are filled in, the checksum is being computed;
+        //! for a directory: the tree is being walked
+        Described,
+        //! size and times are filled in, the digest too if haveChecksum;
+        //! for a directory: size and tree
+        Checked,
+        //! the file could not be opened
+        Failed
+    };
+
+    //! the full path, in the StringArena of the batch
+    const PathChar* path;
+    //! the name WO the directories starts here in the path
+    std::uint16_t nameStart;
+    //! a Stage
+    std::uint8_t stage;
+    //! a HashAlgorithm, and the length of digest
+    std::uint8_t algorithm;
+    std::uint8_t digestLength;
+    bool haveChecksum;
+    //! the path names a directory
+    bool directory;
+    std::uint64_t size;
+    std::uint64_t creationTime;
+    union
+    {
+        unsigned char digest[32];
+        //! what is under a directory, its bytes are in size
+        struct
+        {
+            std::uint64_t files;
+            std::uint64_t directories;
+            std::uint64_t unreadable;
+            std::uint64_t checksum;
+        } tree;
+    };
+
+    //! Haponov - a Waiting record of path, which has to outlive it
+    static FileRecord waiting(const PathChar* path);
+
+    //! Haponov - the name WO the directories
+    const PathChar* name() const;
+
+    //! Haponov - take size and creation time of info
+    void describe(const FileInfo& info);
+
+    //! Haponov - take the totals of the tree under a directory
+    void setTotals(const TreeTotals& totals);
+
+    void setChecksum(const Digest& checksum);
+    //! Haponov - the digest as the hashers return it, when haveChecksum
+    Digest checksum() const;
+};
+
+#endif // FILERECORD_H
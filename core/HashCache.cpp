@@ -0,0 +1,482 @@
+
+#include "HashCache.h"
+#include "Crc32c.h"
+#include "Xxh3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <shlobj.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const std::uint64_t HashCache::defaultSizeLimit;
+const std::uint64_t HashCache::recentWriteWindow;
+
+namespace
+{
+    const char magic[8] = { 'A', 'V', 'I', 'D', 'H', 'A', 'S', 'H' };
+    const std::uint32_t formatVersion = 1;
+    const std::uint32_t recordTag = 0x52434841; // "AHCR"
+
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t recordSize;
+    };
+
+    // One entry as stored, little endian; crc covers everything after it
+    struct Record
+    {
+        std::uint32_t tag;
+        std::uint32_t crc;
+        std::uint64_t volume;
+        std::uint64_t fileIdLow;
+        std::uint64_t fileIdHigh;
+        std::uint64_t size;
+        std::uint64_t lastWriteTime;
+        std::uint32_t algorithm;
+        std::uint32_t length;
+        unsigned char bytes[32];
+    };
+
+    static_assert(sizeof(Header) == 16, "Header is stored as it is");
+    static_assert(sizeof(Record) == 88, "Record is stored as it is");
+
+    const std::size_t crcOffset = 8;
+
+    std::uint32_t recordCrc(const Record& record)
+    {
+        return Crc32c::extend(0, reinterpret_cast<const char*>(&record) + crcOffset,
+                              sizeof(Record) - crcOffset);
+    }
+
+    bool isValid(const Record& record)
+    {
+        return record.tag == recordTag &&
+               record.algorithm < HashAlgorithmCount &&
+               record.length <= sizeof(record.bytes) &&
+               record.crc == recordCrc(record);
+    }
+
+    Header makeHeader()
+    {
+        Header header;
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = formatVersion;
+        header.recordSize = sizeof(Record);
+        return header;
+    }
+
+    std::uint64_t now()
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    // Name of the temporary file of a compaction, one per process so that
+    // two processes compacting at once do not write into the same file
+    PathString temporaryPath(const PathString& path)
+    {
+#ifdef _WIN32
+        return path + L"." + std::to_wstring(GetCurrentProcessId()) + L".tmp";
+#else
+        return path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    }
+
+    void removeFile(const PathString& path)
+    {
+#ifdef _WIN32
+        DeleteFileW(path.c_str());
+#else
+        unlink(path.c_str());
+#endif
+    }
+
+    // The size and time of the cache file change with every append
+    bool sameFile(const FileIdentity& a, const FileIdentity& b)
+    {
+        return a.volume == b.volume && a.fileIdLow == b.fileIdLow &&
+               a.fileIdHigh == b.fileIdHigh;
+    }
+
+    std::mutex sharedLock;
+    HashCache* sharedCache = nullptr;
+}
+
+bool HashCache::Key::operator==(const Key& other) const
+{
+    return id.volume == other.id.volume &&
+           id.fileIdLow == other.id.fileIdLow &&
+           id.fileIdHigh == other.id.fileIdHigh &&
+           id.size == other.id.size &&
+           id.lastWriteTime == other.id.lastWriteTime &&
+           algorithm == other.algorithm;
+}
+
+std::size_t HashCache::KeyHash::operator()(const Key& key) const
+{
+    std::uint64_t fields[6] = { key.id.volume, key.id.fileIdLow, key.id.fileIdHigh,
+                                key.id.size, key.id.lastWriteTime, key.algorithm };
+    return static_cast<std::size_t>(Xxh3::hash64(reinterpret_cast<const char*>(fields),
+                                                 sizeof(fields)));
+}
+
+HashCache::HashCache(const PathString& path, std::uint64_t sizeLimit) :
+    path_(path), sizeLimit_(sizeLimit), loaded_(false), fileSize_(0), scanned_(0),
+    identity_(), sequence_(0)
+{
+}
+
+HashCache::~HashCache()
+{
+}
+
+void HashCache::add(const Key& key, std::uint32_t length, const unsigned char* bytes)
+{
+    Entry& entry = entries_[key];
+    entry.sequence = sequence_++;
+    entry.length = length;
+    std::memcpy(entry.bytes, bytes, length);
+}
+
+bool HashCache::load()
+{
+    scanned_ = 0;
+    if (path_.empty() || !file_.openForAppend(path_) || !file_.size(fileSize_) ||
+        !file_.identity(identity_))
+    {
+        file_.close();
+        return false;
+    }
+
+    if (fileSize_ == 0)
+    {
+        Header header = makeHeader();
+        if (!file_.append(&header, sizeof(header)))
+        {
+            file_.close();
+            return false;
+        }
+        fileSize_ = sizeof(header);
+        scanned_ = fileSize_;
+        return true;
+    }
+
+    bool formatOk = false;
+    {
+        FileView view(file_, fileSize_);
+        if (view.isValid() && view.size() >= sizeof(Header))
+        {
+            Header header;
+            std::memcpy(&header, view.data(), sizeof(header));
+            formatOk = std::memcmp(header.magic, magic, sizeof(magic)) == 0 &&
+                       header.version == formatVersion &&
+                       header.recordSize == sizeof(Record);
+        }
+        scanned_ = formatOk ? sizeof(Header) + readRecords(view.data() + sizeof(Header),
+                                                           view.size() - sizeof(Header)) :
+                              fileSize_;
+    }
+
+    // A file of another format is started over
+    if (!formatOk || fileSize_ > sizeLimit_)
+        compactLocked();
+    return file_.isOpen();
+}
+
+void HashCache::refresh()
+{
+    if (!loaded_)
+    {
+        loaded_ = true;
+        load();
+        return;
+    }
+
+    // Another process that compacted the cache has put a new file in its
+    // place; what is appended to the old one is lost with it
+    FileIdentity id;
+    File current(path_);
+    if (!file_.isOpen() || (current.isOpen() && current.identity(id) && sameFile(id, identity_)))
+        return;
+    current.close();
+    file_.close();
+    entries_.clear();
+    load();
+}
+
+std::size_t HashCache::readRecords(const char* data, std::size_t size)
+{
+    // A torn or overwritten record is skipped a byte at a time until the
+    // next valid one; a record cut by the end is read again next time
+    std::size_t offset = 0;
+    while (offset + sizeof(Record) <= size)
+    {
+        Record record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        if (!isValid(record))
+        {
+            ++offset;
+            continue;
+        }
+
+        Key key;
+        key.id.volume = record.volume;
+        key.id.fileIdLow = record.fileIdLow;
+        key.id.fileIdHigh = record.fileIdHigh;
+        key.id.size = record.size;
+        key.id.lastWriteTime = record.lastWriteTime;
+        key.algorithm = record.algorithm;
+        key.reserved = 0;
+        add(key, record.length, record.bytes);
+        offset += sizeof(Record);
+    }
+    return offset;
+}
+
+void HashCache::readTail()
+{
+    // The records appended since the file was read, by other processes
+    // and by this one
+    std::uint64_t size;
+    if (!file_.size(size) || size <= scanned_)
+        return;
+    std::vector<char> tail(static_cast<std::size_t>(size - scanned_));
+    std::int64_t read = file_.readAt(scanned_, tail.data(), tail.size());
+    if (read > 0)
+        scanned_ += readRecords(tail.data(), static_cast<std::size_t>(read));
+}
+
+bool HashCache::compactLocked()
+{
+    // Records other processes have appended are kept as well
+    readTail();
+
+    // The newest entries that fit into half of the limit, so that the next
+    // compaction is many appends away
+    std::vector<std::pair<std::uint64_t, const Key*> > order;
+    order.reserve(entries_.size());
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        order.push_back(std::make_pair(it->second.sequence, &it->first));
+    std::sort(order.begin(), order.end());
+
+    std::uint64_t room = sizeLimit_ / 2 > sizeof(Header) ? sizeLimit_ / 2 - sizeof(Header) : 0;
+    std::size_t keep = static_cast<std::size_t>((std::min)(room / sizeof(Record),
+                       static_cast<std::uint64_t>(order.size())));
+
+    std::vector<char> image(sizeof(Header) + keep * sizeof(Record));
+    Header header = makeHeader();
+    std::memcpy(image.data(), &header, sizeof(header));
+    char* out = image.data() + sizeof(header);
+    for (std::size_t i = order.size() - keep; i < order.size(); ++i)
+    {
+        const Key& key = *order[i].second;
+        const Entry& entry = entries_[key];
+
+        Record record = {};
+        record.tag = recordTag;
+        record.volume = key.id.volume;
+        record.fileIdLow = key.id.fileIdLow;
+        record.fileIdHigh = key.id.fileIdHigh;
+        record.size = key.id.size;
+        record.lastWriteTime = key.id.lastWriteTime;
+        record.algorithm = key.algorithm;
+        record.length = entry.length;
+        std::memcpy(record.bytes, entry.bytes, entry.length);
+        record.crc = recordCrc(record);
+        std::memcpy(out, &record, sizeof(record));
+        out += sizeof(record);
+    }
+
+    // The new file is complete on the disk before it replaces the old one
+    PathString temporary = temporaryPath(path_);
+    removeFile(temporary);
+    bool ok;
+    {
+        File out;
+        ok = out.openForAppend(temporary) && out.append(image.data(), image.size()) && out.flush();
+    }
+
+    file_.close();
+    ok = ok && File::replace(temporary, path_);
+    if (!ok)
+        removeFile(temporary);
+
+    FileIdentity id;
+    if (!file_.openForAppend(path_) || !file_.size(fileSize_) || !file_.identity(id))
+    {
+        file_.close();
+        return false;
+    }
+    if (!ok)
+    {
+        // Another process may have replaced the file meanwhile
+        if (!sameFile(id, identity_))
+        {
+            identity_ = id;
+            entries_.clear();
+            scanned_ = sizeof(Header);
+            readTail();
+        }
+        return false;
+    }
+    identity_ = id;
+    scanned_ = image.size();
+
+    for (std::size_t i = 0; i < order.size() - keep; ++i)
+    {
+        Key key = *order[i].second;
+        entries_.erase(key);
+    }
+    return true;
+}
+
+bool HashCache::lookup(const FileIdentity& id, HashAlgorithm algorithm, Digest& digest)
+{
+    std::unique_lock <std::mutex> l(lock_);
+    if (!sizeLimit_)
+        return false;
+    refresh();
+
+    Key key;
+    key.id = id;
+    key.algorithm = static_cast<std::uint32_t>(algorithm);
+    key.reserved = 0;
+
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+        return false;
+
+    digest.algorithm = algorithm;
+    digest.length = it->second.length;
+    std::memcpy(digest.bytes, it->second.bytes, it->second.length);
+    return true;
+}
+
+void HashCache::store(const FileIdentity& id, const Digest& digest)
+{
+    // The time stamp of a file that is still being written does not tell
+    // its content apart
+    if (now() < id.lastWriteTime + recentWriteWindow || digest.length > sizeof(Entry().bytes))
+        return;
+
+    std::unique_lock <std::mutex> l(lock_);
+    if (!sizeLimit_)
+        return;
+    refresh();
+    if (!file_.isOpen())
+        return;
+
+    Key key;
+    key.id = id;
+    key.algorithm = static_cast<std::uint32_t>(digest.algorithm);
+    key.reserved = 0;
+
+    auto it = entries_.find(key);
+    if (it != entries_.end() && it->second.length == digest.length &&
+        std::memcmp(it->second.bytes, digest.bytes, digest.length) == 0)
+        return;
+
+    Record record = {};
+    record.tag = recordTag;
+    record.volume = id.volume;
+    record.fileIdLow = id.fileIdLow;
+    record.fileIdHigh = id.fileIdHigh;
+    record.size = id.size;
+    record.lastWriteTime = id.lastWriteTime;
+    record.algorithm = key.algorithm;
+    record.length = static_cast<std::uint32_t>(digest.length);
+    std::memcpy(record.bytes, digest.bytes, digest.length);
+    record.crc = recordCrc(record);
+
+    if (!file_.append(&record, sizeof(record)))
+        return;
+    add(key, record.length, record.bytes);
+
+    fileSize_ += sizeof(record);
+    if (fileSize_ > sizeLimit_)
+    {
+        // Other processes may have appended too
+        if (file_.size(fileSize_) && fileSize_ > sizeLimit_)
+            compactLocked();
+    }
+}
+
+void HashCache::setSizeLimit(std::uint64_t bytes)
+{
+    std::unique_lock <std::mutex> l(lock_);
+    sizeLimit_ = bytes;
+    if (loaded_ && file_.isOpen() && sizeLimit_ && fileSize_ > sizeLimit_)
+        compactLocked();
+}
+
+bool HashCache::compact()
+{
+    std::unique_lock <std::mutex> l(lock_);
+    refresh();
+    return file_.isOpen() && compactLocked();
+}
+
+std::size_t HashCache::entries()
+{
+    std::unique_lock <std::mutex> l(lock_);
+    return entries_.size();
+}
+
+PathString HashCache::defaultPath()
+{
+#ifdef _WIN32
+    PWSTR folder = NULL;
+    HRESULT hr = SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, NULL, &folder);
+    PathString directory = SUCCEEDED(hr) ? PathString(folder) : PathString();
+    CoTaskMemFree(folder);
+    if (directory.empty())
+        return PathString();
+
+    directory += L"\\AVID-COM";
+    CreateDirectoryW(directory.c_str(), NULL);
+    return directory + L"\\checksums.cache";
+#else
+    PathString directory;
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (cacheHome && *cacheHome)
+        directory = cacheHome;
+    else if (home && *home)
+    {
+        directory = PathString(home) + "/.cache";
+        mkdir(directory.c_str(), 0700);
+    }
+    else
+        return PathString();
+
+    directory += "/avid-com";
+    mkdir(directory.c_str(), 0700);
+    return directory + "/checksums.cache";
+#endif
+}
+
+HashCache& HashCache::shared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    if (!sharedCache)
+        sharedCache = new HashCache(defaultPath());
+    return *sharedCache;
+}
+
+void HashCache::releaseShared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    delete sharedCache;
+    sharedCache = nullptr;
+}
@@ -0,0 +1,127 @@
+/****************************** Module Header ******************************\
+Module Name:  HashCache.h
+Project:      CppShellExtContextMenuHandler
+
+Persistent cache of file checksums. An entry is found by the identity of
+a file (volume and file ID, size, last write time) and the algorithm, so
+a file that is changed, replaced or moved to another volume is hashed
+again.
+
+The cache file is a header followed by fixed-size records that are only
+ever appended; a later record for the same key wins. Every record carries
+a CRC32C of itself, so a record torn by a crash is skipped when the file
+is mapped and read at the start. When the file grows over its size limit
+it is compacted: the newest live records are written to a temporary file
+that then replaces the cache in one rename, so a crash leaves either the
+old or the new file.
+
+Several processes may share the cache file. Before it is compacted, the
+records the others have appended since it was read are read as well, and
+every lookup and store first checks that the file at the path is still
+the one open: when another process has compacted it, the new file is read
+and written from then on.
+
+Files written within the last two seconds are not cached: their time
+stamp could stay the same after another write of the same size.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "File.h"
+#include "Hasher.h"
+
+class HashCache
+{
+public:
+    //! Haponov - cache kept in the file at path, compacted when it grows
+    //            over sizeLimit bytes; it is read on the first lookup
+    explicit HashCache(const PathString& path, std::uint64_t sizeLimit = defaultSizeLimit);
+    ~HashCache();
+
+    //! Haponov - the digest stored for the file and algorithm, false if
+    //            there is none
+    bool lookup(const FileIdentity& id, HashAlgorithm algorithm, Digest& digest);
+
+    //! Haponov - remember the digest of the file
+    void store(const FileIdentity& id, const Digest& digest);
+
+    //! Haponov - 0 turns the cache off
+    void setSizeLimit(std::uint64_t bytes);
+
+    //! Haponov - rewrite the file with the newest live records that fit
+    //            into half of the size limit, false if it failed
+    bool compact();
+
+    //! Haponov - number of entries in memory
+    std::size_t entries();
+
+    //! Haponov - process-wide cache in the default location
+    static HashCache& shared();
+
+    //! Haponov - close the shared cache, it opens again on the next use
+    static void releaseShared();
+
+    //! Haponov - %LOCALAPPDATA%\AVID-COM\checksums.cache, or
+    //            $XDG_CACHE_HOME (~/.cache)/avid-com/checksums.cache
+    static PathString defaultPath();
+
+    static const std::uint64_t defaultSizeLimit = 8ull << 20;
+    //! Haponov - files written this recently (ns) are not cached
+    static const std::uint64_t recentWriteWindow = 2000000000ull;
+
+    struct Key
+    {
+        FileIdentity id;
+        std::uint32_t algorithm;
+        std::uint32_t reserved;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const;
+    };
+
+private:
+    HashCache(const HashCache&);
+    HashCache& operator=(const HashCache&);
+
+    struct Entry
+    {
+        std::uint64_t sequence;
+        std::uint32_t length;
+        unsigned char bytes[32];
+    };
+
+    bool load();
+    void refresh();
+    std::size_t readRecords(const char* data, std::size_t size);
+    void readTail();
+    bool compactLocked();
+    void add(const Key& key, std::uint32_t length, const unsigned char* bytes);
+
+    PathString path_;
+    std::uint64_t sizeLimit_;
+
+    std::mutex lock_;
+    bool loaded_;
+    File file_;
+    std::uint64_t fileSize_;
+    //! Haponov - the file is read up to here
+    std::uint64_t scanned_;
+    FileIdentity identity_;
+    std::uint64_t sequence_;
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+};
+
+#endif // HASHCACHE_H
@@ -0,0 +1,214 @@
+
+#include "Hasher.h"
+#include "ByteSum.h"
+#include "CheckSum.h"
+#include "Crc32c.h"
+#include "ReadAhead.h"
+#include "Sha256.h"
+#include "Xxh3.h"
+
+#include <cctype>
+
+const std::size_t Digest::textSize;
+
+namespace
+{
+    const char* const names[HashAlgorithmCount] = {
+        "sum", "crc32c", "xxh3-64", "xxh3-128", "sha256", "sum64"
+    };
+
+    // The ala checksum as a stream: the last byte seen is counted once
+    // more at the end, as CheckSum::LegacyEndOfFile does
+    class AlaSum : public Hasher
+    {
+    public:
+        explicit AlaSum(HashAlgorithm algorithm) : algorithm_(algorithm)
+        {
+            reset();
+        }
+
+        void update(const char* data, std::size_t length)
+        {
+            if (!length)
+                return;
+            sum_ += ByteSum::sum(data, length);
+            last_ = data[length - 1];
+            empty_ = false;
+        }
+
+        void finalize(Digest& digest)
+        {
+            std::int64_t sum = sum_;
+            if (!empty_)
+                sum += static_cast<signed char>(last_);
+            store(algorithm_, sum, digest);
+        }
+
+        void reset()
+        {
+            sum_ = 0;
+            last_ = 0;
+            empty_ = true;
+        }
+
+        // The 32-bit checksum keeps the low half of the sum
+        static void store(HashAlgorithm algorithm, std::int64_t sum, Digest& digest)
+        {
+            std::uint64_t bits = static_cast<std::uint64_t>(sum);
+            digest.algorithm = algorithm;
+            digest.length = algorithm == HashAlaSum64 ? 8 : 4;
+            for (std::size_t i = 0; i < digest.length; ++i)
+                digest.bytes[i] = static_cast<unsigned char>(bits >> (8 * (digest.length - 1 - i)));
+        }
+
+    private:
+        HashAlgorithm algorithm_;
+        std::int64_t sum_;
+        char last_;
+        bool empty_;
+    };
+
+    // Feed a whole file to a hasher, the same way CheckSum reads it, just
+    // in order from the first block to the last
+    bool streamFile(const File& file, std::uint64_t size, Hasher& hasher,
+                    const CancellationToken& cancel)
+    {
+        if (CheckSum::mapsFiles && size > CheckSum::blockReadLimit &&
+            size < CheckSum::parallelThreshold)
+        {
+            FileView view(file, size);
+            if (view.isValid())
+            {
+                for (std::size_t offset = 0; offset < view.size(); offset += CheckSum::blockSize)
+                {
+                    if (cancel.cancelled())
+                        return false;
+                    std::size_t length = view.size() - offset;
+                    hasher.update(view.data() + offset,
+                                  length < CheckSum::blockSize ? length : CheckSum::blockSize);
+                }
+                return true;
+            }
+        }
+
+        ReadAhead reader(file, 0, size, CheckSum::blockSize, CheckSum::readAheadDepth);
+        const char* data;
+        std::size_t read;
+        std::uint64_t total = 0;
+        while (!cancel.cancelled() && reader.next(data, read))
+        {
+            hasher.update(data, read);
+            total += read;
+        }
+        if (reader.failed() || total != size)
+            return false;
+        return true;
+    }
+}
+
+std::string Digest::toString() const
+{
+    char text[textSize];
+    return std::string(text, format(text));
+}
+
+std::size_t Digest::format(char* text) const
+{
+    if (algorithm == HashAlaSum || algorithm == HashAlaSum64)
+    {
+        std::uint64_t bits = 0;
+        for (std::size_t i = 0; i < length; ++i)
+            bits = (bits << 8) | bytes[i];
+
+        // The 64-bit sum is signed, the ala checksum is its low 32 bits
+        std::size_t count = 0;
+        bool negative = algorithm == HashAlaSum64 && static_cast<std::int64_t>(bits) < 0;
+        if (negative)
+        {
+            text[count++] = '-';
+            bits = 0 - bits;
+        }
+        char digits[20];
+        std::size_t digitCount = 0;
+        do
+        {
+            digits[digitCount++] = static_cast<char>('0' + bits % 10);
+            bits /= 10;
+        } while (bits);
+        while (digitCount)
+            text[count++] = digits[--digitCount];
+        text[count] = 0;
+        return count;
+    }
+
+    static const char hex[] = "0123456789abcdef";
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        text[2 * i] = hex[bytes[i] >> 4];
+        text[2 * i + 1] = hex[bytes[i] & 0xF];
+    }
+    text[2 * length] = 0;
+    return 2 * length;
+}
+
+std::unique_ptr<Hasher> Hasher::create(HashAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case HashCrc32c:
+        return std::unique_ptr<Hasher>(new Crc32c());
+    case HashXxh3_64:
+        return std::unique_ptr<Hasher>(new Xxh3(false));
+    case HashXxh3_128:
+        return std::unique_ptr<Hasher>(new Xxh3(true));
+    case HashSha256:
+        return std::unique_ptr<Hasher>(new Sha256());
+    case HashAlaSum64:
+        return std::unique_ptr<Hasher>(new AlaSum(HashAlaSum64));
+    default:
+        return std::unique_ptr<Hasher>(new AlaSum(HashAlaSum));
+    }
+}
+
+const char* Hasher::name(HashAlgorithm algorithm)
+{
+    if (algorithm < 0 || algorithm >= HashAlgorithmCount)
+        return names[HashAlaSum];
+    return names[algorithm];
+}
+
+bool Hasher::fromName(const std::string& name, HashAlgorithm& algorithm)
+{
+    std::string lower(name);
+    for (std::size_t i = 0; i < lower.size(); ++i)
+        lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(lower[i])));
+
+    for (int i = 0; i < HashAlgorithmCount; ++i)
+    {
+        if (lower == names[i])
+        {
+            algorithm = static_cast<HashAlgorithm>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Hasher::ofFile(const File& file, std::uint64_t size, HashAlgorithm algorithm,
+                    ThreadPool* pool, Digest& digest, const CancellationToken& cancel)
+{
+    if (algorithm == HashAlaSum || algorithm == HashAlaSum64)
+    {
+        std::int64_t sum = 0;
+        if (!CheckSum::ofFile(file, size, pool, sum, CheckSum::LegacyEndOfFile, cancel))
+            return false;
+        AlaSum::store(algorithm, sum, digest);
+        return true;
+    }
+
+    std::unique_ptr<Hasher> hasher = create(algorithm);
+    if (!streamFile(file, size, *hasher, cancel))
+        return false;
+    hasher->finalize(digest);
+    return true;
+}
@@ -0,0 +1,98 @@
+/****************************** Module Header ******************************\
+Module Name:  Hasher.h
+Project:      CppShellExtContextMenuHandler
+
+Streaming hash of a byte sequence: the data is given to update() in pieces
+of any size and finalize() produces the digest. The algorithms are:
+  - the "ala checksum" of CheckSum, the default, kept so that the values
+    shown stay the same as in the first versions (the low 32 bits of the
+    sum), and the whole 64-bit sum, which does not wrap around on large
+    files,
+  - CRC32C (Castagnoli), with the SSE4.2 CRC32 instruction,
+  - XXH3 with 64 and 128 bit results, seed 0 and the default secret,
+  - SHA-256, with the SHA extensions when the CPU has them.
+
+Every algorithm has a short name, used to configure it and to label the
+results.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef HASHER_H
+#define HASHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Cancellation.h"
+#include "File.h"
+
+class ThreadPool;
+
+enum HashAlgorithm
+{
+    HashAlaSum,
+    HashCrc32c,
+    HashXxh3_64,
+    HashXxh3_128,
+    HashSha256,
+    HashAlaSum64,
+    HashAlgorithmCount
+};
+
+//! Haponov - result of a hasher, the bytes in the order they are printed
+struct Digest
+{
+    HashAlgorithm algorithm;
+    std::size_t length;
+    unsigned char bytes[32];
+
+    //! Haponov - room for the longest text of a digest and its NUL
+    static const std::size_t textSize = 2 * 32 + 1;
+
+    //! Haponov - decimal for the ala checksums, hex digits for the others
+    std::string toString() const;
+    //! Haponov - the same text into text[textSize], without allocating;
+    //            returns its length
+    std::size_t format(char* text) const;
+};
+
+class Hasher
+{
+public:
+    virtual ~Hasher() {}
+
+    //! Haponov - add length bytes to the hashed data
+    virtual void update(const char* data, std::size_t length) = 0;
+
+    //! Haponov - digest of all data given since construction or reset(),
+    //            the hasher must be reset before it takes new data
+    virtual void finalize(Digest& digest) = 0;
+
+    //! Haponov - start over with no data
+    virtual void reset() = 0;
+
+    //! Haponov - new hasher of the algorithm
+    static std::unique_ptr<Hasher> create(HashAlgorithm algorithm);
+
+    //! Haponov - short name such as "crc32c"
+    static const char* name(HashAlgorithm algorithm);
+
+    //! Haponov - algorithm of a short name, case insensitive; false if
+    //            there is none
+    static bool fromName(const std::string& name, HashAlgorithm& algorithm);
+
+    //! Haponov - digest of an open file of the given size. The ala checksum
+    //            goes through CheckSum, so large files are summed in
+    //            parallel ranges when a pool is given; the other
+    //            algorithms read the file in order. False on a read error
+    //            and when cancel is cancelled, checked between blocks
+    static bool ofFile(const File& file, std::uint64_t size, HashAlgorithm algorithm,
+                       ThreadPool* pool, Digest& digest,
+                       const CancellationToken& cancel = CancellationToken());
+};
+
+#endif // HASHER_H
@@ -0,0 +1,282 @@
+
+#include "IoScheduler.h"
+#include "ThreadPool.h"
+
+#ifdef _WIN32
+#include <winioctl.h>
+#include <cwchar>
+#include <cwctype>
+#include <vector>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#endif
+#endif
+
+const unsigned IoScheduler::solidStateReaders;
+const unsigned IoScheduler::rotationalReaders;
+const unsigned IoScheduler::remoteReaders;
+
+namespace
+{
+    std::mutex sharedLock;
+    IoScheduler* sharedScheduler = nullptr;
+}
+
+#ifdef _WIN32
+
+bool IoScheduler::volumeOf(const PathChar* path, PathString& volume)
+{
+    // The root is a part of the path and a backslash at most, a long path
+    // gets a buffer of its own length
+    wchar_t shortRoot[MAX_PATH];
+    std::vector<wchar_t> longRoot;
+    std::size_t length = std::wcslen(path) + 2;
+    wchar_t* root = shortRoot;
+    if (length > ARRAYSIZE(shortRoot))
+    {
+        longRoot.resize(length);
+        root = longRoot.data();
+    }
+    else
+        length = ARRAYSIZE(shortRoot);
+    if (!GetVolumePathNameW(path, root, static_cast<DWORD>(length)))
+        return false;
+
+    // A long path comes with the \\?\ prefix, its volume is the same as
+    // without it: "\\?\C:\" is "C:\", "\\?\UNC\server\share\" is
+    // "\\server\share\"
+    if (std::wcsncmp(root, L"\\\\?\\UNC\\", 8) == 0)
+    {
+        root += 6;
+        root[0] = L'\\';
+    }
+    else if (std::wcsncmp(root, L"\\\\?\\", 4) == 0 && root[4] && root[5] == L':')
+        root += 4;
+
+    // The same volume may be spelled in upper or lower case
+    volume = root;
+    for (std::size_t i = 0; i < volume.size(); ++i)
+        volume[i] = static_cast<wchar_t>(std::towlower(volume[i]));
+    return true;
+}
+
+IoScheduler::Media IoScheduler::mediaOf(const PathChar* path, const PathString& volume)
+{
+    (void)path;
+    if (GetDriveTypeW(volume.c_str()) == DRIVE_REMOTE)
+        return Remote;
+
+    // \\?\Volume{GUID}\ - a UNC share has no such name
+    wchar_t name[MAX_PATH];
+    if (!GetVolumeNameForVolumeMountPointW(volume.c_str(), name, ARRAYSIZE(name)))
+        return volume.compare(0, 2, L"\\\\") == 0 ? Remote : UnknownMedia;
+    std::wstring device(name);
+    if (!device.empty() && device[device.size() - 1] == L'\\')
+        device.erase(device.size() - 1);
+
+    // Storage properties are queried without any access rights, so this
+    // works without elevation
+    HANDLE hDevice = CreateFileW(device.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 NULL, OPEN_EXISTING, 0, NULL);
+    if (hDevice == INVALID_HANDLE_VALUE)
+        return UnknownMedia;
+
+    STORAGE_PROPERTY_QUERY query = {};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+    DEVICE_SEEK_PENALTY_DESCRIPTOR penalty = {};
+    DWORD returned = 0;
+    BOOL ok = DeviceIoControl(hDevice, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+                              &penalty, sizeof(penalty), &returned, NULL);
+    CloseHandle(hDevice);
+
+    // A volume that spans several disks has no single answer
+    if (!ok || returned < sizeof(penalty))
+        return UnknownMedia;
+    return penalty.IncursSeekPenalty ? Rotational : SolidState;
+}
+
+#else
+
+bool IoScheduler::volumeOf(const PathChar* path, PathString& volume)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+
+    volume = std::to_string(major(st.st_dev)) + ":" + std::to_string(minor(st.st_dev));
+    return true;
+}
+
+IoScheduler::Media IoScheduler::mediaOf(const PathChar* path, const PathString& volume)
+{
+#ifdef __linux__
+    struct statfs fs;
+    if (statfs(path, &fs) == 0)
+    {
+        // NFS, SMB, CIFS and SMB2
+        std::uint32_t type = static_cast<std::uint32_t>(fs.f_type);
+        if (type == 0x6969 || type == 0x517B || type == 0xFF534D42 || type == 0xFE534D42)
+            return Remote;
+    }
+
+    // A partition has no queue of its own, its disk has
+    const char* const queues[] = { "/queue/rotational", "/../queue/rotational" };
+    for (const char* queue : queues)
+    {
+        std::ifstream flag("/sys/dev/block/" + volume + queue);
+        char rotational;
+        if (flag >> rotational)
+            return rotational == '1' ? Rotational : SolidState;
+    }
+#else
+    (void)path;
+    (void)volume;
+#endif
+    return UnknownMedia;
+}
+
+#endif
+
+bool IoScheduler::Device::parallelReads() const
+{
+    return readers == 0;
+}
+
+IoScheduler::IoScheduler()
+{
+}
+
+IoScheduler::Device& IoScheduler::device(const PathChar* path)
+{
+    // Files that cannot be examined share one device without a limit
+    PathString volume;
+    if (!volumeOf(path, volume))
+        return device(PathString(), UnknownMedia, readersFor(UnknownMedia));
+
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        auto found = devices_.find(volume);
+        if (found != devices_.end())
+            return *found->second;
+    }
+
+    // Examined without the lock, it may take a while on a network share;
+    // another thread may add the same device meanwhile, the first one wins
+    Media media = mediaOf(path, volume);
+    return device(volume, media, readersFor(media));
+}
+
+IoScheduler::Device& IoScheduler::device(const PathString& volume, Media media, unsigned readers)
+{
+    std::unique_lock <std::mutex> l(lock_);
+    std::unique_ptr <Device>& entry = devices_[volume];
+    if (!entry)
+    {
+        entry.reset(new Device());
+        entry->volume = volume;
+        entry->media = media;
+        entry->readers = readers;
+        entry->running_ = 0;
+    }
+    return *entry;
+}
+
+void IoScheduler::doJob(ThreadPool& pool, JobGroup& group, Device& device,
+                        std::function <void(void)> func)
+{
+    // The group counts the job while it waits in the queue of the device
+    group.add();
+    Job job = { &pool, &group, std::move(func) };
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        if (device.readers && device.running_ >= device.readers)
+        {
+            device.waiting_.push_back(std::move(job));
+            return;
+        }
+        ++device.running_;
+    }
+    start(device, job);
+}
+
+void IoScheduler::start(Device& device, const Job& job)
+{
+    // The next job of the device is started before the group hears of
+    // this one, the owner of the group may go away right after that
+    Device* target = &device;
+    Job current = job;
+    job.pool->doJob([this, target, current]()
+    {
+        // A cancelled batch drops the jobs that have not started yet
+        if (!current.group->cancelled())
+            current.func();
+        finished(*target);
+        current.group->done();
+    });
+}
+
+void IoScheduler::finished(Device& device)
+{
+    Job next;
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        if (device.waiting_.empty())
+        {
+            --device.running_;
+            return;
+        }
+        next = std::move(device.waiting_.front());
+        device.waiting_.pop_front();
+    }
+    start(device, next);
+}
+
+unsigned IoScheduler::readersFor(Media media)
+{
+    switch (media)
+    {
+    case Rotational:
+        return rotationalReaders;
+    case Remote:
+        return remoteReaders;
+    default:
+        return solidStateReaders;
+    }
+}
+
+const char* IoScheduler::name(Media media)
+{
+    switch (media)
+    {
+    case SolidState:
+        return "solid state";
+    case Rotational:
+        return "rotational";
+    case Remote:
+        return "remote";
+    default:
+        return "unknown";
+    }
+}
+
+IoScheduler& IoScheduler::shared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    if (!sharedScheduler)
+        sharedScheduler = new IoScheduler();
+    return *sharedScheduler;
+}
+
+void IoScheduler::releaseShared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    delete sharedScheduler;
+    sharedScheduler = nullptr;
+}
@@ -0,0 +1,130 @@
+/****************************** Module Header ******************************\
+Module Name:  IoScheduler.h
+Project:      CppShellExtContextMenuHandler
+
+Hands jobs that read files to a ThreadPool device by device. Every device
+(volume on Windows, st_dev on POSIX) has its own queue and its own limit of
+jobs that run at the same time:
+  - solid state and unknown devices: no limit, the pool size caps them,
+  - rotational disks: one reader, parallel sequential readers would make
+    the heads seek between the files and read slower than one reader,
+  - network shares: a few readers, to hide the latency of the round trips.
+
+The kind of a device is found once, the first time a file on it is seen:
+the seek penalty the storage driver reports (Windows) or the rotational
+flag of the block queue in sysfs (Linux); a drive or file system that is
+remote counts as a network share.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "File.h"
+
+class JobGroup;
+class ThreadPool;
+
+class IoScheduler
+{
+public:
+    //! Haponov - what a device is made of, as far as it can be told
+    enum Media
+    {
+        SolidState,
+        Rotational,
+        Remote,
+        UnknownMedia
+    };
+
+    //! Haponov - jobs of one device at a time for each kind of media,
+    //            0 - no limit
+    static const unsigned solidStateReaders = 0;
+    static const unsigned rotationalReaders = 1;
+    static const unsigned remoteReaders = 2;
+
+private:
+    struct Job
+    {
+        ThreadPool* pool;
+        JobGroup* group;
+        std::function <void(void)> func;
+    };
+
+public:
+    //! Haponov - a device and its queue, lives as long as the scheduler
+    class Device
+    {
+    public:
+        //! Haponov - volume root path, or the device number on POSIX
+        PathString volume;
+        Media media;
+        //! Haponov - jobs of the device that may run at the same time,
+        //            0 - no limit
+        unsigned readers;
+
+        //! Haponov - whether one file may be read by several threads
+        bool parallelReads() const;
+
+    private:
+        friend class IoScheduler;
+
+        unsigned running_;
+        std::deque <Job> waiting_;
+    };
+
+    IoScheduler();
+
+    //! Haponov - the device that holds the file at path, found the first
+    //            time it is asked for; a path that cannot be examined
+    //            gets a device of unknown media of its own
+    Device& device(const PathChar* path);
+
+    //! Haponov - a device with the given media and limit, for tests and
+    //            benchmarks that simulate slow devices
+    Device& device(const PathString& volume, Media media, unsigned readers);
+
+    //! Haponov - run func on pool once the device has a free reader;
+    //            group.done() is called when it finishes or is dropped
+    //            because the batch was cancelled
+    void doJob(ThreadPool& pool, JobGroup& group, Device& device,
+               std::function <void(void)> func);
+
+    //! Haponov - the volume that holds the file at path, false if the
+    //            path cannot be examined
+    static bool volumeOf(const PathChar* path, PathString& volume);
+
+    //! Haponov - media of the volume found by volumeOf for path
+    static Media mediaOf(const PathChar* path, const PathString& volume);
+
+    static unsigned readersFor(Media media);
+
+    static const char* name(Media media);
+
+    //! Haponov - process-wide scheduler, created on first use
+    static IoScheduler& shared();
+
+    //! Haponov - destroy the shared scheduler, only when the pools that
+    //            run its jobs are idle
+    static void releaseShared();
+
+private:
+    IoScheduler(const IoScheduler&);
+    IoScheduler& operator=(const IoScheduler&);
+
+    void start(Device& device, const Job& job);
+    void finished(Device& device);
+
+    std::mutex lock_;
+    std::unordered_map <PathString, std::unique_ptr <Device>> devices_;
+};
+
+#endif // IOSCHEDULER_H
@@ -0,0 +1,69 @@
+
+#include "MonotonicArena.h"
+
+#include <new>
+
+MonotonicArena::MonotonicArena(std::size_t initialSize) : nextSize_(initialSize ? initialSize : 1),
+    last_(NULL), current_(NULL), left_(0), counters_()
+{
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    release();
+}
+
+void* MonotonicArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    ++counters_.requests;
+    counters_.bytes += bytes;
+
+    std::size_t skip = (alignment - reinterpret_cast<std::uintptr_t>(current_) % alignment) % alignment;
+    if (!current_ || skip + bytes > left_)
+    {
+        // The chunks are linked through their first bytes, so the list of
+        // them costs no allocation of its own
+        std::size_t size = nextSize_;
+        if (size < sizeof(Chunk) + bytes + alignment)
+            size = sizeof(Chunk) + bytes + alignment;
+        Chunk* chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->previous = last_;
+        last_ = chunk;
+        current_ = reinterpret_cast<char*>(chunk + 1);
+        left_ = size - sizeof(Chunk);
+        nextSize_ = size * 2;
+        ++counters_.chunks;
+        counters_.chunkBytes += size;
+        skip = (alignment - reinterpret_cast<std::uintptr_t>(current_) % alignment) % alignment;
+    }
+
+    char* p = current_ + skip;
+    current_ = p + bytes;
+    left_ -= skip + bytes;
+    return p;
+}
+
+void MonotonicArena::deallocate(void* p, std::size_t bytes, std::size_t alignment)
+{
+    (void)p;
+    (void)bytes;
+    (void)alignment;
+}
+
+void MonotonicArena::release()
+{
+    while (last_)
+    {
+        Chunk* previous = last_->previous;
+        ::operator delete(last_);
+        last_ = previous;
+    }
+    current_ = NULL;
+    left_ = 0;
+    counters_ = ArenaCounters();
+}
+
+ArenaCounters MonotonicArena::counters() const
+{
+    return counters_;
+}
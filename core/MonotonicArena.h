@@ -0,0 +1,120 @@
+/****************************** Module Header ******************************\
+Module Name:  MonotonicArena.h
+Project:      CppShellExtContextMenuHandler
+
+Memory of one context menu invocation: the selected paths, their records
+and the order of the report are carved out of a few large chunks, nothing
+is freed on its own, and everything goes back to the heap at once when the
+invocation ends.
+
+The interface follows std::pmr::monotonic_buffer_resource (allocate,
+deallocate that does nothing, release), and ArenaAllocator stands in for
+std::pmr::polymorphic_allocator - the v140 toolset the DLL is built with
+has no <memory_resource>. Allocation counters tell how many requests the
+arena served and how many of them reached the heap.
+
+Not thread safe: the arena is filled by the thread that sets up the
+invocation, the pool threads only read what is in it.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef MONOTONICARENA_H
+#define MONOTONICARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+//! Haponov - what an arena has done since it was created or released
+struct ArenaCounters
+{
+    //! allocate calls and the bytes they asked for
+    std::uint64_t requests;
+    std::uint64_t bytes;
+    //! chunks taken from the heap - the only heap allocations
+    std::uint64_t chunks;
+    std::uint64_t chunkBytes;
+};
+
+class MonotonicArena
+{
+public:
+    //! Haponov - the first chunk is initialSize bytes, every next one is
+    //            twice the previous, or as large as one request needs
+    explicit MonotonicArena(std::size_t initialSize = 4096);
+    ~MonotonicArena();
+
+    //! Haponov - bytes aligned to alignment (a power of two), valid until
+    //            release; throws std::bad_alloc like operator new
+    void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+    //! Haponov - nothing, the memory goes back with release
+    void deallocate(void* p, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+    //! Haponov - give every chunk back to the heap at once
+    void release();
+
+    ArenaCounters counters() const;
+
+private:
+    MonotonicArena(const MonotonicArena&);
+    MonotonicArena& operator=(const MonotonicArena&);
+
+    //! a chunk from the heap, linked to the one taken before it
+    struct Chunk
+    {
+        Chunk* previous;
+    };
+
+    std::size_t nextSize_;
+    Chunk* last_;
+    char* current_;
+    std::size_t left_;
+    ArenaCounters counters_;
+};
+
+//! Haponov - STL allocator that takes its memory from a MonotonicArena
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(MonotonicArena& arena) : arena_(&arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        arena_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    MonotonicArena* arena() const
+    {
+        return arena_;
+    }
+
+private:
+    MonotonicArena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.arena() != b.arena();
+}
+
+#endif // MONOTONICARENA_H
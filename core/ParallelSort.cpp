@@ -0,0 +1,67 @@
+
+#include "ParallelSort.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+const std::size_t ParallelSort::threshold;
+
+namespace
+{
+    // Steps of one forEach, claimed one at a time by whoever is free
+    struct Steps
+    {
+        std::size_t count;
+        std::function <void(std::size_t)> step;
+
+        std::atomic <std::size_t> next;
+
+        std::mutex lock;
+        std::condition_variable condVar;
+        std::size_t left;
+
+        // Run steps until none is left to claim
+        void run()
+        {
+            std::size_t index;
+            while ((index = next++) < count)
+            {
+                step(index);
+
+                std::unique_lock <std::mutex> l(lock);
+                if (!--left)
+                    condVar.notify_all();
+            }
+        }
+    };
+}
+
+void ParallelSort::forEach(ThreadPool& pool, std::size_t count,
+                           const std::function <void(std::size_t)>& step)
+{
+    if (!count)
+        return;
+
+    // The state is shared with pool jobs that may start only after every
+    // step is done - they find none left and just drop it
+    std::shared_ptr<Steps> state = std::make_shared<Steps>();
+    state->count = count;
+    state->step = step;
+    state->next = 0;
+    state->left = count;
+
+    unsigned helpers = std::thread::hardware_concurrency();
+    if (static_cast<std::size_t>(helpers) >= count)
+        helpers = static_cast<unsigned>(count) - 1;
+    for (unsigned i = 0; i < helpers; ++i)
+        pool.doJob([state]() { state->run(); });
+
+    state->run();
+
+    std::unique_lock <std::mutex> l(state->lock);
+    while (state->left)
+        state->condVar.wait(l);
+}
@@ -0,0 +1,89 @@
+/****************************** Module Header ******************************\
+Module Name:  ParallelSort.h
+Project:      CppShellExtContextMenuHandler
+
+Sorts a random access range with the threads of a ThreadPool: the range is
+cut into one run per thread, the runs are sorted independently, then merged
+pairwise in rounds until one run is left.
+
+Runs and merges are claimed one at a time by whoever is free - pool threads
+and the calling thread - the same way CheckSum::parallel claims ranges, so
+a busy pool (or a caller that is a pool thread itself) only makes the sort
+slower, it never waits for a thread that will not come. Small ranges are
+left to std::sort.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef PARALLELSORT_H
+#define PARALLELSORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+class ParallelSort
+{
+public:
+    //! Haponov - ranges shorter than this are sorted by the calling thread
+    static const std::size_t threshold = 16 << 10;
+
+    //! Haponov - sort [first, last) by less, like std::sort (not stable)
+    template <class Iterator, class Less>
+    static void sort(Iterator first, Iterator last, Less less, ThreadPool& pool);
+
+    //! Haponov - call step(0) .. step(count - 1), each once, on the pool
+    //            threads and the calling thread; returns when all are done
+    static void forEach(ThreadPool& pool, std::size_t count,
+                        const std::function <void(std::size_t)>& step);
+};
+
+template <class Iterator, class Less>
+void ParallelSort::sort(Iterator first, Iterator last, Less less, ThreadPool& pool)
+{
+    std::size_t length = static_cast<std::size_t>(last - first);
+    std::size_t runs = std::thread::hardware_concurrency();
+    if (runs > length / (threshold / 2))
+        runs = length / (threshold / 2);
+    if (length < threshold || runs < 2)
+    {
+        std::sort(first, last, less);
+        return;
+    }
+
+    // bounds[i] .. bounds[i + 1] is run i
+    std::vector<std::size_t> bounds(runs + 1);
+    for (std::size_t i = 0; i <= runs; ++i)
+        bounds[i] = length * i / runs;
+
+    forEach(pool, runs, [&](std::size_t run)
+    {
+        std::sort(first + bounds[run], first + bounds[run + 1], less);
+    });
+
+    // Every round merges run 2i with run 2i + 1, an odd last run waits
+    // for the next round as it is
+    while (bounds.size() > 2)
+    {
+        std::size_t pairs = (bounds.size() - 1) / 2;
+        forEach(pool, pairs, [&](std::size_t pair)
+        {
+            std::inplace_merge(first + bounds[2 * pair], first + bounds[2 * pair + 1],
+                               first + bounds[2 * pair + 2], less);
+        });
+
+        std::vector<std::size_t> merged;
+        for (std::size_t i = 0; i < bounds.size(); i += 2)
+            merged.push_back(bounds[i]);
+        if (merged.back() != length)
+            merged.push_back(length);
+        bounds.swap(merged);
+    }
+}
+
+#endif // PARALLELSORT_H
@@ -0,0 +1,624 @@
+
+#include "ReadAhead.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <utility>
+
+#if !defined(_WIN32) && defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define READAHEAD_URING
+#endif
+#endif
+
+#ifdef READAHEAD_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+    // Buffers start on a page boundary and are a whole number of pages
+    const std::size_t pageSize = 4096;
+
+    // Whether the native backend could be set up: 0 not tried yet,
+    // 1 yes, -1 no - then it is not tried again
+    std::atomic <int> nativeState(0);
+}
+
+#ifdef READAHEAD_URING
+
+namespace
+{
+    int uringSetup(unsigned entries, io_uring_params* params)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                                        flags, NULL, 0));
+    }
+}
+
+// The submission and completion rings shared with the kernel
+struct ReadAhead::Ring
+{
+    int fd;
+    unsigned entries;
+    void* sqMap;
+    std::size_t sqMapSize;
+    void* cqMap;
+    std::size_t cqMapSize;
+    io_uring_sqe* sqes;
+    std::size_t sqesSize;
+
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    io_uring_cqe* cqes;
+
+    //! queued entries the kernel has not been told about yet
+    unsigned toSubmit;
+    std::vector<iovec> iovecs;
+
+    static Ring* setUp(unsigned entries);
+    static void tearDown(Ring* ring);
+};
+
+namespace
+{
+    // Rings are set up for at least this many reads, so that a thread's
+    // ring fits the next ReadAhead too
+    const unsigned ringEntries = 16;
+
+    // user_data of the cancel requests, whose completions are not reads
+    const std::uint64_t cancelTag = ~std::uint64_t(0);
+}
+
+ReadAhead::Ring* ReadAhead::Ring::setUp(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    File::countReads(1);
+    int fd = uringSetup(entries, &params);
+    if (fd < 0)
+    {
+        if (errno == ENOSYS || errno == EPERM)
+            nativeState = -1;
+        return NULL;
+    }
+
+    Ring* ring = new Ring();
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->toSubmit = 0;
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+    // Newer kernels put both rings in one mapping
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        ring->sqMapSize = ring->cqMapSize = (std::max)(ring->sqMapSize, ring->cqMapSize);
+
+    File::countReads(single ? 2 : 3);
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cqMap = single ? ring->sqMap :
+                  mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+    if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        tearDown(ring);
+        return NULL;
+    }
+
+    char* sq = static_cast<char*>(ring->sqMap);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(ring->cqMap);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return ring;
+}
+
+void ReadAhead::Ring::tearDown(Ring* ring)
+{
+    if (!ring)
+        return;
+
+    File::countReads(1);
+    if (ring->sqes != MAP_FAILED)
+    {
+        File::countReads(1);
+        munmap(ring->sqes, ring->sqesSize);
+    }
+    if (ring->cqMap != MAP_FAILED && ring->cqMap != ring->sqMap)
+    {
+        File::countReads(1);
+        munmap(ring->cqMap, ring->cqMapSize);
+    }
+    if (ring->sqMap != MAP_FAILED)
+    {
+        File::countReads(1);
+        munmap(ring->sqMap, ring->sqMapSize);
+    }
+    close(ring->fd);
+    delete ring;
+}
+
+ReadAhead::Ring*& ReadAhead::idleRing()
+{
+    // Torn down when the thread ends
+    struct Holder
+    {
+        Ring* ring;
+        Holder() : ring(NULL) {}
+        ~Holder() { Ring::tearDown(ring); }
+    };
+    static thread_local Holder holder;
+    return holder.ring;
+}
+
+bool ReadAhead::startNative()
+{
+    // The ring of this thread when it is large enough, else a new one
+    Ring*& idle = idleRing();
+    Ring* ring = NULL;
+    if (idle && idle->entries >= depth_)
+    {
+        ring = idle;
+        idle = NULL;
+    }
+    else
+        ring = Ring::setUp((std::max)(depth_, ringEntries));
+    if (!ring)
+        return false;
+
+    ring->iovecs.resize(depth_);
+    ring_ = ring;
+    nativeState = 1;
+    return true;
+}
+
+bool ReadAhead::cancelPending()
+{
+    Ring& ring = *ring_;
+    for (unsigned i = 0; i < slots_.size(); ++i)
+    {
+        if (!slots_[i].pending)
+            continue;
+        unsigned tail = *ring.sqTail;
+        if (tail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) >= ring.entries)
+            return false;
+        unsigned index = tail & *ring.sqMask;
+        io_uring_sqe& sqe = ring.sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = -1;
+        sqe.addr = i;
+        sqe.user_data = cancelTag;
+        ring.sqArray[index] = index;
+        __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+        ++ring.toSubmit;
+    }
+
+    File::countReads(1);
+    int submitted = uringEnter(ring.fd, ring.toSubmit, 0, 0);
+    if (submitted < 0)
+        return false;
+    ring.toSubmit -= static_cast<unsigned>(submitted);
+    return true;
+}
+
+void ReadAhead::stopNative()
+{
+    Ring* ring = ring_;
+    if (!ring)
+        return;
+
+    // The kernel may still write into the buffers until the reads
+    // complete: they are waited for, cancelled and waited for again if the
+    // wait fails, and left to the kernel with their buffers if that fails
+    // too
+    bool cancelled = false;
+    bool drained = true;
+    for (unsigned i = 0; drained && i < slots_.size(); ++i)
+        drained = !slots_[i].pending || complete(i);
+    if (!drained)
+    {
+        cancelled = true;
+        drained = cancelPending();
+        for (unsigned i = 0; drained && i < slots_.size(); ++i)
+            drained = !slots_[i].pending || complete(i);
+    }
+    ring_ = NULL;
+    if (!drained)
+    {
+        new std::vector<char>(std::move(storage_));
+        buffers_ = NULL;
+        return;
+    }
+
+    // A ring with nothing left in it serves the next ReadAhead of this
+    // thread; completions of cancel requests may still be on their way
+    Ring*& idle = idleRing();
+    if (!idle && !cancelled && !ring->toSubmit)
+        idle = ring;
+    else
+        Ring::tearDown(ring);
+}
+
+bool ReadAhead::submit(unsigned slot, std::uint64_t block)
+{
+    Ring& ring = *ring_;
+    std::uint64_t offset = block * blockSize_;
+    iovec& iov = ring.iovecs[slot];
+    iov.iov_base = buffer(slot);
+    iov.iov_len = static_cast<std::size_t>((std::min)(length_ - offset,
+                                           static_cast<std::uint64_t>(blockSize_)));
+
+    // Only this object adds entries, the kernel only moves the head
+    unsigned tail = *ring.sqTail;
+    unsigned index = tail & *ring.sqMask;
+    io_uring_sqe& sqe = ring.sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = file_.fd_;
+    sqe.addr = reinterpret_cast<std::uint64_t>(&iov);
+    sqe.len = 1;
+    sqe.off = offset_ + offset;
+    sqe.user_data = slot;
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ++ring.toSubmit;
+
+    Slot& s = slots_[slot];
+    s.block = block;
+    s.length = 0;
+    s.pending = true;
+    return true;
+}
+
+bool ReadAhead::complete(unsigned slot)
+{
+    Ring& ring = *ring_;
+    for (;;)
+    {
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+            if (cqe.user_data >= slots_.size())
+                continue;
+            Slot& s = slots_[static_cast<std::size_t>(cqe.user_data)];
+            // A failed read is done again with readAt
+            s.length = cqe.res > 0 ? static_cast<std::size_t>(cqe.res) : 0;
+            s.pending = false;
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+        // Reads queued meanwhile go to the kernel with the wait, if any
+        bool wait = slots_[slot].pending;
+        if (!wait && !ring.toSubmit)
+            return true;
+
+        File::countReads(1);
+        int submitted = uringEnter(ring.fd, ring.toSubmit, wait ? 1 : 0,
+                                   wait ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            return false;
+        }
+        ring.toSubmit -= static_cast<unsigned>(submitted);
+        if (!wait)
+            return true;
+    }
+}
+
+#elif defined(_WIN32)
+
+bool ReadAhead::startNative()
+{
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+    {
+        File::countReads(1);
+        slots_[i].overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (!slots_[i].overlapped.hEvent)
+        {
+            stopNative();
+            return false;
+        }
+    }
+    nativeState = 1;
+    return true;
+}
+
+void ReadAhead::stopNative()
+{
+    for (std::size_t i = 0; i < slots_.size(); ++i)
+    {
+        Slot& s = slots_[i];
+        if (s.pending)
+        {
+            // The buffer must not go away while the read may still fill it
+            DWORD read = 0;
+            File::countReads(2);
+            CancelIoEx(file_.handle_, &s.overlapped);
+            GetOverlappedResult(file_.handle_, &s.overlapped, &read, TRUE);
+            s.pending = false;
+        }
+        if (s.overlapped.hEvent)
+        {
+            File::countReads(1);
+            CloseHandle(s.overlapped.hEvent);
+            s.overlapped.hEvent = NULL;
+        }
+    }
+}
+
+bool ReadAhead::submit(unsigned slot, std::uint64_t block)
+{
+    Slot& s = slots_[slot];
+    std::uint64_t offset = offset_ + block * blockSize_;
+    DWORD toRead = static_cast<DWORD>((std::min)(length_ - block * blockSize_,
+                                      static_cast<std::uint64_t>(blockSize_)));
+
+    HANDLE hEvent = s.overlapped.hEvent;
+    std::memset(&s.overlapped, 0, sizeof(s.overlapped));
+    s.overlapped.Offset = static_cast<DWORD>(offset);
+    s.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    s.overlapped.hEvent = hEvent;
+    s.block = block;
+    s.length = 0;
+
+    File::countReads(1);
+    if (ReadFile(file_.handle_, buffer(slot), toRead, NULL, &s.overlapped) ||
+        GetLastError() == ERROR_IO_PENDING)
+    {
+        s.pending = true;
+        return true;
+    }
+
+    // Past the end of file or failed: done again with readAt
+    s.pending = false;
+    return true;
+}
+
+bool ReadAhead::complete(unsigned slot)
+{
+    Slot& s = slots_[slot];
+    if (!s.pending)
+        return true;
+
+    DWORD read = 0;
+    File::countReads(1);
+    if (!GetOverlappedResult(file_.handle_, &s.overlapped, &read, TRUE))
+        read = 0;
+    s.length = read;
+    s.pending = false;
+    return true;
+}
+
+#else
+
+bool ReadAhead::startNative()
+{
+    nativeState = -1;
+    return false;
+}
+
+void ReadAhead::stopNative()
+{
+}
+
+bool ReadAhead::submit(unsigned, std::uint64_t)
+{
+    return false;
+}
+
+bool ReadAhead::complete(unsigned)
+{
+    return false;
+}
+
+#endif
+
+ReadAhead::ReadAhead(const File& file, std::uint64_t offset, std::uint64_t length,
+                     std::size_t blockSize, unsigned depth, Backend backend) :
+    file_(file), offset_(offset), length_(length),
+    blockSize_(blockSize ? (blockSize + pageSize - 1) / pageSize * pageSize : pageSize),
+    depth_(depth ? depth : 1), backend_(backend),
+    blocks_((length + blockSize_ - 1) / blockSize_), nextBlock_(0), nextSubmit_(0),
+    failed_(false), ended_(false), buffers_(NULL)
+#ifndef _WIN32
+    , ring_(NULL)
+#endif
+{
+    if (!blocks_)
+        return;
+
+    if (backend_ == Automatic)
+        backend_ = nativeAvailable() ? Native : Blocking;
+    // One block needs no overlap, Blocking reuses one buffer
+    if (blocks_ == 1 || backend_ == Blocking)
+    {
+        backend_ = Blocking;
+        depth_ = 1;
+    }
+    if (static_cast<std::uint64_t>(depth_) > blocks_)
+        depth_ = static_cast<unsigned>(blocks_);
+
+    // A single block needs a buffer only as large as the part
+    std::size_t bufferSize = blocks_ == 1 ?
+        static_cast<std::size_t>(length_ + pageSize - 1) / pageSize * pageSize : blockSize_;
+    storage_.resize(depth_ * bufferSize + pageSize);
+    buffers_ = storage_.data() + (pageSize -
+        reinterpret_cast<std::uintptr_t>(storage_.data()) % pageSize) % pageSize;
+
+    Slot empty;
+    std::memset(&empty, 0, sizeof(empty));
+    slots_.assign(depth_, empty);
+
+    if (backend_ == Native && !startNative())
+    {
+        backend_ = Blocking;
+        depth_ = 1;
+        slots_.resize(1);
+    }
+
+    if (backend_ == Native)
+    {
+        while (nextSubmit_ < static_cast<std::uint64_t>(depth_))
+        {
+            submit(static_cast<unsigned>(nextSubmit_), nextSubmit_);
+            ++nextSubmit_;
+        }
+#ifdef READAHEAD_URING
+        // Start the reads now, not at the first wait
+        File::countReads(1);
+        int submitted = uringEnter(ring_->fd, ring_->toSubmit, 0, 0);
+        if (submitted > 0)
+            ring_->toSubmit -= static_cast<unsigned>(submitted);
+#endif
+    }
+}
+
+ReadAhead::~ReadAhead()
+{
+    if (backend_ == Native)
+        stopNative();
+}
+
+char* ReadAhead::buffer(unsigned slot)
+{
+    return buffers_ + static_cast<std::size_t>(slot) * blockSize_;
+}
+
+bool ReadAhead::next(const char*& data, std::size_t& length)
+{
+    if (failed_ || ended_ || nextBlock_ >= blocks_)
+        return false;
+
+    std::uint64_t block = nextBlock_;
+    std::uint64_t offset = block * blockSize_;
+    std::size_t want = static_cast<std::size_t>((std::min)(length_ - offset,
+                                                static_cast<std::uint64_t>(blockSize_)));
+    unsigned slot = static_cast<unsigned>(block % depth_);
+    std::size_t got = 0;
+
+    if (backend_ == Native)
+    {
+        // The block handed out last time is done with - its buffer takes
+        // the next block to read
+        if (block && nextSubmit_ < blocks_)
+        {
+            submit(static_cast<unsigned>((block - 1) % depth_), nextSubmit_);
+            ++nextSubmit_;
+        }
+        if (!complete(slot))
+        {
+            failed_ = true;
+            return false;
+        }
+        got = slots_[slot].length;
+    }
+
+    // Blocking reads, and the rest of a native read that came back short
+    if (got < want)
+    {
+        std::int64_t read = file_.readAt(offset_ + offset + got, buffer(slot) + got, want - got);
+        if (read < 0)
+        {
+            failed_ = true;
+            return false;
+        }
+        got += static_cast<std::size_t>(read);
+    }
+
+    // Short only at the end of file
+    if (got < want)
+        ended_ = true;
+    if (!got)
+        return false;
+
+    ++nextBlock_;
+    data = buffer(slot);
+    length = got;
+    return true;
+}
+
+bool ReadAhead::failed() const
+{
+    return failed_;
+}
+
+ReadAhead::Backend ReadAhead::backend() const
+{
+    return backend_;
+}
+
+bool ReadAhead::nativeAvailable()
+{
+#ifdef _WIN32
+    return true;
+#elif defined(READAHEAD_URING)
+    int state = nativeState;
+    if (state)
+        return state > 0;
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    File::countReads(2);
+    int fd = uringSetup(1, &params);
+    if (fd < 0)
+    {
+        nativeState = -1;
+        return false;
+    }
+    close(fd);
+    nativeState = 1;
+    return true;
+#else
+    return nativeState > 0;
+#endif
+}
+
+const char* ReadAhead::name(Backend backend)
+{
+    switch (backend)
+    {
+    case Blocking:
+        return "blocking";
+#ifdef _WIN32
+    case Native:
+        return "overlapped";
+#else
+    case Native:
+        return "io_uring";
+#endif
+    default:
+        return "automatic";
+    }
+}
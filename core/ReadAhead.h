@@ -0,0 +1,121 @@
+/****************************** Module Header ******************************\
+Module Name:  ReadAhead.h
+Project:      CppShellExtContextMenuHandler
+
+Reads a part of a file block by block in file order while keeping several
+blocks in flight, so the device fills the next buffers while the caller is
+still working on the current one.
+
+Backends:
+  - Windows: overlapped ReadFile, one OVERLAPPED and event per buffer,
+  - Linux: io_uring, set up with the raw system calls; a thread keeps the
+    ring of its last finished ReadAhead for the next one it starts,
+  - elsewhere, or where io_uring is not available: one positioned read
+    per block when the caller asks for it (no overlap).
+
+A block is handed out when it is complete, the buffer it is in goes back
+to the device as soon as the caller asks for the next one.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "File.h"
+
+class ReadAhead
+{
+public:
+    //! Haponov - how the blocks are read
+    enum Backend
+    {
+        //! the native asynchronous reads when there are, else Blocking
+        Automatic,
+        //! one File::readAt per block, when the block is asked for
+        Blocking,
+        //! overlapped ReadFile on Windows, io_uring on Linux
+        Native
+    };
+
+    //! Haponov - read [offset, offset + length) of file in blocks of
+    //            blockSize rounded up to whole pages, up to depth of them
+    //            in flight; a Native backend that cannot be set up
+    //            falls back to Blocking
+    ReadAhead(const File& file, std::uint64_t offset, std::uint64_t length,
+              std::size_t blockSize, unsigned depth, Backend backend = Automatic);
+    //! Haponov - waits for reads still in flight; reads the kernel can
+    //            neither finish nor cancel keep their buffers, which are
+    //            then never freed
+    ~ReadAhead();
+
+    //! Haponov - the next block in file order, valid until the next call;
+    //            false at the end of the part or of the file, and on error
+    bool next(const char*& data, std::size_t& length);
+
+    //! Haponov - a read failed
+    bool failed() const;
+
+    //! Haponov - the backend actually used, never Automatic
+    Backend backend() const;
+
+    //! Haponov - whether Native can be set up in this process
+    static bool nativeAvailable();
+
+    static const char* name(Backend backend);
+
+private:
+    ReadAhead(const ReadAhead&);
+    ReadAhead& operator=(const ReadAhead&);
+
+    //! one buffer and the read of it in flight
+    struct Slot
+    {
+        std::uint64_t block;
+        std::size_t length;
+        bool pending;
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+#endif
+    };
+
+    char* buffer(unsigned slot);
+    bool startNative();
+    void stopNative();
+    bool submit(unsigned slot, std::uint64_t block);
+    bool complete(unsigned slot);
+
+    const File& file_;
+    std::uint64_t offset_;
+    std::uint64_t length_;
+    std::size_t blockSize_;
+    unsigned depth_;
+    Backend backend_;
+
+    std::uint64_t blocks_;
+    //! first block not handed out yet / first block not submitted yet
+    std::uint64_t nextBlock_;
+    std::uint64_t nextSubmit_;
+    bool failed_;
+    bool ended_;
+
+    std::vector<char> storage_;
+    char* buffers_;
+    std::vector<Slot> slots_;
+
+#ifndef _WIN32
+    struct Ring;
+    Ring* ring_;
+
+    //! the ring left idle on this thread, NULL if none
+    static Ring*& idleRing();
+    bool cancelPending();
+#endif
+};
+
+#endif // READAHEAD_H
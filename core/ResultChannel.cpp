@@ -0,0 +1,196 @@
+
+#include "ResultChannel.h"
+
+#include <new>
+
+const std::size_t ResultChannel::cacheLine;
+
+bool ResultProgress::complete() const
+{
+    return finished == files;
+}
+
+ResultChannel::ResultChannel() : files_(0),
+    slotSize_((sizeof(Slot) + cacheLine - 1) / cacheLine * cacheLine), slots_(NULL)
+{
+    described_.value = 0;
+    finished_.value = 0;
+    version_.value = 0;
+    waiters_.value = 0;
+}
+
+void ResultChannel::reset(const FileRecord* files, std::size_t count)
+{
+    // No worker writes while the batch is set up; every slot starts on a
+    // cache line and fills whole lines
+    storage_.assign(count * slotSize_ + cacheLine, 0);
+    slots_ = storage_.data() + (cacheLine -
+        reinterpret_cast<std::uintptr_t>(storage_.data()) % cacheLine) % cacheLine;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Slot* created = new (slots_ + i * slotSize_) Slot();
+        created->record = files[i];
+        created->record.stage = FileRecord::Waiting;
+        created->record.haveChecksum = false;
+        created->stage = FileRecord::Waiting;
+    }
+    order_.reset(new std::atomic <std::size_t>[count]);
+    for (std::size_t i = 0; i < count; ++i)
+        order_[i].store(0, std::memory_order_relaxed);
+    files_ = count;
+    described_.value = 0;
+    finished_.value = 0;
+
+    publish(NULL, FileRecord::Waiting);
+}
+
+ResultChannel::Slot& ResultChannel::slot(std::size_t index)
+{
+    return *reinterpret_cast<Slot*>(slots_ + index * slotSize_);
+}
+
+void ResultChannel::describe(std::size_t index, const FileInfo& info)
+{
+    Slot& s = slot(index);
+    s.record.describe(info);
+    described_.value.fetch_add(1);
+    publish(&s, FileRecord::Described);
+}
+
+void ResultChannel::check(std::size_t index, bool haveChecksum, const Digest& digest)
+{
+    Slot& s = slot(index);
+    if (haveChecksum)
+        s.record.setChecksum(digest);
+    finish(index, FileRecord::Checked);
+}
+
+void ResultChannel::describeDirectory(std::size_t index)
+{
+    Slot& s = slot(index);
+    s.record.directory = true;
+    described_.value.fetch_add(1);
+    publish(&s, FileRecord::Described);
+}
+
+void ResultChannel::checkDirectory(std::size_t index, const TreeTotals& totals)
+{
+    Slot& s = slot(index);
+    s.record.setTotals(totals);
+    finish(index, FileRecord::Checked);
+}
+
+void ResultChannel::fail(std::size_t index)
+{
+    finish(index, FileRecord::Failed);
+}
+
+void ResultChannel::finish(std::size_t index, FileRecord::Stage stage)
+{
+    // The stage is stored before the file takes its place, so a consumer
+    // that finds the index there finds the record finished; both come
+    // before the version is raised
+    slot(index).stage.store(stage, std::memory_order_release);
+    std::size_t position = static_cast<std::size_t>(finished_.value.fetch_add(1));
+    order_[position].store(index + 1, std::memory_order_release);
+    publish(NULL, stage);
+}
+
+void ResultChannel::publish(Slot* slot, FileRecord::Stage stage)
+{
+    if (slot)
+        slot->stage.store(stage, std::memory_order_release);
+
+    // The version is raised before waiters_ is read, and a waiter counts
+    // itself before it reads the version (both sequentially consistent),
+    // so a waiter either sees the new version or is seen here
+    version_.value.fetch_add(1);
+    if (waiters_.value.load())
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        condVar_.notify_all();
+    }
+}
+
+ResultProgress ResultChannel::progress()
+{
+    ResultProgress progress;
+    progress.files = files_;
+    progress.described = static_cast<std::size_t>(described_.value.load());
+    progress.finished = static_cast<std::size_t>(finished_.value.load());
+    return progress;
+}
+
+std::uint64_t ResultChannel::version()
+{
+    return version_.value.load();
+}
+
+std::uint64_t ResultChannel::snapshot(std::vector<FileRecord>& records)
+{
+    // Taken before the slots, so a change made while they are copied
+    // shows up as a newer version
+    std::uint64_t version = version_.value.load();
+
+    records.resize(files_);
+    for (std::size_t i = 0; i < files_; ++i)
+        record(i, records[i]);
+    return version;
+}
+
+FileRecord::Stage ResultChannel::record(std::size_t index, FileRecord& copy)
+{
+    // The path is written before the batch starts, the rest only by the
+    // stage that publishes it
+    const FileRecord& source = slot(index).record;
+    int stage = slot(index).stage.load(std::memory_order_acquire);
+    copy = FileRecord();
+    copy.path = source.path;
+    copy.nameStart = source.nameStart;
+    copy.stage = static_cast<std::uint8_t>(stage);
+    if (stage == FileRecord::Described || stage == FileRecord::Checked)
+    {
+        copy.directory = source.directory;
+        copy.size = source.size;
+        copy.creationTime = source.creationTime;
+    }
+    if (stage == FileRecord::Checked && source.directory)
+        copy.tree = source.tree;
+    else if (stage == FileRecord::Checked && source.haveChecksum)
+        copy.setChecksum(source.checksum());
+    return static_cast<FileRecord::Stage>(stage);
+}
+
+bool ResultChannel::finishedAt(std::size_t position, std::size_t& index)
+{
+    if (position >= files_)
+        return false;
+    std::size_t entry = order_[position].load(std::memory_order_acquire);
+    if (!entry)
+        return false;
+    index = entry - 1;
+    return true;
+}
+
+std::uint64_t ResultChannel::waitForChange(std::uint64_t seen, std::chrono::milliseconds timeout)
+{
+    waiters_.value.fetch_add(1);
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        condVar_.wait_for(l, timeout, [this, seen]() { return version_.value.load() != seen; });
+    }
+    waiters_.value.fetch_sub(1);
+    return version_.value.load();
+}
+
+bool ResultChannel::waitForAll(std::chrono::milliseconds timeout)
+{
+    waiters_.value.fetch_add(1);
+    bool complete;
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        complete = condVar_.wait_for(l, timeout, [this]() { return progress().complete(); });
+    }
+    waiters_.value.fetch_sub(1);
+    return complete;
+}
@@ -0,0 +1,145 @@
+/****************************** Module Header ******************************\
+Module Name:  ResultChannel.h
+Project:      CppShellExtContextMenuHandler
+
+Results of a batch of files, published by the workers piece by piece as
+they become known: first the metadata of a file (size, times), later its
+checksum. The consumer does not have to wait for the whole batch - it
+takes progress counts and snapshots of whatever is there, and can wait
+for the next change.
+
+Every change bumps a version number, so a consumer that renders
+snapshots can tell whether anything is new since the last one.
+
+Publishing takes no lock. Every file has a slot of its own, written by
+the one worker that handles the file and kept on cache lines of its own,
+so workers do not contend or share lines. The stage of a slot is stored
+last with release order, a reader takes it with acquire order and copies
+only the fields that stage has filled in, which are not written again.
+Consumers that wait are woken through a mutex and condition variable,
+which a worker touches only when someone is waiting.
+
+A file that finishes also takes the next place in the order of finishing,
+an array as long as the batch that the workers fill in by an atomic
+count; a consumer that takes the files as they finish reads it from
+where it stopped, without looking at the files still pending.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef RESULTCHANNEL_H
+#define RESULTCHANNEL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "FileRecord.h"
+
+//! Haponov - counts of the files that have reached a stage
+struct ResultProgress
+{
+    std::size_t files;
+    //! metadata known, including the checked ones
+    std::size_t described;
+    //! checked or failed - nothing more will come for them
+    std::size_t finished;
+
+    bool complete() const;
+};
+
+class ResultChannel
+{
+public:
+    ResultChannel();
+
+    //! Haponov - start over with the count Waiting records of a batch
+    void reset(const FileRecord* files, std::size_t count);
+
+    //! Haponov - the workers: file index is opened and described / has
+    //            its checksum (none if haveChecksum is false) / could not
+    //            be opened
+    void describe(std::size_t index, const FileInfo& info);
+    void check(std::size_t index, bool haveChecksum, const Digest& digest);
+    void fail(std::size_t index);
+
+    //! Haponov - the same for a directory: its tree is being walked / has
+    //            been walked
+    void describeDirectory(std::size_t index);
+    void checkDirectory(std::size_t index, const TreeTotals& totals);
+
+    ResultProgress progress();
+
+    //! Haponov - number of changes so far
+    std::uint64_t version();
+
+    //! Haponov - copy of every record in index order, returns the version
+    //            it shows
+    std::uint64_t snapshot(std::vector<FileRecord>& records);
+
+    //! Haponov - copy of the record of file index as it is now, returns
+    //            its stage; for a consumer that takes the files one by one
+    //            as they finish
+    FileRecord::Stage record(std::size_t index, FileRecord& copy);
+
+    //! Haponov - index of the file that was the position-th to finish,
+    //            false if fewer have finished so far
+    bool finishedAt(std::size_t position, std::size_t& index);
+
+    //! Haponov - block until the version differs from seen or timeout
+    //            passes, returns the version then
+    std::uint64_t waitForChange(std::uint64_t seen, std::chrono::milliseconds timeout);
+
+    //! Haponov - block until every file is finished or timeout passes,
+    //            true if they are
+    bool waitForAll(std::chrono::milliseconds timeout);
+
+private:
+    ResultChannel(const ResultChannel&);
+    ResultChannel& operator=(const ResultChannel&);
+
+    static const std::size_t cacheLine = 64;
+
+    //! the record of one file, its stage published last
+    struct Slot
+    {
+        std::atomic <int> stage;
+        FileRecord record;
+    };
+
+    //! a counter alone on its cache line
+    struct Counter
+    {
+        std::atomic <std::uint64_t> value;
+        char padding[cacheLine - sizeof(std::atomic <std::uint64_t>)];
+    };
+
+    Slot& slot(std::size_t index);
+    void publish(Slot* slot, FileRecord::Stage stage);
+    //! a checked or failed file takes its place in order_
+    void finish(std::size_t index, FileRecord::Stage stage);
+
+    std::size_t files_;
+    std::size_t slotSize_;
+    std::vector<char> storage_;
+    char* slots_;
+    //! index + 1 of the files in the order they finish, 0 where the
+    //! worker of the place has not stored it yet
+    std::unique_ptr <std::atomic <std::size_t>[]> order_;
+
+    Counter described_;
+    Counter finished_;
+    Counter version_;
+    Counter waiters_;
+
+    std::mutex lock_;
+    std::condition_variable condVar_;
+};
+
+#endif // RESULTCHANNEL_H
@@ -0,0 +1,327 @@
+
+#include "ResultExport.h"
+#include "TextFormat.h"
+
+#include <string>
+#include <type_traits>
+
+const std::size_t ResultExport::bufferSize;
+
+namespace
+{
+    const char* const csvHeader =
+        "path,name,type,status,size,created,algorithm,checksum,files,folders,unreadable\r\n";
+
+    // What became of a record, in words a script can match
+    const char* statusOf(const FileRecord& record)
+    {
+        switch (record.stage)
+        {
+        case FileRecord::Waiting:
+            return "skipped";
+        case FileRecord::Described:
+            return "stopped";
+        case FileRecord::Failed:
+            return "error";
+        default:
+            return record.directory || record.haveChecksum ? "ok" : "unreadable";
+        }
+    }
+
+    bool sameAscii(const PathChar* text, const char* lower)
+    {
+        for (; *text && *lower; ++text, ++lower)
+        {
+            PathChar c = *text;
+            if (c >= 'A' && c <= 'Z')
+                c = static_cast<PathChar>(c - 'A' + 'a');
+            if (c != static_cast<PathChar>(*lower))
+                return false;
+        }
+        return !*text && !*lower;
+    }
+}
+
+ResultExport::ResultExport(File& file, ExportFormat format, HashAlgorithm algorithm) :
+    file_(&file), stream_(NULL), format_(format), algorithm_(algorithm),
+    buffer_(new char[bufferSize]), used_(0), records_(0), failed_(false)
+{
+}
+
+ResultExport::ResultExport(std::FILE* stream, ExportFormat format, HashAlgorithm algorithm) :
+    file_(NULL), stream_(stream), format_(format), algorithm_(algorithm),
+    buffer_(new char[bufferSize]), used_(0), records_(0), failed_(false)
+{
+}
+
+bool ResultExport::begin()
+{
+    if (format_ == ExportCsv)
+        put(csvHeader);
+    else if (format_ == ExportJson)
+        put("[\n");
+    return !failed_;
+}
+
+bool ResultExport::write(const FileRecord& record)
+{
+    bool json = format_ != ExportCsv;
+    bool described = record.stage == FileRecord::Described || record.stage == FileRecord::Checked;
+    bool checked = record.stage == FileRecord::Checked && (record.directory || record.haveChecksum);
+
+    // A field that has no value is an empty column in CSV and is left
+    // out in JSON
+    bool first = true;
+    auto field = [&](const char* name)
+    {
+        if (!first)
+            put(',');
+        first = false;
+        if (json)
+        {
+            put('"');
+            put(name);
+            put("\":");
+        }
+    };
+    auto none = [&]()
+    {
+        if (json)
+            return;
+        if (!first)
+            put(',');
+        first = false;
+    };
+
+    if (format_ == ExportJson && records_)
+        put(",\n");
+    if (json)
+        put('{');
+
+    field("path");
+    putPath(record.path);
+    field("name");
+    putPath(record.name());
+    field("type");
+    putQuoted(record.directory ? "folder" : "file");
+    field("status");
+    putQuoted(statusOf(record));
+
+    if (described)
+    {
+        field("size");
+        putNumber(record.size);
+    }
+    else
+        none();
+    if (described && record.creationTime)
+    {
+        field("created");
+        putTime(record.creationTime);
+    }
+    else
+        none();
+
+    if (checked)
+    {
+        field("algorithm");
+        putQuoted(Hasher::name(algorithm_));
+        field("checksum");
+        char text[Digest::textSize];
+        if (record.directory)
+        {
+            // The combined checksum of a tree, as the dialog shows it
+            static const char hex[] = "0123456789abcdef";
+            for (int i = 0; i < 16; ++i)
+                text[i] = hex[(record.tree.checksum >> (60 - 4 * i)) & 0xF];
+            text[16] = 0;
+        }
+        else
+            record.checksum().format(text);
+        putQuoted(text);
+    }
+    else
+    {
+        none();
+        none();
+    }
+
+    if (record.directory && checked)
+    {
+        field("files");
+        putNumber(record.tree.files);
+        field("folders");
+        putNumber(record.tree.directories);
+        field("unreadable");
+        putNumber(record.tree.unreadable);
+    }
+    else
+    {
+        none();
+        none();
+        none();
+    }
+
+    if (json)
+        put('}');
+    if (format_ == ExportCsv)
+        put("\r\n");
+    else if (format_ == ExportNdjson)
+        put('\n');
+    ++records_;
+    return !failed_;
+}
+
+bool ResultExport::end()
+{
+    if (format_ == ExportJson)
+        put(records_ ? "\n]\n" : "]\n");
+    flush();
+    if (stream_ && std::fflush(stream_) != 0)
+        failed_ = true;
+    return !failed_;
+}
+
+std::uint64_t ResultExport::records() const
+{
+    return records_;
+}
+
+bool ResultExport::fromExtension(const PathChar* extension, ExportFormat& format)
+{
+    if (sameAscii(extension, "csv"))
+        format = ExportCsv;
+    else if (sameAscii(extension, "ndjson") || sameAscii(extension, "jsonl"))
+        format = ExportNdjson;
+    else if (sameAscii(extension, "json"))
+        format = ExportJson;
+    else
+        return false;
+    return true;
+}
+
+void ResultExport::put(char c)
+{
+    if (used_ == bufferSize)
+        flush();
+    buffer_[used_++] = c;
+}
+
+void ResultExport::put(const char* text)
+{
+    for (; *text; ++text)
+        put(*text);
+}
+
+void ResultExport::putNumber(std::uint64_t value)
+{
+    char digits[20];
+    std::size_t count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count)
+        put(digits[--count]);
+}
+
+void ResultExport::putTime(std::uint64_t nanoseconds)
+{
+    char text[TextFormat::utcTimeSize];
+    TextFormat::utcTime(nanoseconds, text);
+    putQuoted(text);
+}
+
+void ResultExport::putQuoted(const char* ascii)
+{
+    put('"');
+    put(ascii);
+    put('"');
+}
+
+void ResultExport::putPath(const PathChar* path)
+{
+    bool share;
+    const PathChar* rest = File::withoutLongPrefix(path, share);
+    put('"');
+    if (share)
+        put(format_ == ExportCsv ? "\\" : "\\\\");
+    putChars(rest, std::char_traits<PathChar>::length(rest));
+    put('"');
+}
+
+void ResultExport::putChars(const PathChar* text, std::size_t length)
+{
+    typedef std::make_unsigned<PathChar>::type Unit;
+    static const char hex[] = "0123456789abcdef";
+
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        std::uint32_t c = static_cast<Unit>(text[i]);
+
+        // Escapes: "" in CSV; \", \\ and \u00XX for control characters
+        // in JSON
+        if (c == '"')
+        {
+            put(format_ == ExportCsv ? "\"\"" : "\\\"");
+            continue;
+        }
+        if (format_ != ExportCsv && c == '\\')
+        {
+            put("\\\\");
+            continue;
+        }
+        if (format_ != ExportCsv && c < 0x20)
+        {
+            put("\\u00");
+            put(hex[c >> 4]);
+            put(hex[c & 0xF]);
+            continue;
+        }
+
+#ifdef _WIN32
+        // UTF-16 is encoded, a surrogate without its pair becomes U+FFFD
+        if (c < 0x80)
+        {
+            put(static_cast<char>(c));
+            continue;
+        }
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < length &&
+            static_cast<Unit>(text[i + 1]) >= 0xDC00 && static_cast<Unit>(text[i + 1]) < 0xE000)
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<Unit>(text[++i]) - 0xDC00);
+        else if (c >= 0xD800 && c < 0xE000)
+            c = 0xFFFD;
+
+        if (c < 0x800)
+        {
+            put(static_cast<char>(0xC0 | (c >> 6)));
+        }
+        else if (c < 0x10000)
+        {
+            put(static_cast<char>(0xE0 | (c >> 12)));
+            put(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        }
+        else
+        {
+            put(static_cast<char>(0xF0 | (c >> 18)));
+            put(static_cast<char>(0x80 | ((c >> 12) & 0x3F)));
+            put(static_cast<char>(0x80 | ((c >> 6) & 0x3F)));
+        }
+        put(static_cast<char>(0x80 | (c & 0x3F)));
+#else
+        // POSIX paths are UTF-8 already
+        put(static_cast<char>(c));
+#endif
+    }
+}
+
+bool ResultExport::flush()
+{
+    if (used_ && !failed_ &&
+        !(file_ ? file_->append(buffer_.get(), used_)
+                : std::fwrite(buffer_.get(), 1, used_, stream_) == used_))
+        failed_ = true;
+    used_ = 0;
+    return !failed_;
+}
@@ -0,0 +1,99 @@
+/****************************** Module Header ******************************\
+Module Name:  ResultExport.h
+Project:      CppShellExtContextMenuHandler
+
+Writes FileRecords to a file as UTF-8 text, one record at a time, in one of
+three formats:
+  - CSV: a header line, then a line per record; text fields are quoted,
+  - NDJSON: a JSON object per line,
+  - JSON: an array of those objects.
+The fields are the same in every format: path, name, type (file or
+folder), status, size, creation time (ISO 8601, UTC), checksum algorithm
+and checksum; a folder adds the files, folders and unreadable entries of
+its tree, and its checksum is the combined one, in hex.
+
+Records go through one buffer that is allocated with the writer and
+handed to File::append (or to a stdio stream, such as the standard output
+of the command line tool) when it is full, so writing a record allocates
+nothing and a large export takes few system calls. Paths are written
+without the \\?\ prefix of long paths.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef RESULTEXPORT_H
+#define RESULTEXPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include "File.h"
+#include "FileRecord.h"
+#include "Hasher.h"
+
+enum ExportFormat
+{
+    ExportCsv,
+    ExportNdjson,
+    ExportJson
+};
+
+class ResultExport
+{
+public:
+    //! Haponov - bytes gathered before they are written
+    static const std::size_t bufferSize = 64 << 10;
+
+    //! Haponov - records checksummed with algorithm go to file, which is
+    //            open for appending
+    ResultExport(File& file, ExportFormat format, HashAlgorithm algorithm);
+    //! Haponov - the same to stream, which is flushed by end()
+    ResultExport(std::FILE* stream, ExportFormat format, HashAlgorithm algorithm);
+
+    //! Haponov - the CSV header or the opening of the JSON array
+    bool begin();
+    //! Haponov - one record, in whatever stage it is
+    bool write(const FileRecord& record);
+    //! Haponov - the end of the JSON array, then everything still buffered;
+    //            false if any write failed
+    bool end();
+
+    //! Haponov - records written so far
+    std::uint64_t records() const;
+
+    //! Haponov - format of a file extension such as "csv", case
+    //            insensitive; false if there is none
+    static bool fromExtension(const PathChar* extension, ExportFormat& format);
+
+private:
+    ResultExport(const ResultExport&);
+    ResultExport& operator=(const ResultExport&);
+
+    void put(char c);
+    void put(const char* text);
+    void putNumber(std::uint64_t value);
+    //! Haponov - nanoseconds since 1970 as "YYYY-MM-DDTHH:MM:SSZ", quoted
+    void putTime(std::uint64_t nanoseconds);
+    //! Haponov - ASCII text that needs no escaping, quoted
+    void putQuoted(const char* ascii);
+    //! Haponov - path without the long path prefix, quoted
+    void putPath(const PathChar* path);
+    //! Haponov - text of length characters as UTF-8, escaped for the
+    //            format, between the quotes of putPath
+    void putChars(const PathChar* text, std::size_t length);
+    bool flush();
+
+    File* file_;
+    std::FILE* stream_;
+    ExportFormat format_;
+    HashAlgorithm algorithm_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t used_;
+    std::uint64_t records_;
+    bool failed_;
+};
+
+#endif // RESULTEXPORT_H
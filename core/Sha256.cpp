@@ -0,0 +1,248 @@
+
+#include "Sha256.h"
+#include "CpuFeatures.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef CPUFEATURES_X86
+#define SHA256_X86
+#include <immintrin.h>
+#endif
+
+const std::size_t Sha256::blockSize;
+
+namespace
+{
+    const std::uint32_t initialState[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    const std::uint32_t roundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    std::uint32_t rotr(std::uint32_t v, int r)
+    {
+        return (v >> r) | (v << (32 - r));
+    }
+
+    void compressScalar(std::uint32_t* state, const unsigned char* data, std::size_t blocks)
+    {
+        for (; blocks; --blocks, data += Sha256::blockSize)
+        {
+            std::uint32_t w[64];
+            for (int t = 0; t < 16; ++t)
+                w[t] = (static_cast<std::uint32_t>(data[4 * t]) << 24) |
+                       (static_cast<std::uint32_t>(data[4 * t + 1]) << 16) |
+                       (static_cast<std::uint32_t>(data[4 * t + 2]) << 8) | data[4 * t + 3];
+            for (int t = 16; t < 64; ++t)
+            {
+                std::uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+                std::uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+                w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+            }
+
+            std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int t = 0; t < 64; ++t)
+            {
+                std::uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+                                   ((e & f) ^ (~e & g)) + roundConstants[t] + w[t];
+                std::uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+                                   ((a & b) ^ (a & c) ^ (b & c));
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+    }
+
+#ifdef SHA256_X86
+    // The SHA instructions keep the state as ABEF and CDGH and run two
+    // rounds per SHA256RNDS2, four message words are prepared at a time
+    CPU_TARGET("sha,sse4.1,ssse3")
+    void compressShaNi(std::uint32_t* state, const unsigned char* data, std::size_t blocks)
+    {
+        const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+        __m128i abcd = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state));
+        __m128i efgh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4));
+        __m128i cdab = _mm_shuffle_epi32(abcd, 0xB1);
+        efgh = _mm_shuffle_epi32(efgh, 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+        for (; blocks; --blocks, data += Sha256::blockSize)
+        {
+            __m128i abefSaved = abef;
+            __m128i cdghSaved = cdgh;
+            __m128i w[4];
+
+            for (int group = 0; group < 16; ++group)
+            {
+                __m128i& words = w[group % 4];
+                if (group < 4)
+                {
+                    words = _mm_shuffle_epi8(_mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(data) + group), byteSwap);
+                }
+                else
+                {
+                    // w[t - 16] + s0(w[t - 15]) + w[t - 7], then s1(w[t - 2])
+                    __m128i next = _mm_sha256msg1_epu32(w[group % 4], w[(group + 1) % 4]);
+                    next = _mm_add_epi32(next, _mm_alignr_epi8(w[(group + 3) % 4], w[(group + 2) % 4], 4));
+                    words = _mm_sha256msg2_epu32(next, w[(group + 3) % 4]);
+                }
+
+                __m128i keyed = _mm_add_epi32(words, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(roundConstants) + group));
+                cdgh = _mm_sha256rnds2_epu32(cdgh, abef, keyed);
+                abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(keyed, 0x0E));
+            }
+
+            abef = _mm_add_epi32(abef, abefSaved);
+            cdgh = _mm_add_epi32(cdgh, cdghSaved);
+        }
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+    }
+#endif
+
+    struct Compression
+    {
+        const char* name;
+        void (*compress)(std::uint32_t* state, const unsigned char* data, std::size_t blocks);
+    };
+
+    std::vector<Compression> variants()
+    {
+        std::vector<Compression> v;
+        Compression plain = { "scalar", &compressScalar };
+        v.push_back(plain);
+#ifdef SHA256_X86
+        const CpuFeatures& cpu = CpuFeatures::get();
+        if (cpu.sha && cpu.sse41 && cpu.ssse3)
+        {
+            Compression c = { "sha-ni", &compressShaNi };
+            v.push_back(c);
+        }
+#endif
+        return v;
+    }
+
+    // Found when the module is loaded, the last one is the fastest
+    const std::vector<Compression> available = variants();
+}
+
+Sha256::Sha256() : variant_(available.size() - 1)
+{
+    reset();
+}
+
+Sha256::Sha256(std::size_t variant) :
+    variant_(variant < available.size() ? variant : available.size() - 1)
+{
+    reset();
+}
+
+void Sha256::reset()
+{
+    std::memcpy(state_, initialState, sizeof(state_));
+    bufferedSize_ = 0;
+    totalLength_ = 0;
+}
+
+void Sha256::update(const char* data, std::size_t length)
+{
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    totalLength_ += length;
+
+    if (bufferedSize_)
+    {
+        std::size_t load = blockSize - bufferedSize_;
+        if (load > length)
+            load = length;
+        std::memcpy(buffer_ + bufferedSize_, input, load);
+        bufferedSize_ += load;
+        input += load;
+        length -= load;
+        if (bufferedSize_ < blockSize)
+            return;
+        available[variant_].compress(state_, buffer_, 1);
+        bufferedSize_ = 0;
+    }
+
+    std::size_t blocks = length / blockSize;
+    if (blocks)
+    {
+        available[variant_].compress(state_, input, blocks);
+        input += blocks * blockSize;
+        length -= blocks * blockSize;
+    }
+
+    std::memcpy(buffer_, input, length);
+    bufferedSize_ = length;
+}
+
+void Sha256::finalize(Digest& digest)
+{
+    // A one bit, zeros up to 8 bytes before a block end, the length in bits
+    std::uint64_t bits = totalLength_ * 8;
+    unsigned char padding[2 * blockSize] = { 0x80 };
+    std::size_t padLength = (bufferedSize_ < blockSize - 8 ? blockSize : 2 * blockSize) - bufferedSize_;
+    for (int i = 0; i < 8; ++i)
+        padding[padLength - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+
+    std::uint64_t total = totalLength_;
+    update(reinterpret_cast<const char*>(padding), padLength);
+    totalLength_ = total;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        digest.bytes[4 * i] = static_cast<unsigned char>(state_[i] >> 24);
+        digest.bytes[4 * i + 1] = static_cast<unsigned char>(state_[i] >> 16);
+        digest.bytes[4 * i + 2] = static_cast<unsigned char>(state_[i] >> 8);
+        digest.bytes[4 * i + 3] = static_cast<unsigned char>(state_[i]);
+    }
+    digest.algorithm = HashSha256;
+    digest.length = 32;
+}
+
+const char* Sha256::selectedName()
+{
+    return available.back().name;
+}
+
+std::vector<const char*> Sha256::supported()
+{
+    std::vector<const char*> names;
+    for (const Compression& compression : available)
+        names.push_back(compression.name);
+    return names;
+}
@@ -0,0 +1,48 @@
+/****************************** Module Header ******************************\
+Module Name:  Sha256.h
+Project:      CppShellExtContextMenuHandler
+
+SHA-256 (FIPS 180-4). Blocks of 64 bytes are compressed with the SHA
+extensions (SHA256RNDS2, SHA256MSG1/2) when the CPU has them, and with
+the plain round function otherwise.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include "Hasher.h"
+
+#include <vector>
+
+class Sha256 : public Hasher
+{
+public:
+    Sha256();
+    //! Haponov - hasher with the compression function supported()[variant]
+    explicit Sha256(std::size_t variant);
+
+    void update(const char* data, std::size_t length);
+    void finalize(Digest& digest);
+    void reset();
+
+    //! Haponov - name of the selected compression function
+    static const char* selectedName();
+
+    //! Haponov - every compression function this CPU can run, the plain
+    //            one first; the last is the selected one
+    static std::vector<const char*> supported();
+
+    static const std::size_t blockSize = 64;
+
+private:
+    std::size_t variant_;
+    std::uint32_t state_[8];
+    unsigned char buffer_[blockSize];
+    std::size_t bufferedSize_;
+    std::uint64_t totalLength_;
+};
+
+#endif // SHA256_H
@@ -0,0 +1,90 @@
+
+#include "TextFormat.h"
+
+#include <cstdio>
+#include <ctime>
+
+const std::size_t TextFormat::groupedSize;
+const std::size_t TextFormat::localTimeSize;
+const std::size_t TextFormat::utcTimeSize;
+
+std::size_t TextFormat::grouped(std::uint64_t value, char* text)
+{
+    char digits[20];
+    std::size_t count = 0;
+    do
+    {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    std::size_t length = 0;
+    for (std::size_t i = count; i-- > 0; )
+    {
+        text[length++] = digits[i];
+        if (i && i % 3 == 0)
+            text[length++] = ' ';
+    }
+    text[length] = 0;
+    return length;
+}
+
+bool TextFormat::localTime(std::uint64_t nanoseconds, char* text)
+{
+    text[0] = 0;
+    std::time_t seconds = static_cast<std::time_t>(nanoseconds / 1000000000ull);
+    std::tm local;
+#ifdef _WIN32
+    if (localtime_s(&local, &seconds) != 0)
+        return false;
+#else
+    if (!localtime_r(&seconds, &local))
+        return false;
+#endif
+
+    int length = std::snprintf(text, localTimeSize, "%02d/%02d/%d %02d:%02d",
+                               local.tm_mon + 1, local.tm_mday, local.tm_year + 1900,
+                               local.tm_hour, local.tm_min);
+    return length > 0 && static_cast<std::size_t>(length) < localTimeSize;
+}
+
+std::size_t TextFormat::utcTime(std::uint64_t nanoseconds, char* text)
+{
+    // The civil date of a day number since 1970 (proleptic Gregorian),
+    // counted in eras of 400 years from March 1st of the year 0
+    std::uint64_t seconds = nanoseconds / 1000000000ull;
+    std::uint64_t days = seconds / 86400;
+    std::uint64_t time = seconds % 86400;
+
+    std::uint64_t z = days + 719468;
+    std::uint64_t era = z / 146097;
+    std::uint64_t dayOfEra = z - era * 146097;
+    std::uint64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    std::uint64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    std::uint64_t monthFromMarch = (5 * dayOfYear + 2) / 153;
+    std::uint64_t day = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+    std::uint64_t month = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+    std::uint64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+    const std::uint64_t parts[] = { year, month, day, time / 3600, time / 60 % 60, time % 60 };
+    const char separators[] = { '-', '-', 'T', ':', ':', 'Z' };
+    std::size_t length = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        char digits[20];
+        std::size_t count = 0;
+        std::uint64_t value = parts[i];
+        do
+        {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value);
+        if (i && count < 2)
+            digits[count++] = '0';
+        while (count)
+            text[length++] = digits[--count];
+        text[length++] = separators[i];
+    }
+    text[length] = 0;
+    return length;
+}
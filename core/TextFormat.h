@@ -0,0 +1,47 @@
+/****************************** Module Header ******************************\
+Module Name:  TextFormat.h
+Project:      CppShellExtContextMenuHandler
+
+The numbers and times of a report as people read them: sizes with their
+digits in groups of three, creation times in local time; and times as
+programs read them, in UTC (ISO 8601). The text is ASCII, written into a
+buffer of the caller, so the dialog can widen it and the command line
+tools can print it as it is.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef TEXTFORMAT_H
+#define TEXTFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+class TextFormat
+{
+public:
+    //! Haponov - 20 digits, 6 spaces between their groups and a NUL
+    static const std::size_t groupedSize = 27;
+    //! Haponov - "MM/DD/YYYY HH:MM" and its NUL, with room for a longer
+    //            year
+    static const std::size_t localTimeSize = 24;
+    //! Haponov - "YYYY-MM-DDTHH:MM:SSZ" and its NUL, with room for a
+    //            longer year
+    static const std::size_t utcTimeSize = 32;
+
+    //! Haponov - decimal number with a space between groups of three
+    //            digits, sizes over 4 GB included; returns its length
+    static std::size_t grouped(std::uint64_t value, char* text);
+
+    //! Haponov - nanoseconds since 1970 as "MM/DD/YYYY HH:MM" in the
+    //            local time zone; empty and false if there is no such
+    //            time
+    static bool localTime(std::uint64_t nanoseconds, char* text);
+
+    //! Haponov - nanoseconds since 1970 as "YYYY-MM-DDTHH:MM:SSZ";
+    //            returns its length
+    static std::size_t utcTime(std::uint64_t nanoseconds, char* text);
+};
+
+#endif // TEXTFORMAT_H
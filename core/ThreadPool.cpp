@@ -0,0 +1,377 @@
+
+#include "ThreadPool.h"
+
+namespace
+{
+    // Idle threads of the shared pool exit after this time
+    const std::chrono::milliseconds sharedIdleTimeout(30000);
+
+    std::mutex sharedLock;
+    ThreadPool* sharedPool = nullptr;
+
+    // Work stealing: the pool and the deque slot of the current thread,
+    // jobs queued from a pool thread go to its own deque
+    thread_local ThreadPool* currentPool = nullptr;
+    thread_local int currentQueue = -1;
+}
+
+JobGroup::JobGroup() : pending_(0)
+{
+}
+
+void JobGroup::add()
+{
+    std::unique_lock <std::mutex> l(lock_);
+    ++pending_;
+}
+
+void JobGroup::done()
+{
+    std::unique_lock <std::mutex> l(lock_);
+    if (--pending_ == 0)
+        condVar_.notify_all();
+}
+
+void JobGroup::wait()
+{
+    std::unique_lock <std::mutex> l(lock_);
+    while (pending_ > 0)
+        condVar_.wait(l);
+}
+
+void JobGroup::cancel()
+{
+    cancellation_.cancel();
+}
+
+void JobGroup::setDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    cancellation_.setDeadline(deadline);
+}
+
+bool JobGroup::cancelled() const
+{
+    return cancellation_.cancelled();
+}
+
+CancellationToken JobGroup::token() const
+{
+    return cancellation_.token();
+}
+
+ThreadPool::ThreadPool(int threads, Scheduling scheduling) : shutdown_(false),
+    dropBatches_(false), maxThreads_(threads), idleTimeout_(0), scheduling_(scheduling),
+    liveThreads_(0), idleThreads_(0), activeJobs_(0), queuedJobs_(0),
+    nextQueue_(0)
+{
+    for (int i = 0; scheduling_ == WorkStealing && i < threads; ++i)
+        queues_.emplace_back(new WorkerQueue);
+
+    // Create the specified number of threads
+    std::unique_lock <std::mutex> l(lock_);
+    threads_.reserve(threads);
+    for (int i = 0; i < threads; ++i)
+        startThread();
+}
+
+ThreadPool::ThreadPool(int threads, std::chrono::milliseconds idleTimeout,
+                       Scheduling scheduling) :
+    shutdown_(false), dropBatches_(false), maxThreads_(threads),
+    idleTimeout_(idleTimeout), scheduling_(scheduling), liveThreads_(0),
+    idleThreads_(0), activeJobs_(0), queuedJobs_(0), nextQueue_(0)
+{
+    for (int i = 0; scheduling_ == WorkStealing && i < threads; ++i)
+        queues_.emplace_back(new WorkerQueue);
+
+    // Threads are started by doJob
+    threads_.reserve(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        // Unblock any threads and tell them to stop; the queue is still
+        // run, but batch jobs only report that they are done
+        std::unique_lock <std::mutex> l(lock_);
+
+        shutdown_ = true;
+        dropBatches_ = true;
+        condVar_.notify_all();
+    }
+
+    // Wait for all threads to stop
+    //std::cerr << "Joining threads" << std::endl;
+    for (auto& thread : threads_)
+        if (thread.joinable())
+            thread.join();
+}
+
+void ThreadPool::startThread()
+{
+    ++liveThreads_;
+    if (!retired_.empty())
+    {
+        // Reuse the slot of a thread that has exited on idle timeout
+        int i = retired_.back();
+        retired_.pop_back();
+        threads_[i].join();
+        threads_[i] = std::thread(&ThreadPool::threadEntry, this, i);
+        return;
+    }
+
+    int i = static_cast<int>(threads_.size());
+    threads_.emplace_back(&ThreadPool::threadEntry, this, i);
+}
+
+void ThreadPool::doJob(std::function <void(void)> func)
+{
+    if (scheduling_ == WorkStealing)
+    {
+        pushJob(func);
+        return;
+    }
+
+    // Place a job on the queue and unblock a thread
+    std::unique_lock <std::mutex> l(lock_);
+
+    jobs_.emplace(std::move(func));
+    if (jobs_.size() > static_cast<std::size_t>(idleThreads_) &&
+        liveThreads_ < maxThreads_)
+        startThread();
+    else
+        condVar_.notify_one();
+}
+
+void ThreadPool::doJob(JobGroup& group, std::function <void(void)> func)
+{
+    group.add();
+    doJob([this, &group, func = std::move(func)]()
+    {
+        // Report the job as done even if it throws
+        struct Done
+        {
+            JobGroup& group;
+            ~Done() { group.done(); }
+        } done = { group };
+
+        // A cancelled batch drops the jobs that have not started yet
+        if (!group.cancelled() && !dropBatches_)
+            func();
+    });
+}
+
+bool ThreadPool::idle()
+{
+    // A job is counted as active before it stops being queued
+    if (scheduling_ == WorkStealing)
+        return !queuedJobs_ && !activeJobs_;
+
+    std::unique_lock <std::mutex> l(lock_);
+    return jobs_.empty() && !activeJobs_;
+}
+
+void ThreadPool::threadEntry(int i)
+{
+    if (scheduling_ == WorkStealing)
+    {
+        stealingEntry(i);
+        return;
+    }
+
+    std::function <void(void)> job;
+
+    while (1)
+    {
+        {
+            std::unique_lock <std::mutex> l(lock_);
+
+            // The previous job, if any, is finished
+            if (job)
+            {
+                job = nullptr;
+                --activeJobs_;
+            }
+
+            while (!shutdown_ && jobs_.empty())
+            {
+                ++idleThreads_;
+                bool timedOut = false;
+                if (idleTimeout_.count())
+                    timedOut = condVar_.wait_for(l, idleTimeout_) == std::cv_status::timeout;
+                else
+                    condVar_.wait(l);
+                --idleThreads_;
+
+                // Nothing to do for a while - give the thread back, the
+                // next startThread joins it; the thread is counted out
+                // before the queue is looked at again, as in stealingEntry
+                if (timedOut && !shutdown_)
+                {
+                    --liveThreads_;
+                    if (jobs_.empty())
+                    {
+                        retired_.push_back(i);
+                        return;
+                    }
+                    ++liveThreads_;
+                }
+            }
+
+            if (jobs_.empty())
+            {
+                // No jobs to do and we are shutting down
+                //std::cerr << "Thread " << i << " terminates" << std::endl;
+                return;
+            }
+
+            //std::cerr << "Thread " << i << " does a job" << std::endl;
+            job = std::move(jobs_.front());
+            jobs_.pop();
+            ++activeJobs_;
+        }
+
+        // Do the job without holding any locks
+        job();
+    }
+}
+
+void ThreadPool::pushJob(std::function <void(void)>& func)
+{
+    // A pool thread keeps its own jobs, other callers spread them
+    int i = currentPool == this ? currentQueue :
+        static_cast<int>(nextQueue_++ % queues_.size());
+    {
+        std::unique_lock <std::mutex> l(queues_[i]->lock);
+        queues_[i]->jobs.push_back(std::move(func));
+    }
+    ++queuedJobs_;
+
+    // lock_ is needed only to wake a sleeping thread or start a new one;
+    // a thread going to sleep checks queuedJobs_ after it is counted idle,
+    // a thread that retires after it is no longer counted live
+    if (idleThreads_ > 0 || liveThreads_ < maxThreads_)
+    {
+        std::unique_lock <std::mutex> l(lock_);
+        if (!idleThreads_ && liveThreads_ < maxThreads_ && !shutdown_)
+            startThread();
+        else
+            condVar_.notify_one();
+    }
+}
+
+bool ThreadPool::popJob(int i, std::function <void(void)>& job)
+{
+    int n = static_cast<int>(queues_.size());
+    for (int k = 0; k < n; ++k)
+    {
+        WorkerQueue& queue = *queues_[(i + k) % n];
+        std::unique_lock <std::mutex> l(queue.lock);
+        if (queue.jobs.empty())
+            continue;
+
+        // Own deque from the back, the victims from the front
+        if (!k)
+        {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        }
+        else
+        {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        ++activeJobs_;
+        --queuedJobs_;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::stealingEntry(int i)
+{
+    currentPool = this;
+    currentQueue = i;
+
+    std::function <void(void)> job;
+
+    while (1)
+    {
+        if (popJob(i, job))
+        {
+            // Do the job without holding any locks
+            job();
+            job = nullptr;
+            --activeJobs_;
+            continue;
+        }
+
+        std::unique_lock <std::mutex> l(lock_);
+
+        // A job pushed before this thread is counted idle must be seen here
+        ++idleThreads_;
+        if (queuedJobs_)
+        {
+            --idleThreads_;
+            continue;
+        }
+
+        if (shutdown_)
+        {
+            // No jobs to do and we are shutting down
+            --idleThreads_;
+            break;
+        }
+
+        bool timedOut = false;
+        if (idleTimeout_.count())
+            timedOut = condVar_.wait_for(l, idleTimeout_) == std::cv_status::timeout;
+        else
+            condVar_.wait(l);
+        --idleThreads_;
+
+        // Nothing to do for a while - give the thread back, the next
+        // startThread joins it. pushJob counts its job before it reads
+        // liveThreads_ without lock_, so the thread is counted out before
+        // queuedJobs_ is read again: either pushJob sees a free slot and
+        // starts a thread, or its job is seen here and the thread stays
+        if (timedOut && !shutdown_)
+        {
+            --liveThreads_;
+            if (!queuedJobs_)
+            {
+                retired_.push_back(i);
+                break;
+            }
+            ++liveThreads_;
+        }
+    }
+
+    currentPool = nullptr;
+    currentQueue = -1;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    if (!sharedPool)
+    {
+        int threads = static_cast<int>(std::thread::hardware_concurrency());
+        sharedPool = new ThreadPool(threads > 0 ? threads : 1, sharedIdleTimeout,
+                                    WorkStealing);
+    }
+    return *sharedPool;
+}
+
+bool ThreadPool::releaseShared()
+{
+    std::unique_lock <std::mutex> l(sharedLock);
+    if (!sharedPool)
+        return true;
+    if (!sharedPool->idle())
+        return false;
+
+    // Joins the threads, including the ones that have already retired
+    delete sharedPool;
+    sharedPool = nullptr;
+    return true;
+}
@@ -0,0 +1,167 @@
+/****************************** Module Header ******************************\
+Module Name:  ThreadPool.h
+Project:      CppShellExtContextMenuHandler
+
+Creates a pool of threads that take tasks. Intended for the maximum number of
+threads available for hardware or any other number of threads.
+
+The pool either starts all of its threads at once, or starts them lazily when
+jobs arrive and lets them retire after an idle timeout. The process-wide
+shared() pool is of the second kind - it is reused by every context menu
+invocation and holds no threads while Explorer is idle.
+
+Jobs are scheduled either through one queue shared by all threads, or with
+work stealing: every thread owns a deque, takes its own newest job first
+(LIFO) and steals the oldest jobs of other threads (FIFO) when it runs dry,
+so threads do not fight over one lock when there are many small jobs.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <chrono>
+
+#include "Cancellation.h"
+
+//!Haponov - counts jobs of one batch, so their owner can wait for them,
+//           and lets the owner cancel them
+class JobGroup
+{
+public:
+    JobGroup();
+
+    //!Haponov - a job of the batch is queued / finished
+    void add();
+    void done();
+
+    //!Haponov - block until every added job is done
+    void wait();
+
+    //!Haponov - jobs of the batch that have not started are dropped,
+    //           running ones see it through token() and stop early
+    void cancel();
+
+    //!Haponov - cancel the batch when the steady clock reaches deadline
+    void setDeadline(std::chrono::steady_clock::time_point deadline);
+
+    bool cancelled() const;
+
+    //!Haponov - for the running jobs to check between their steps
+    CancellationToken token() const;
+
+private:
+    std::mutex lock_;
+    std::condition_variable condVar_;
+    int pending_;
+    CancellationSource cancellation_;
+};
+
+class ThreadPool
+{
+public:
+    //! Haponov - how jobs are handed to threads
+    enum Scheduling
+    {
+        SharedQueue,    // one queue and one lock for all threads
+        WorkStealing    // per-thread deques, idle threads steal
+    };
+
+    //! Haponov - create as many threads as needed
+    ThreadPool(int threads, Scheduling scheduling = SharedQueue);
+
+    //! Haponov - start up to "threads" threads on demand, a thread that
+    //            has nothing to do for idleTimeout exits
+    ThreadPool(int threads, std::chrono::milliseconds idleTimeout,
+               Scheduling scheduling = SharedQueue);
+
+    //!Haponov - hand tasks to threads of pool
+    void doJob(std::function <void(void)> func);
+
+    //!Haponov - hand a task that belongs to a batch, group.done() is
+    //           called when it finishes or is dropped because the batch
+    //           was cancelled
+    void doJob(JobGroup& group, std::function <void(void)> func);
+
+    //!Haponov - nothing is queued and no job is running
+    bool idle();
+
+    ~ThreadPool();
+
+    //!Haponov - process-wide pool, created on first use
+    static ThreadPool& shared();
+
+    //!Haponov - destroy the shared pool if it is idle, so the DLL can be
+    //           unloaded; returns false if it still has work
+    static bool releaseShared();
+
+protected:
+    //!Haponov - manage threads/tasks in pool:
+    //           move tasks in container, actully run the tasks
+    void threadEntry(int i);
+
+    //!Haponov - start one more thread, lock_ must be held
+    void startThread();
+
+    //!Haponov - work stealing: queue a job, run jobs until shutdown
+    void pushJob(std::function <void(void)>& func);
+    bool popJob(int i, std::function <void(void)>& job);
+    void stealingEntry(int i);
+
+    //!Haponov - deque owned by one thread, padded so that neighbouring
+    //           deques do not share a cache line
+    struct WorkerQueue
+    {
+        std::mutex lock;
+        std::deque <std::function <void(void)>> jobs;
+        char padding[64];
+    };
+
+    std::mutex lock_;
+    std::condition_variable condVar_;
+    bool shutdown_;
+    //!Haponov - set by the destructor, batch jobs that have not started
+    //           are dropped from then on
+    std::atomic <bool> dropBatches_;
+
+    //!Haponov - thread limit and how long an idle thread lives
+    //           (zero - forever)
+    int maxThreads_;
+    std::chrono::milliseconds idleTimeout_;
+    Scheduling scheduling_;
+
+    //!Haponov - running threads, those waiting for a job,
+    //           jobs being executed; changed under lock_, work stealing
+    //           reads them without it
+    std::atomic <int> liveThreads_;
+    std::atomic <int> idleThreads_;
+    std::atomic <int> activeJobs_;
+
+    //!Haponov - contain tasks to do
+    std::queue <std::function <void(void)>> jobs_;
+    //!Haponov - threads for doing tasks
+    std::vector <std::thread> threads_;
+    //!Haponov - indices of threads_ whose threads exited on idle timeout,
+    //           joined and reused by startThread
+    std::vector <int> retired_;
+
+    //!Haponov - work stealing: one deque per thread slot, number of jobs
+    //           in all of them, round-robin slot for jobs from outside
+    std::vector <std::unique_ptr <WorkerQueue>> queues_;
+    std::atomic <int> queuedJobs_;
+    std::atomic <unsigned> nextQueue_;
+};
+
+#endif // THREADPOOL_H
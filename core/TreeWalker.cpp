@@ -0,0 +1,382 @@
+
+#include "TreeWalker.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    // A directory that is not done yet, with the totals gathered so far
+    struct Node
+    {
+        Node* parent;
+        PathString path;
+        unsigned depth;
+        // its own listing and every subdirectory that is not done
+        std::atomic <int> pending;
+
+        std::atomic <std::uint64_t> files;
+        std::atomic <std::uint64_t> directories;
+        std::atomic <std::uint64_t> unreadable;
+        std::atomic <std::uint64_t> bytes;
+        std::atomic <std::uint64_t> checksum;
+
+        Node(Node* parent, const PathString& path, unsigned depth) :
+            parent(parent), path(path), depth(depth), pending(1),
+            files(0), directories(0), unreadable(0), bytes(0), checksum(0)
+        {
+        }
+    };
+
+    // Directories pushed by one participant, padded so that neighbouring
+    // deques do not share a cache line
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque <Node*> nodes;
+        char padding[64];
+    };
+
+    // One walk, shared with helper jobs that may start only after it is
+    // over - they find nothing to take and leave
+    struct Walk : std::enable_shared_from_this<Walk>
+    {
+        TreeWalker::FileFunc file;
+        TreeWalker::DirectoryFunc directory;
+        ThreadPool* pool;
+        CancellationToken cancel;
+
+        // slot 0 is the calling thread, helpers share the others
+        std::vector <std::unique_ptr <Queue>> queues;
+        std::atomic <int> queued;
+        std::atomic <unsigned> helpers;
+        std::atomic <unsigned> nextSlot;
+        std::atomic <bool> ownerWaiting;
+
+        std::mutex lock;
+        std::condition_variable condVar;
+        bool done;
+        bool rootListed;
+        TreeTotals totals;
+
+        Walk() : pool(NULL), queued(0), helpers(0), nextSlot(0), ownerWaiting(false),
+            done(false), rootListed(false), totals()
+        {
+        }
+
+        void push(unsigned slot, Node* node)
+        {
+            {
+                Queue& queue = *queues[slot];
+                std::unique_lock <std::mutex> l(queue.lock);
+                queue.nodes.push_back(node);
+            }
+            ++queued;
+
+            // One more helper while there are fewer than participants
+            unsigned running = helpers.load();
+            while (pool && running + 1 < queues.size())
+            {
+                if (helpers.compare_exchange_weak(running, running + 1))
+                {
+                    std::shared_ptr<Walk> self = shared_from_this();
+                    pool->doJob([self]() { self->help(); });
+                    break;
+                }
+            }
+
+            // queued is raised before ownerWaiting is read, and the owner
+            // sets it before it reads queued, so one of them sees the other
+            if (ownerWaiting.load())
+            {
+                std::unique_lock <std::mutex> l(lock);
+                condVar.notify_all();
+            }
+        }
+
+        // The newest directory of slot, else the oldest one of another
+        bool take(unsigned slot, Node*& node)
+        {
+            if (queued.load() <= 0)
+                return false;
+            std::size_t count = queues.size();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                Queue& queue = *queues[(slot + i) % count];
+                std::unique_lock <std::mutex> l(queue.lock);
+                if (queue.nodes.empty())
+                    continue;
+                if (i == 0)
+                {
+                    node = queue.nodes.back();
+                    queue.nodes.pop_back();
+                }
+                else
+                {
+                    node = queue.nodes.front();
+                    queue.nodes.pop_front();
+                }
+                --queued;
+                return true;
+            }
+            return false;
+        }
+
+        void help()
+        {
+            unsigned slot = 1 + nextSlot++ % static_cast<unsigned>(queues.size() - 1);
+            Node* node;
+            while (take(slot, node))
+                list(slot, node);
+            --helpers;
+        }
+
+        // The calling thread: works until the root is done
+        void run()
+        {
+            Node* node;
+            for (;;)
+            {
+                while (take(0, node))
+                    list(0, node);
+
+                ownerWaiting = true;
+                std::unique_lock <std::mutex> l(lock);
+                while (!done && queued.load() <= 0)
+                    condVar.wait(l);
+                ownerWaiting = false;
+                if (done)
+                    return;
+            }
+        }
+
+        void list(unsigned slot, Node* node)
+        {
+            TreeTotals found = {};
+            bool listed = !cancel.cancelled() && listDirectory(slot, node, found);
+            if (!node->depth)
+                rootListed = listed;
+            else if (!listed)
+                ++found.unreadable;
+
+            node->files += found.files;
+            node->unreadable += found.unreadable;
+            node->bytes += found.bytes;
+            node->checksum += found.checksum;
+            finish(node);
+        }
+
+        void subdirectory(unsigned slot, Node* node, const PathString& path)
+        {
+            ++node->pending;
+            push(slot, new Node(node, path, node->depth + 1));
+        }
+
+        void regularFile(const PathString& path, std::uint64_t size, TreeTotals& found)
+        {
+            ++found.files;
+            found.bytes += size;
+            std::uint64_t checksum = 0;
+            if (!file)
+                return;
+            if (cancel.cancelled() || !file(path, size, checksum))
+                ++found.unreadable;
+            else
+                found.checksum += checksum;
+        }
+
+        bool listDirectory(unsigned slot, Node* node, TreeTotals& found);
+
+        // A directory whose listing and subdirectories are all done goes
+        // into its parent, which may be done with that too
+        void finish(Node* node)
+        {
+            while (node && --node->pending == 0)
+            {
+                TreeTotals sum = {};
+                sum.files = node->files;
+                sum.directories = node->directories;
+                sum.unreadable = node->unreadable;
+                sum.bytes = node->bytes;
+                sum.checksum = node->checksum;
+                if (directory)
+                    directory(node->path, node->depth, sum);
+
+                Node* parent = node->parent;
+                if (parent)
+                {
+                    parent->files += sum.files;
+                    parent->directories += sum.directories + 1;
+                    parent->unreadable += sum.unreadable;
+                    parent->bytes += sum.bytes;
+                    parent->checksum += sum.checksum;
+                }
+                else
+                {
+                    std::unique_lock <std::mutex> l(lock);
+                    totals = sum;
+                    done = true;
+                    condVar.notify_all();
+                }
+                delete node;
+                node = parent;
+            }
+        }
+    };
+
+#ifdef _WIN32
+
+    bool Walk::listDirectory(unsigned slot, Node* node, TreeTotals& found)
+    {
+        PathString path = node->path;
+        if (!path.empty() && path[path.size() - 1] != L'\\')
+            path += L'\\';
+        std::size_t base = path.size();
+        path += L'*';
+
+        // The basic information skips the short names, the large fetch
+        // asks for more entries per call
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW(path.c_str(), FindExInfoBasic, &data,
+                                       FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE)
+            return false;
+
+        do
+        {
+            const wchar_t* name = data.cFileName;
+            if (name[0] == L'.' && (!name[1] || (name[1] == L'.' && !name[2])))
+                continue;
+
+            // Junctions and links may lead back up the tree, and a link
+            // to a file counts a file twice, as the POSIX walk knows;
+            // other reparse points - cloud placeholders, deduplicated or
+            // WIM-backed files - hold content of their own and are walked
+            // as usual. The tag of a reparse point is in dwReserved0
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+                (data.dwReserved0 == IO_REPARSE_TAG_SYMLINK ||
+                 data.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT))
+                continue;
+
+            path.resize(base);
+            path += name;
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                subdirectory(slot, node, path);
+            else
+            {
+                std::uint64_t size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) |
+                                     data.nFileSizeLow;
+                regularFile(path, size, found);
+            }
+        } while (FindNextFileW(find, &data));
+
+        FindClose(find);
+        return true;
+    }
+
+#else
+
+    bool Walk::listDirectory(unsigned slot, Node* node, TreeTotals& found)
+    {
+        DIR* dir = opendir(node->path.c_str());
+        if (!dir)
+            return false;
+
+        PathString path = node->path;
+        if (path.empty() || path[path.size() - 1] != '/')
+            path += '/';
+        std::size_t base = path.size();
+
+        while (dirent* entry = readdir(dir))
+        {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                continue;
+
+            // The type of an entry is known without a stat on most file
+            // systems, the size of a file is not
+            unsigned char type = entry->d_type;
+            struct stat st;
+            if (type == DT_UNKNOWN || type == DT_REG)
+            {
+                if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                {
+                    ++found.unreadable;
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            path.resize(base);
+            path += name;
+            if (type == DT_DIR)
+                subdirectory(slot, node, path);
+            else if (type == DT_REG)
+                regularFile(path, static_cast<std::uint64_t>(st.st_size), found);
+        }
+
+        closedir(dir);
+        return true;
+    }
+
+#endif
+}
+
+TreeWalker::TreeWalker(ThreadPool* pool, FileFunc file, DirectoryFunc directory) :
+    pool_(pool), file_(std::move(file)), directory_(std::move(directory))
+{
+}
+
+bool TreeWalker::walk(const PathString& root, TreeTotals& totals, const CancellationToken& cancel)
+{
+    std::shared_ptr<Walk> walk = std::make_shared<Walk>();
+    walk->file = file_;
+    walk->directory = directory_;
+    walk->pool = pool_;
+    walk->cancel = cancel;
+
+    unsigned participants = pool_ ? std::thread::hardware_concurrency() : 1;
+    if (participants < 1)
+        participants = 1;
+    for (unsigned i = 0; i < participants; ++i)
+        walk->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+    // Everything under a long root is longer still
+    walk->push(0, new Node(NULL, File::longPath(root), 0));
+    walk->run();
+
+    totals = walk->totals;
+    return walk->rootListed && !cancel.cancelled();
+}
+
+#ifdef _WIN32
+
+bool TreeWalker::isDirectory(const PathChar* path)
+{
+    DWORD attributes = GetFileAttributesW(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+#else
+
+bool TreeWalker::isDirectory(const PathChar* path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+#endif
@@ -0,0 +1,84 @@
+/****************************** Module Header ******************************\
+Module Name:  TreeWalker.h
+Project:      CppShellExtContextMenuHandler
+
+Walks a directory tree with the threads of a ThreadPool and adds up what
+is in it: files, subdirectories, bytes and a combined checksum, for every
+directory with everything under it.
+
+Every directory found is a task. A participant - the calling thread or a
+helper job on the pool - lists its directory, hands the files to the file
+function, and pushes the subdirectories on a deque of its own; it takes
+its own newest directory first (depth first) and steals the oldest one of
+another participant when it runs dry. Helpers are started when there is
+work for them and leave when there is none, and the calling thread works
+until the walk is done, so a walk started from a pool job does not wait
+for threads that are busy elsewhere.
+
+Nothing is kept per file. A directory is kept while it or something under
+it is still being walked; when it is done its totals are reported, added
+to its parent, and it is freed. Links and junctions are not followed, and
+links to files are not counted; other reparse points, such as cloud
+placeholders, are counted as files.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef TREEWALKER_H
+#define TREEWALKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "Cancellation.h"
+#include "File.h"
+
+class ThreadPool;
+
+//! Haponov - what is under a directory, at any depth
+struct TreeTotals
+{
+    std::uint64_t files;
+    std::uint64_t directories;
+    //! files and directories that could not be read
+    std::uint64_t unreadable;
+    std::uint64_t bytes;
+    //! sum modulo 2^64 of the checksums of the files, the same in any
+    //! order the files are found in
+    std::uint64_t checksum;
+};
+
+class TreeWalker
+{
+public:
+    //! Haponov - checksum of the file at path of size bytes, false when it
+    //            cannot be read; called on several threads at once
+    typedef std::function <bool(const PathString& path, std::uint64_t size,
+                                std::uint64_t& checksum)> FileFunc;
+
+    //! Haponov - the directory at path is done, with everything under it;
+    //            depth 0 is the root; called on several threads at once
+    typedef std::function <void(const PathString& path, unsigned depth,
+                                const TreeTotals& totals)> DirectoryFunc;
+
+    //! Haponov - pool may be NULL, the calling thread then walks alone;
+    //            file may be empty, the files are only counted then
+    TreeWalker(ThreadPool* pool, FileFunc file, DirectoryFunc directory = DirectoryFunc());
+
+    //! Haponov - totals of the tree under root; false when root cannot be
+    //            listed or the walk was cancelled
+    bool walk(const PathString& root, TreeTotals& totals,
+              const CancellationToken& cancel = CancellationToken());
+
+    //! Haponov - path names a directory
+    static bool isDirectory(const PathChar* path);
+
+private:
+    ThreadPool* pool_;
+    FileFunc file_;
+    DirectoryFunc directory_;
+};
+
+#endif // TREEWALKER_H
@@ -0,0 +1,652 @@
+
+#include "Xxh3.h"
+#include "CpuFeatures.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef CPUFEATURES_X86
+#define XXH3_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+const std::size_t Xxh3::bufferSize;
+
+namespace
+{
+    const std::uint32_t prime32_1 = 0x9E3779B1U;
+    const std::uint32_t prime32_2 = 0x85EBCA77U;
+    const std::uint32_t prime32_3 = 0xC2B2AE3DU;
+    const std::uint64_t prime64_1 = 0x9E3779B185EBCA87ULL;
+    const std::uint64_t prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+    const std::uint64_t prime64_3 = 0x165667B19E3779F9ULL;
+    const std::uint64_t prime64_4 = 0x85EBCA77C2B2AE63ULL;
+    const std::uint64_t prime64_5 = 0x27D4EB2F165667C5ULL;
+    const std::uint64_t primeMx1 = 0x165667919E3779F9ULL;
+    const std::uint64_t primeMx2 = 0x9FB21C651E98DF25ULL;
+
+    const std::size_t stripeLength = 64;
+    const std::size_t secretSize = 192;
+    const std::size_t secretSizeMin = 136;
+    // The last stripe of a block is the secret consumed 8 bytes per stripe
+    const std::size_t secretLimit = secretSize - stripeLength;
+    const std::size_t stripesPerBlock = secretLimit / 8;
+    const std::size_t lastStripeStart = 7;
+    const std::size_t mergeStart = 11;
+    const std::size_t midSizeStart = 3;
+    const std::size_t midSizeLast = 17;
+    const std::size_t midSizeMax = 240;
+
+    const unsigned char secret[secretSize] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    // XXH3 reads its input little endian, as the x86 and ARM targets are
+    std::uint32_t read32(const unsigned char* p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    std::uint64_t read64(const unsigned char* p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    std::uint32_t swap32(std::uint32_t v)
+    {
+        return (v << 24) | ((v << 8) & 0x00FF0000U) | ((v >> 8) & 0x0000FF00U) | (v >> 24);
+    }
+
+    std::uint64_t swap64(std::uint64_t v)
+    {
+        return (static_cast<std::uint64_t>(swap32(static_cast<std::uint32_t>(v))) << 32) |
+               swap32(static_cast<std::uint32_t>(v >> 32));
+    }
+
+    std::uint32_t rotl32(std::uint32_t v, int r)
+    {
+        return (v << r) | (v >> (32 - r));
+    }
+
+    std::uint64_t rotl64(std::uint64_t v, int r)
+    {
+        return (v << r) | (v >> (64 - r));
+    }
+
+    // Full 128 bit product of two 64 bit numbers
+    void multiply(std::uint64_t a, std::uint64_t b, std::uint64_t& low, std::uint64_t& high)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        low = _umul128(a, b, &high);
+#elif defined(__SIZEOF_INT128__)
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        low = static_cast<std::uint64_t>(product);
+        high = static_cast<std::uint64_t>(product >> 64);
+#else
+        std::uint64_t loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        std::uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+        std::uint64_t loHi = (a & 0xFFFFFFFF) * (b >> 32);
+        std::uint64_t hiHi = (a >> 32) * (b >> 32);
+        std::uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+        high = (hiLo >> 32) + (cross >> 32) + hiHi;
+        low = (cross << 32) | (loLo & 0xFFFFFFFF);
+#endif
+    }
+
+    std::uint64_t fold(std::uint64_t a, std::uint64_t b)
+    {
+        std::uint64_t low, high;
+        multiply(a, b, low, high);
+        return low ^ high;
+    }
+
+    std::uint64_t xxh64Avalanche(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= prime64_2;
+        h ^= h >> 29;
+        h *= prime64_3;
+        return h ^ (h >> 32);
+    }
+
+    std::uint64_t avalanche(std::uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= primeMx1;
+        return h ^ (h >> 32);
+    }
+
+    std::uint64_t rrmxmx(std::uint64_t h, std::uint64_t length)
+    {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= primeMx2;
+        h ^= (h >> 35) + length;
+        h *= primeMx2;
+        return h ^ (h >> 28);
+    }
+
+    std::uint64_t mix16(const unsigned char* input, const unsigned char* key)
+    {
+        return fold(read64(input) ^ read64(key), read64(input + 8) ^ read64(key + 8));
+    }
+
+    void mix32(std::uint64_t& low, std::uint64_t& high, const unsigned char* input1,
+               const unsigned char* input2, const unsigned char* key)
+    {
+        low += mix16(input1, key);
+        low ^= read64(input2) + read64(input2 + 8);
+        high += mix16(input2, key + 16);
+        high ^= read64(input1) + read64(input1 + 8);
+    }
+
+    // 64 bit hash of up to 240 bytes
+    std::uint64_t short64(const unsigned char* input, std::size_t length)
+    {
+        if (length > 128)
+        {
+            std::uint64_t acc = length * prime64_1;
+            std::size_t rounds = length / 16;
+            for (std::size_t i = 0; i < 8; ++i)
+                acc += mix16(input + 16 * i, secret + 16 * i);
+            std::uint64_t accEnd = mix16(input + length - 16, secret + secretSizeMin - midSizeLast);
+            acc = avalanche(acc);
+            for (std::size_t i = 8; i < rounds; ++i)
+                accEnd += mix16(input + 16 * i, secret + 16 * (i - 8) + midSizeStart);
+            return avalanche(acc + accEnd);
+        }
+        if (length > 16)
+        {
+            std::uint64_t acc = length * prime64_1;
+            if (length > 32)
+            {
+                if (length > 64)
+                {
+                    if (length > 96)
+                    {
+                        acc += mix16(input + 48, secret + 96);
+                        acc += mix16(input + length - 64, secret + 112);
+                    }
+                    acc += mix16(input + 32, secret + 64);
+                    acc += mix16(input + length - 48, secret + 80);
+                }
+                acc += mix16(input + 16, secret + 32);
+                acc += mix16(input + length - 32, secret + 48);
+            }
+            acc += mix16(input, secret);
+            acc += mix16(input + length - 16, secret + 16);
+            return avalanche(acc);
+        }
+        if (length > 8)
+        {
+            std::uint64_t low = read64(input) ^ (read64(secret + 24) ^ read64(secret + 32));
+            std::uint64_t high = read64(input + length - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+            return avalanche(length + swap64(low) + high + fold(low, high));
+        }
+        if (length >= 4)
+        {
+            std::uint64_t value = read32(input + length - 4) +
+                                  (static_cast<std::uint64_t>(read32(input)) << 32);
+            return rrmxmx(value ^ (read64(secret + 8) ^ read64(secret + 16)), length);
+        }
+        if (length)
+        {
+            std::uint32_t combined = (static_cast<std::uint32_t>(input[0]) << 16) |
+                                     (static_cast<std::uint32_t>(input[length >> 1]) << 24) |
+                                     input[length - 1] |
+                                     (static_cast<std::uint32_t>(length) << 8);
+            return xxh64Avalanche(combined ^ static_cast<std::uint64_t>(read32(secret) ^ read32(secret + 4)));
+        }
+        return xxh64Avalanche(read64(secret + 56) ^ read64(secret + 64));
+    }
+
+    // 128 bit hash of up to 240 bytes
+    void short128(const unsigned char* input, std::size_t length,
+                  std::uint64_t& low, std::uint64_t& high)
+    {
+        if (length > 16)
+        {
+            std::uint64_t accLow = length * prime64_1, accHigh = 0;
+            if (length > 128)
+            {
+                for (std::size_t i = 32; i < 160; i += 32)
+                    mix32(accLow, accHigh, input + i - 32, input + i - 16, secret + i - 32);
+                accLow = avalanche(accLow);
+                accHigh = avalanche(accHigh);
+                for (std::size_t i = 160; i <= length; i += 32)
+                    mix32(accLow, accHigh, input + i - 32, input + i - 16,
+                          secret + midSizeStart + i - 160);
+                mix32(accLow, accHigh, input + length - 16, input + length - 32,
+                      secret + secretSizeMin - midSizeLast - 16);
+            }
+            else
+            {
+                if (length > 32)
+                {
+                    if (length > 64)
+                    {
+                        if (length > 96)
+                            mix32(accLow, accHigh, input + 48, input + length - 64, secret + 96);
+                        mix32(accLow, accHigh, input + 32, input + length - 48, secret + 64);
+                    }
+                    mix32(accLow, accHigh, input + 16, input + length - 32, secret + 32);
+                }
+                mix32(accLow, accHigh, input, input + length - 16, secret);
+            }
+            low = avalanche(accLow + accHigh);
+            high = 0 - avalanche(accLow * prime64_1 + accHigh * prime64_4 + length * prime64_2);
+            return;
+        }
+        if (length > 8)
+        {
+            std::uint64_t inputLow = read64(input);
+            std::uint64_t inputHigh = read64(input + length - 8);
+            std::uint64_t mLow, mHigh;
+            multiply(inputLow ^ inputHigh ^ (read64(secret + 32) ^ read64(secret + 40)),
+                     prime64_1, mLow, mHigh);
+            mLow += static_cast<std::uint64_t>(length - 1) << 54;
+            inputHigh ^= read64(secret + 48) ^ read64(secret + 56);
+            mHigh += inputHigh + static_cast<std::uint64_t>(static_cast<std::uint32_t>(inputHigh)) *
+                                 (prime32_2 - 1);
+            mLow ^= swap64(mHigh);
+
+            multiply(mLow, prime64_2, low, high);
+            high += mHigh * prime64_2;
+            low = avalanche(low);
+            high = avalanche(high);
+            return;
+        }
+        if (length >= 4)
+        {
+            std::uint64_t value = read32(input) +
+                                  (static_cast<std::uint64_t>(read32(input + length - 4)) << 32);
+            std::uint64_t keyed = value ^ (read64(secret + 16) ^ read64(secret + 24));
+            multiply(keyed, prime64_1 + (length << 2), low, high);
+            high += low << 1;
+            low ^= high >> 3;
+            low ^= low >> 35;
+            low *= primeMx2;
+            low ^= low >> 28;
+            high = avalanche(high);
+            return;
+        }
+        if (length)
+        {
+            std::uint32_t combinedLow = (static_cast<std::uint32_t>(input[0]) << 16) |
+                                        (static_cast<std::uint32_t>(input[length >> 1]) << 24) |
+                                        input[length - 1] |
+                                        (static_cast<std::uint32_t>(length) << 8);
+            std::uint32_t combinedHigh = rotl32(swap32(combinedLow), 13);
+            low = xxh64Avalanche(combinedLow ^ static_cast<std::uint64_t>(read32(secret) ^ read32(secret + 4)));
+            high = xxh64Avalanche(combinedHigh ^ static_cast<std::uint64_t>(read32(secret + 8) ^ read32(secret + 12)));
+            return;
+        }
+        low = xxh64Avalanche(read64(secret + 64) ^ read64(secret + 72));
+        high = xxh64Avalanche(read64(secret + 80) ^ read64(secret + 88));
+    }
+
+    // Add stripes of 64 bytes to the accumulators, the key moving 8 bytes
+    // along the secret per stripe
+    void accumulateScalar(std::uint64_t* acc, const unsigned char* input,
+                          const unsigned char* key, std::size_t stripes)
+    {
+        for (std::size_t s = 0; s < stripes; ++s, input += stripeLength, key += 8)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                std::uint64_t data = read64(input + 8 * i);
+                std::uint64_t keyed = data ^ read64(key + 8 * i);
+                acc[i ^ 1] += data;
+                acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+            }
+        }
+    }
+
+    // Mix the accumulators at the end of a block
+    void scrambleScalar(std::uint64_t* acc, const unsigned char* key)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            std::uint64_t a = acc[i];
+            a ^= a >> 47;
+            a ^= read64(key + 8 * i);
+            acc[i] = a * prime32_1;
+        }
+    }
+
+#ifdef XXH3_X86
+    // The vector loops do the same per 64-bit lane: the data is added to
+    // the neighbouring lane, the product of the two halves of data ^ key
+    // to its own lane
+
+    CPU_TARGET("sse2")
+    void accumulateSse2(std::uint64_t* acc, const unsigned char* input,
+                        const unsigned char* key, std::size_t stripes)
+    {
+        __m128i* out = reinterpret_cast<__m128i*>(acc);
+        __m128i a[4];
+        for (int i = 0; i < 4; ++i)
+            a[i] = _mm_loadu_si128(out + i);
+
+        for (std::size_t s = 0; s < stripes; ++s, input += stripeLength, key += 8)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + i);
+                __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+                __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+                a[i] = _mm_add_epi64(a[i], _mm_add_epi64(product, swapped));
+            }
+        }
+
+        for (int i = 0; i < 4; ++i)
+            _mm_storeu_si128(out + i, a[i]);
+    }
+
+    CPU_TARGET("sse2")
+    void scrambleSse2(std::uint64_t* acc, const unsigned char* key)
+    {
+        __m128i* out = reinterpret_cast<__m128i*>(acc);
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(prime32_1));
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i a = _mm_loadu_si128(out + i);
+            a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+            a = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(key) + i));
+            __m128i productLow = _mm_mul_epu32(a, prime);
+            __m128i productHigh = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            _mm_storeu_si128(out + i, _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32)));
+        }
+    }
+
+    CPU_TARGET("avx2")
+    void accumulateAvx2(std::uint64_t* acc, const unsigned char* input,
+                        const unsigned char* key, std::size_t stripes)
+    {
+        __m256i* out = reinterpret_cast<__m256i*>(acc);
+        __m256i a0 = _mm256_loadu_si256(out);
+        __m256i a1 = _mm256_loadu_si256(out + 1);
+
+        for (std::size_t s = 0; s < stripes; ++s, input += stripeLength, key += 8)
+        {
+            const __m256i* in = reinterpret_cast<const __m256i*>(input);
+            const __m256i* k = reinterpret_cast<const __m256i*>(key);
+
+            __m256i data0 = _mm256_loadu_si256(in);
+            __m256i data1 = _mm256_loadu_si256(in + 1);
+            __m256i keyed0 = _mm256_xor_si256(data0, _mm256_loadu_si256(k));
+            __m256i keyed1 = _mm256_xor_si256(data1, _mm256_loadu_si256(k + 1));
+            __m256i product0 = _mm256_mul_epu32(keyed0, _mm256_shuffle_epi32(keyed0, _MM_SHUFFLE(0, 3, 0, 1)));
+            __m256i product1 = _mm256_mul_epu32(keyed1, _mm256_shuffle_epi32(keyed1, _MM_SHUFFLE(0, 3, 0, 1)));
+            a0 = _mm256_add_epi64(a0, _mm256_add_epi64(product0,
+                                  _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2))));
+            a1 = _mm256_add_epi64(a1, _mm256_add_epi64(product1,
+                                  _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+
+        _mm256_storeu_si256(out, a0);
+        _mm256_storeu_si256(out + 1, a1);
+    }
+
+    CPU_TARGET("avx2")
+    void scrambleAvx2(std::uint64_t* acc, const unsigned char* key)
+    {
+        __m256i* out = reinterpret_cast<__m256i*>(acc);
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(prime32_1));
+        for (int i = 0; i < 2; ++i)
+        {
+            __m256i a = _mm256_loadu_si256(out + i);
+            a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+            a = _mm256_xor_si256(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key) + i));
+            __m256i productLow = _mm256_mul_epu32(a, prime);
+            __m256i productHigh = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+            _mm256_storeu_si256(out + i, _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32)));
+        }
+    }
+#endif // XXH3_X86
+
+    struct Kernels
+    {
+        const char* name;
+        void (*accumulate)(std::uint64_t* acc, const unsigned char* input,
+                           const unsigned char* key, std::size_t stripes);
+        void (*scramble)(std::uint64_t* acc, const unsigned char* key);
+    };
+
+    std::vector<Kernels> variants()
+    {
+        std::vector<Kernels> v;
+        Kernels plain = { "scalar", &accumulateScalar, &scrambleScalar };
+        v.push_back(plain);
+#ifdef XXH3_X86
+        if (CpuFeatures::get().sse2)
+        {
+            Kernels k = { "sse2", &accumulateSse2, &scrambleSse2 };
+            v.push_back(k);
+        }
+        if (CpuFeatures::get().avx2)
+        {
+            Kernels k = { "avx2", &accumulateAvx2, &scrambleAvx2 };
+            v.push_back(k);
+        }
+#endif
+        return v;
+    }
+
+    // Found when the module is loaded, the last one is the fastest
+    const std::vector<Kernels> available = variants();
+
+    // Accumulate stripes that continue a block of which stripesSoFar
+    // stripes are done, scrambling at every block end
+    const unsigned char* consumeStripes(const Kernels& kernels, std::uint64_t* acc,
+                                        std::size_t& stripesSoFar,
+                                        const unsigned char* input, std::size_t stripes)
+    {
+        const unsigned char* key = secret + stripesSoFar * 8;
+        if (stripes >= stripesPerBlock - stripesSoFar)
+        {
+            std::size_t thisBlock = stripesPerBlock - stripesSoFar;
+            do
+            {
+                kernels.accumulate(acc, input, key, thisBlock);
+                kernels.scramble(acc, secret + secretLimit);
+                input += thisBlock * stripeLength;
+                stripes -= thisBlock;
+                thisBlock = stripesPerBlock;
+                key = secret;
+            } while (stripes >= stripesPerBlock);
+            stripesSoFar = 0;
+        }
+        if (stripes)
+        {
+            kernels.accumulate(acc, input, key, stripes);
+            input += stripes * stripeLength;
+            stripesSoFar += stripes;
+        }
+        return input;
+    }
+
+    std::uint64_t mergeAccs(const std::uint64_t* acc, const unsigned char* key, std::uint64_t start)
+    {
+        std::uint64_t result = start;
+        for (int i = 0; i < 4; ++i)
+            result += fold(acc[2 * i] ^ read64(key + 16 * i), acc[2 * i + 1] ^ read64(key + 16 * i + 8));
+        return avalanche(result);
+    }
+}
+
+Xxh3::Xxh3(bool wide) : wide_(wide), variant_(available.size() - 1)
+{
+    reset();
+}
+
+Xxh3::Xxh3(bool wide, std::size_t variant) : wide_(wide),
+    variant_(variant < available.size() ? variant : available.size() - 1)
+{
+    reset();
+}
+
+void Xxh3::reset()
+{
+    acc_[0] = prime32_3;
+    acc_[1] = prime64_1;
+    acc_[2] = prime64_2;
+    acc_[3] = prime64_3;
+    acc_[4] = prime64_4;
+    acc_[5] = prime32_2;
+    acc_[6] = prime64_5;
+    acc_[7] = prime32_1;
+    bufferedSize_ = 0;
+    stripesSoFar_ = 0;
+    totalLength_ = 0;
+}
+
+void Xxh3::update(const char* data, std::size_t length)
+{
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = input + length;
+    totalLength_ += length;
+
+    if (length <= bufferSize - bufferedSize_)
+    {
+        std::memcpy(buffer_ + bufferedSize_, input, length);
+        bufferedSize_ += length;
+        return;
+    }
+
+    // The buffer is only consumed when more data follows, so that the
+    // last stripe of the input is always at hand for the digest
+    if (bufferedSize_)
+    {
+        std::size_t load = bufferSize - bufferedSize_;
+        std::memcpy(buffer_ + bufferedSize_, input, load);
+        input += load;
+        consumeStripes(available[variant_], acc_, stripesSoFar_, buffer_,
+                       bufferSize / stripeLength);
+        bufferedSize_ = 0;
+    }
+    if (static_cast<std::size_t>(end - input) > bufferSize)
+    {
+        std::size_t stripes = static_cast<std::size_t>(end - 1 - input) / stripeLength;
+        input = consumeStripes(available[variant_], acc_, stripesSoFar_, input, stripes);
+        // Kept in case the input ends with less than a stripe
+        std::memcpy(buffer_ + bufferSize - stripeLength, input - stripeLength, stripeLength);
+    }
+    std::memcpy(buffer_, input, static_cast<std::size_t>(end - input));
+    bufferedSize_ = static_cast<std::size_t>(end - input);
+}
+
+void Xxh3::digest(std::uint64_t& low, std::uint64_t& high) const
+{
+    if (totalLength_ <= midSizeMax)
+    {
+        if (wide_)
+            short128(buffer_, static_cast<std::size_t>(totalLength_), low, high);
+        else
+            low = short64(buffer_, static_cast<std::size_t>(totalLength_));
+        return;
+    }
+
+    const Kernels& kernels = available[variant_];
+    std::uint64_t acc[8];
+    std::memcpy(acc, acc_, sizeof(acc));
+
+    unsigned char lastStripe[stripeLength];
+    const unsigned char* last;
+    if (bufferedSize_ >= stripeLength)
+    {
+        std::size_t stripesSoFar = stripesSoFar_;
+        consumeStripes(kernels, acc, stripesSoFar, buffer_, (bufferedSize_ - 1) / stripeLength);
+        last = buffer_ + bufferedSize_ - stripeLength;
+    }
+    else
+    {
+        std::size_t catchUp = stripeLength - bufferedSize_;
+        std::memcpy(lastStripe, buffer_ + bufferSize - catchUp, catchUp);
+        std::memcpy(lastStripe + catchUp, buffer_, bufferedSize_);
+        last = lastStripe;
+    }
+    kernels.accumulate(acc, last, secret + secretLimit - lastStripeStart, 1);
+
+    low = mergeAccs(acc, secret + mergeStart, totalLength_ * prime64_1);
+    if (wide_)
+        high = mergeAccs(acc, secret + secretSize - sizeof(acc) - mergeStart,
+                         ~(totalLength_ * prime64_2));
+}
+
+void Xxh3::finalize(Digest& digest)
+{
+    std::uint64_t low = 0, high = 0;
+    this->digest(low, high);
+
+    // Printed big endian, the high half first, as xxhsum does
+    unsigned char* out = digest.bytes;
+    if (wide_)
+    {
+        for (int i = 0; i < 8; ++i)
+            *out++ = static_cast<unsigned char>(high >> (56 - 8 * i));
+    }
+    for (int i = 0; i < 8; ++i)
+        *out++ = static_cast<unsigned char>(low >> (56 - 8 * i));
+
+    digest.algorithm = wide_ ? HashXxh3_128 : HashXxh3_64;
+    digest.length = wide_ ? 16 : 8;
+}
+
+std::uint64_t Xxh3::hash64(const char* data, std::size_t length)
+{
+    if (length <= midSizeMax)
+        return short64(reinterpret_cast<const unsigned char*>(data), length);
+
+    Xxh3 hasher(false);
+    hasher.update(data, length);
+    std::uint64_t low = 0, high = 0;
+    hasher.digest(low, high);
+    return low;
+}
+
+void Xxh3::hash128(const char* data, std::size_t length,
+                   std::uint64_t& low, std::uint64_t& high)
+{
+    if (length <= midSizeMax)
+    {
+        short128(reinterpret_cast<const unsigned char*>(data), length, low, high);
+        return;
+    }
+
+    Xxh3 hasher(true);
+    hasher.update(data, length);
+    hasher.digest(low, high);
+}
+
+const char* Xxh3::selectedName()
+{
+    return available.back().name;
+}
+
+std::vector<const char*> Xxh3::supported()
+{
+    std::vector<const char*> names;
+    for (const Kernels& kernels : available)
+        names.push_back(kernels.name);
+    return names;
+}
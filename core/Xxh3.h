@@ -0,0 +1,63 @@
+/****************************** Module Header ******************************\
+Module Name:  Xxh3.h
+Project:      CppShellExtContextMenuHandler
+
+XXH3, the 64 and 128 bit hashes of xxHash 0.8, with seed 0 and the default
+secret - the values match XXH3_64bits() and XXH3_128bits() of the
+reference library and of the xxhsum tool.
+
+Inputs up to 240 bytes are hashed at once when the digest is taken. Longer
+inputs run through eight 64-bit accumulators, a 64-byte stripe at a time;
+that loop has SSE2 and AVX2 variants, picked once when the module is
+loaded.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef XXH3_H
+#define XXH3_H
+
+#include "Hasher.h"
+
+#include <vector>
+
+class Xxh3 : public Hasher
+{
+public:
+    //! Haponov - the 128 bit variant when wide is true
+    explicit Xxh3(bool wide);
+    //! Haponov - the same with the accumulate loop supported()[variant]
+    Xxh3(bool wide, std::size_t variant);
+
+    void update(const char* data, std::size_t length);
+    void finalize(Digest& digest);
+    void reset();
+
+    //! Haponov - one-shot hashes
+    static std::uint64_t hash64(const char* data, std::size_t length);
+    static void hash128(const char* data, std::size_t length,
+                        std::uint64_t& low, std::uint64_t& high);
+
+    //! Haponov - name of the selected accumulate loop
+    static const char* selectedName();
+
+    //! Haponov - every accumulate loop this CPU can run, the plain one
+    //            first; the last is the selected one
+    static std::vector<const char*> supported();
+
+    static const std::size_t bufferSize = 256;
+
+private:
+    void digest(std::uint64_t& low, std::uint64_t& high) const;
+
+    bool wide_;
+    std::size_t variant_;
+    std::uint64_t acc_[8];
+    unsigned char buffer_[bufferSize];
+    std::size_t bufferedSize_;
+    std::size_t stripesSoFar_;
+    std::uint64_t totalLength_;
+};
+
+#endif // XXH3_H
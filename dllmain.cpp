@@ -23,6 +23,9 @@ DllUnregisterServer unregisters the COM server and the context menu handler.
 #include <Guiddef.h>
 #include "ClassFactory.h"           // For the class factory
 #include "Reg.h"
+#include "ThreadPool.h"
+#include "HashCache.h"
+#include "IoScheduler.h"
 
 
 // {BFD98515-CD74-48A4-98E2-13D209E3EE4F}
@@ -94,11 +97,26 @@ STDAPI DllGetClassObject(REFCLSID rclsid, REFIID riid, void **ppv)
 //   PURPOSE: Check if we can unload the component from the memory.
 //
 //   NOTE: The component can be unloaded from the memory when its reference 
-//   count is zero (i.e. nobody is still using the component).
+//   count is zero (i.e. nobody is still using the component) and the shared 
+//   ThreadPool has no threads left that run code of this module. The shared 
+//   checksum cache and I/O scheduler are released then, they are created 
+//   again on the next use.
 // 
 STDAPI DllCanUnloadNow(void)
 {
-    return g_cDllRef > 0 ? S_FALSE : S_OK;
+    if (g_cDllRef > 0)
+    {
+        return S_FALSE;
+    }
+
+    if (!ThreadPool::releaseShared())
+    {
+        return S_FALSE;
+    }
+
+    HashCache::releaseShared();
+    IoScheduler::releaseShared();
+    return S_OK;
 }
 
 
@@ -130,6 +148,13 @@ STDAPI DllRegisterServer(void)
             CLSID_FileContextMenuExt, 
             L"CppShellExtContextMenuHandler.FileContextMenuExt");
     }
+    if (SUCCEEDED(hr))
+    {
+        // And with folders, whose trees are walked.
+        hr = RegisterShellExtContextMenuHandler(L"Directory", 
+            CLSID_FileContextMenuExt, 
+            L"CppShellExtContextMenuHandler.FileContextMenuExt");
+    }
 
     return hr;
 }
@@ -159,6 +184,11 @@ STDAPI DllUnregisterServer(void)
         hr = UnregisterShellExtContextMenuHandler(L"*", 
             CLSID_FileContextMenuExt);
     }
+    if (SUCCEEDED(hr))
+    {
+        hr = UnregisterShellExtContextMenuHandler(L"Directory", 
+            CLSID_FileContextMenuExt);
+    }
 
     return hr;
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+
+#include "Check.h"
+#include "BatchChecker.h"
+#include "MonotonicArena.h"
+#include "ResultChannel.h"
+#include "ResultExport.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    //! Haponov: the status column of every CSV line after the header
+    std::vector<std::string> csvStatuses(const std::string& csv)
+    {
+        std::vector<std::string> statuses;
+        std::size_t line = csv.find('\n');
+        while (line != std::string::npos && line + 1 < csv.size())
+        {
+            std::size_t end = csv.find('\n', line + 1);
+            std::string text = csv.substr(line + 1, end - line - 1);
+            //! path,name,type,status - the paths of the test have no comma
+            std::size_t field = 0;
+            for (int comma = 0; comma < 3 && field != std::string::npos; ++comma)
+                field = text.find(',', field) + 1;
+            statuses.push_back(text.substr(field, text.find(',', field) - field));
+            line = end;
+        }
+        return statuses;
+    }
+}
+
+AVID_TEST(batch, checksumStoppedByTheBatchIsExportedAsStopped)
+{
+    //! Haponov: a file large enough that its checksum is still being read
+    //! when the batch is cancelled - holes read fast, but not that fast
+    PathString path = Check::tempPath("stopped");
+    std::vector<char> data(4096, 'x');
+    CHECK(Check::writeSparse(path, 4ull << 30, std::vector<std::uint64_t>(1, 0), data));
+
+    FileRecord record = FileRecord::waiting(path.c_str());
+    ResultChannel results;
+    ThreadPool pool(2);
+    MonotonicArena memory;
+    JobGroup batch;
+    BatchChecker checker(pool, memory, results, batch, NULL);
+    checker.reset(&record, 1, HashAlaSum);
+    checker.schedule();
+
+    //! Haponov: cancel as soon as the file is open and being read
+    FileRecord copy;
+    while (results.record(0, copy) == FileRecord::Waiting)
+        std::this_thread::yield();
+    batch.cancel();
+
+    PathString exported = Check::tempPath("stopped.csv");
+    {
+        File out;
+        CHECK(out.createForAppend(exported));
+        ResultExport writer(out, ExportCsv, HashAlaSum);
+        CHECK(writer.begin());
+        checker.collect([&writer](const FileRecord& finished)
+        {
+            CHECK(writer.write(finished));
+        });
+        CHECK(writer.end());
+    }
+    batch.wait();
+
+    CHECK(results.record(0, copy) == FileRecord::Described);
+    CHECK_EQUAL(0u, results.progress().finished);
+    std::vector<std::string> statuses = csvStatuses(Check::readFile(exported));
+    CHECK_EQUAL(1u, statuses.size());
+    CHECK(!statuses.empty() && statuses[0] == "\"stopped\"");
+
+    Check::removeFile(exported);
+    Check::removeFile(path);
+}
+
+AVID_TEST(batch, unreadableFileIsNotStopped)
+{
+    //! Haponov: a file that cannot be opened fails, cancelled or not
+    PathString path = Check::tempPath("missing");
+    FileRecord record = FileRecord::waiting(path.c_str());
+    ResultChannel results;
+    ThreadPool pool(1);
+    MonotonicArena memory;
+    JobGroup batch;
+    BatchChecker checker(pool, memory, results, batch, NULL);
+    checker.reset(&record, 1, HashAlaSum);
+    checker.schedule();
+    std::vector<FileRecord::Stage> stages;
+    checker.collect([&stages](const FileRecord& finished)
+    {
+        stages.push_back(static_cast<FileRecord::Stage>(finished.stage));
+    });
+    batch.wait();
+    CHECK_EQUAL(1u, stages.size());
+    CHECK(!stages.empty() && stages[0] == FileRecord::Failed);
+}
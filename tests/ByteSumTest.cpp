@@ -0,0 +1,88 @@
+
+#include "Check.h"
+#include "ByteSum.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+    std::uint64_t nextRandom(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //! Haponov: every kernel against the plain loop, for lengths around
+    //! the widths of the vectors and their unrolled loops, from every start
+    //! within a 64-byte line
+    void checkKernels(const std::vector<char>& buffer)
+    {
+        const std::size_t lengths[] = { 0, 1, 2, 7, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+                                        127, 128, 129, 255, 256, 257, 511, 1000, 4096, 65537 };
+        for (const ByteSum::Variant& variant : ByteSum::supported())
+        {
+            for (std::size_t start = 0; start < 64; ++start)
+            {
+                for (std::size_t length : lengths)
+                {
+                    if (start + length > buffer.size())
+                        continue;
+                    const char* data = buffer.data() + start;
+                    std::int64_t expected = ByteSum::scalar(data, length);
+                    std::int64_t actual = variant.kernel(data, length);
+                    if (expected != actual)
+                    {
+                        Check::fail(__FILE__, __LINE__, std::string(variant.name) + " at " +
+                                    std::to_string(start) + " of " + std::to_string(length) +
+                                    " bytes: " + std::to_string(actual) + ", not " +
+                                    std::to_string(expected));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+AVID_TEST(bytesum, kernelsMatchTheScalarSumOnRandomBytes)
+{
+    std::vector<char> buffer(65537 + 64);
+    for (std::uint64_t seed = 1; seed <= 4; ++seed)
+    {
+        std::uint64_t state = seed;
+        for (char& c : buffer)
+            c = static_cast<char>(nextRandom(state));
+        checkKernels(buffer);
+    }
+}
+
+AVID_TEST(bytesum, kernelsMatchTheScalarSumOnHighBytes)
+{
+    // 0x80 and 0xFF are the negative extremes the sign flip turns around,
+    // 0x7F the positive one
+    const unsigned char fills[] = { 0x80, 0xFF, 0x7F, 0x00 };
+    std::vector<char> buffer(65537 + 64);
+    for (unsigned char fill : fills)
+    {
+        buffer.assign(buffer.size(), static_cast<char>(fill));
+        checkKernels(buffer);
+    }
+}
+
+AVID_TEST(bytesum, selectedKernelIsSupported)
+{
+    bool found = false;
+    for (const ByteSum::Variant& variant : ByteSum::supported())
+        found = found || std::string(variant.name) == ByteSum::selectedName();
+    CHECK(found);
+    CHECK(std::string(ByteSum::supported()[0].name) == "scalar");
+
+    // 16 MB of 0x80 is -128 a byte
+    std::vector<char> buffer(16 << 20, static_cast<char>(0x80));
+    CHECK_EQUAL(-128ll * static_cast<long long>(buffer.size()),
+                static_cast<long long>(ByteSum::sum(buffer.data(), buffer.size())));
+}
@@ -0,0 +1,75 @@
+/****************************** Module Header ******************************\
+Module Name:  Check.h
+Project:      CppShellExtContextMenuHandler
+
+The few things the tests of the core need: a test is a function registered
+under a suite with AVID_TEST(suite, name), CHECK and CHECK_EQUAL record a
+failure with its file and line and let the test go on. avidtests runs the
+suites named on its command line, or all of them, and exits with 1 when a
+check failed; CMake adds one ctest test per suite.
+
+\***************************************************************************/
+
+#pragma once
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "File.h"
+
+class Check
+{
+public:
+    typedef void (*Test)();
+
+    //! Haponov - registers test, see AVID_TEST
+    Check(const char* suite, const char* name, Test test);
+
+    //! Haponov - record a failed check; false, so it can end an expression
+    static bool fail(const char* file, int line, const std::string& what);
+
+    //! Haponov - a path for a file of the test under the temporary folder,
+    //            unique to this process
+    static PathString tempPath(const char* name);
+
+    //! Haponov - make a sparse file of size bytes with data written at
+    //            each of offsets and holes elsewhere; false if it cannot be
+    //            made
+    static bool writeSparse(const PathString& path, std::uint64_t size,
+                            const std::vector<std::uint64_t>& offsets,
+                            const std::vector<char>& data);
+
+    //! Haponov - the whole content of a file, empty if it cannot be read
+    static std::string readFile(const PathString& path);
+
+    //! Haponov - remove a file made by a test
+    static void removeFile(const PathString& path);
+
+    //! Haponov - run the tests of the suites, all for none; the number of
+    //            failed checks
+    static unsigned run(int suiteCount, const char* const* suites);
+};
+
+#define AVID_TEST_JOIN2(a, b) a##b
+#define AVID_TEST_JOIN(a, b) AVID_TEST_JOIN2(a, b)
+
+//! Haponov - define and register the test name of suite
+#define AVID_TEST(suite, name)                                             \
+    static void AVID_TEST_JOIN(test_, name)();                             \
+    static const Check AVID_TEST_JOIN(check_, name)(#suite, #name,         \
+                                                    &AVID_TEST_JOIN(test_, name)); \
+    static void AVID_TEST_JOIN(test_, name)()
+
+#define CHECK(condition)                                                   \
+    ((condition) || Check::fail(__FILE__, __LINE__, #condition))
+
+#define CHECK_EQUAL(expected, actual)                                      \
+    ((expected) == (actual) ||                                             \
+     Check::fail(__FILE__, __LINE__, #actual " is " + std::to_string(actual) + \
+                 ", not " + std::to_string(expected)))
+
+#endif // CHECK_H
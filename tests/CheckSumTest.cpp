@@ -0,0 +1,107 @@
+
+#include "Check.h"
+#include "ByteSum.h"
+#include "CheckSum.h"
+#include "File.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+    std::uint64_t nextRandom(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //! Haponov: sizes on both sides of the parallel threshold and of the
+    //! edges of the ranges the pool threads take
+    std::vector<std::uint64_t> edgeSizes()
+    {
+        const std::uint64_t threshold = CheckSum::parallelThreshold;
+        const std::uint64_t range = CheckSum::rangeSize;
+        const std::uint64_t edges[] = { threshold, threshold + range, 9 * range };
+        std::vector<std::uint64_t> sizes;
+        for (std::uint64_t edge : edges)
+        {
+            sizes.push_back(edge - 1);
+            sizes.push_back(edge);
+            sizes.push_back(edge + 1);
+        }
+        sizes.push_back(CheckSum::blockReadLimit);
+        sizes.push_back(CheckSum::blockReadLimit + 1);
+        sizes.push_back(1);
+        return sizes;
+    }
+}
+
+AVID_TEST(checksum, parallelSumMatchesTheSequentialOne)
+{
+    //! Haponov: one file of random bytes, the sizes are prefixes of it
+    std::vector<std::uint64_t> sizes = edgeSizes();
+    std::uint64_t largest = 0;
+    for (std::uint64_t size : sizes)
+        largest = size > largest ? size : largest;
+    std::vector<char> content(static_cast<std::size_t>(largest));
+    std::uint64_t state = 4;
+    for (char& c : content)
+        c = static_cast<char>(nextRandom(state));
+
+    PathString path = Check::tempPath("checksum");
+    {
+        File out;
+        CHECK(out.createForAppend(path) && out.append(content.data(), content.size()));
+    }
+
+    File file(path);
+    CHECK(file.isOpen());
+    // more threads than ranges of the smaller sizes, on any machine
+    ThreadPool pool(4);
+    for (std::uint64_t size : sizes)
+    {
+        std::int64_t expected = ByteSum::scalar(content.data(), static_cast<std::size_t>(size));
+
+        std::int64_t parallel = 0;
+        std::int64_t sequential = 0;
+        CHECK(CheckSum::parallel(file, size, pool, parallel));
+        CHECK(CheckSum::sumRange(file, 0, size, sequential));
+        CHECK_EQUAL(expected, parallel);
+        CHECK_EQUAL(expected, sequential);
+
+        // the path ofFile picks by size, with and without a pool, in both
+        // modes - the legacy one counts the last byte twice
+        std::int64_t withPool = 0;
+        std::int64_t withoutPool = 0;
+        CHECK(CheckSum::ofFile(file, size, &pool, withPool, CheckSum::Exact));
+        CHECK(CheckSum::ofFile(file, size, NULL, withoutPool, CheckSum::Exact));
+        CHECK_EQUAL(expected, withPool);
+        CHECK_EQUAL(expected, withoutPool);
+
+        std::int64_t legacy = 0;
+        CHECK(CheckSum::ofFile(file, size, &pool, legacy, CheckSum::LegacyEndOfFile));
+        CHECK_EQUAL(expected + static_cast<signed char>(content[static_cast<std::size_t>(size - 1)]), legacy);
+    }
+
+    file.close();
+    Check::removeFile(path);
+}
+
+AVID_TEST(checksum, emptyFileSumsToZero)
+{
+    PathString path = Check::tempPath("empty");
+    {
+        File out;
+        CHECK(out.createForAppend(path));
+    }
+    File file(path);
+    ThreadPool pool(2);
+    std::int64_t sum = 1;
+    CHECK(CheckSum::ofFile(file, 0, &pool, sum));
+    CHECK_EQUAL(0, sum);
+    file.close();
+    Check::removeFile(path);
+}
@@ -0,0 +1,166 @@
+
+#include "Check.h"
+#include "DropFileList.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //! Haponov: a DROPFILES header with the list at pFiles and fWide set
+    //! or not, followed by the bytes of the list as given
+    std::vector<unsigned char> block(std::uint32_t files, bool wide, const std::vector<unsigned char>& list)
+    {
+        std::vector<unsigned char> bytes(files > DropFileList::headerSize ? files : DropFileList::headerSize, 0);
+        std::memcpy(&bytes[0], &files, sizeof(files));
+        bytes[16] = wide ? 1 : 0;
+        for (unsigned char c : list)
+            bytes.push_back(c);
+        return bytes;
+    }
+
+    //! Haponov: names as UTF-16LE, each with its NUL, and the empty name
+    //! at the end when terminated
+    std::vector<unsigned char> wideList(const std::vector<std::string>& names, bool terminated)
+    {
+        std::vector<unsigned char> list;
+        for (const std::string& name : names)
+        {
+            for (char c : name)
+            {
+                list.push_back(static_cast<unsigned char>(c));
+                list.push_back(0);
+            }
+            list.push_back(0);
+            list.push_back(0);
+        }
+        if (terminated)
+        {
+            list.push_back(0);
+            list.push_back(0);
+        }
+        return list;
+    }
+
+    std::vector<unsigned char> ansiList(const std::vector<std::string>& names, bool terminated)
+    {
+        std::vector<unsigned char> list;
+        for (const std::string& name : names)
+        {
+            list.insert(list.end(), name.begin(), name.end());
+            list.push_back(0);
+        }
+        if (terminated)
+            list.push_back(0);
+        return list;
+    }
+
+    //! Haponov: the paths the parser hands out, as ASCII
+    std::vector<std::string> paths(const std::vector<unsigned char>& bytes, std::size_t size)
+    {
+        std::vector<std::string> found;
+        DropFileList list;
+        DropPath path;
+        if (!list.parse(bytes.data(), size))
+            return found;
+        while (list.next(path))
+        {
+            const unsigned char* text = static_cast<const unsigned char*>(path.text);
+            std::string name;
+            for (std::size_t i = 0; i < path.length; ++i)
+                name += static_cast<char>(list.wide() ? text[2 * i] : text[i]);
+            found.push_back(name);
+        }
+        return found;
+    }
+
+    bool parses(const std::vector<unsigned char>& bytes, std::size_t size)
+    {
+        DropFileList list;
+        return list.parse(bytes.data(), size);
+    }
+}
+
+AVID_TEST(dropfiles, readsWideAndAnsiLists)
+{
+    std::vector<std::string> names = { "C:\\a.txt", "C:\\folder\\b", std::string(300, 'x') };
+    std::vector<unsigned char> wide = block(DropFileList::headerSize, true, wideList(names, true));
+    CHECK(paths(wide, wide.size()) == names);
+    std::vector<unsigned char> ansi = block(DropFileList::headerSize, false, ansiList(names, true));
+    CHECK(paths(ansi, ansi.size()) == names);
+
+    DropFileList list;
+    CHECK(list.parse(wide.data(), wide.size()) && list.wide());
+    CHECK(list.parse(ansi.data(), ansi.size()) && !list.wide());
+}
+
+AVID_TEST(dropfiles, listEndsWithTheBlock)
+{
+    // the last name has no NUL: it ends with the block
+    std::vector<std::string> names = { "C:\\a", "C:\\last" };
+    std::vector<unsigned char> wide = block(DropFileList::headerSize, true, wideList(names, false));
+    CHECK(paths(wide, wide.size() - 2) == names);
+    std::vector<unsigned char> ansi = block(DropFileList::headerSize, false, ansiList(names, false));
+    CHECK(paths(ansi, ansi.size() - 1) == names);
+
+    // an odd byte at the end of a wide list is not a character
+    std::vector<unsigned char> odd = block(DropFileList::headerSize, true, wideList(names, false));
+    odd.resize(odd.size() - 2);
+    odd.push_back('z');
+    CHECK(paths(odd, odd.size()) == names);
+}
+
+AVID_TEST(dropfiles, emptyListHasNoPaths)
+{
+    std::vector<unsigned char> terminated = block(DropFileList::headerSize, true, wideList({}, true));
+    CHECK(parses(terminated, terminated.size()));
+    CHECK(paths(terminated, terminated.size()).empty());
+    // pFiles at the very end: nothing after the header
+    std::vector<unsigned char> bare = block(DropFileList::headerSize, true, {});
+    CHECK(parses(bare, bare.size()));
+    CHECK(paths(bare, bare.size()).empty());
+    // a leading empty name ends the list before the next one
+    std::vector<unsigned char> leading = block(DropFileList::headerSize, false, ansiList({ "", "C:\\a" }, true));
+    CHECK(paths(leading, leading.size()).empty());
+}
+
+AVID_TEST(dropfiles, rejectsBrokenHeaders)
+{
+    std::vector<unsigned char> list = wideList({ "C:\\a" }, true);
+    std::vector<unsigned char> good = block(DropFileList::headerSize, true, list);
+    CHECK(!parses(good, DropFileList::headerSize - 1));
+    DropFileList parser;
+    CHECK(!parser.parse(NULL, 100));
+
+    // pFiles inside the header, and past the end of the block
+    std::vector<unsigned char> inside = good;
+    inside[0] = DropFileList::headerSize - 1;
+    CHECK(!parses(inside, inside.size()));
+    std::vector<unsigned char> beyond = good;
+    std::uint32_t past = static_cast<std::uint32_t>(good.size() + 1);
+    std::memcpy(&beyond[0], &past, sizeof(past));
+    CHECK(!parses(beyond, beyond.size()));
+    CHECK(paths(beyond, beyond.size()).empty());
+}
+
+AVID_TEST(dropfiles, readsListsAtOddOffsets)
+{
+    // an odd pFiles puts every wide path at an odd address; a header read
+    // from an odd address of its own is read the same
+    std::vector<std::string> names = { "C:\\a.txt", "C:\\b" };
+    std::vector<unsigned char> odd = block(DropFileList::headerSize + 1, true, wideList(names, true));
+    CHECK(paths(odd, odd.size()) == names);
+
+    DropFileList list;
+    DropPath path;
+    CHECK(list.parse(odd.data(), odd.size()) && list.next(path));
+    CHECK(static_cast<const unsigned char*>(path.text) == odd.data() + DropFileList::headerSize + 1);
+
+    std::vector<unsigned char> shifted(1, 0);
+    std::vector<unsigned char> wide = block(DropFileList::headerSize, true, wideList(names, true));
+    shifted.insert(shifted.end(), wide.begin(), wide.end());
+    DropFileList unaligned;
+    CHECK(unaligned.parse(shifted.data() + 1, wide.size()) && unaligned.wide());
+    CHECK(unaligned.next(path) && path.length == names[0].size());
+}
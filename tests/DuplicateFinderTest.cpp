@@ -0,0 +1,172 @@
+
+#include "Check.h"
+#include "DuplicateFinder.h"
+#include "File.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //! Haponov: bytes that tell every 4 KB page of a file apart, different
+    //! for each seed
+    std::vector<char> pattern(std::size_t size, unsigned seed)
+    {
+        std::vector<char> content(size);
+        for (std::size_t i = 0; i < size; ++i)
+            content[i] = static_cast<char>((i >> 12) * 31 + i + seed * 7);
+        return content;
+    }
+
+    //! Haponov: the files of one test, removed when it ends
+    class Files
+    {
+    public:
+        explicit Files(const char* name) : name_(name)
+        {
+        }
+
+        ~Files()
+        {
+            for (const PathString& path : paths_)
+                Check::removeFile(path);
+        }
+
+        //! Haponov: a file with content, listed with its size
+        void add(const std::vector<char>& content)
+        {
+            add(content, content.size());
+        }
+
+        //! Haponov: the same, listed with the size it had when it was scanned
+        void add(const std::vector<char>& content, std::uint64_t listedSize)
+        {
+            std::string name = name_ + "-" + std::to_string(paths_.size());
+            paths_.push_back(Check::tempPath(name.c_str()));
+            File out;
+            CHECK(out.createForAppend(paths_.back()) &&
+                  (content.empty() || out.append(content.data(), content.size())));
+            sizes_.push_back(listedSize);
+        }
+
+        std::vector<DuplicateFile> list() const
+        {
+            std::vector<DuplicateFile> files;
+            for (std::size_t i = 0; i < paths_.size(); ++i)
+            {
+                DuplicateFile file = { paths_[i].c_str(), sizes_[i], true };
+                files.push_back(file);
+            }
+            return files;
+        }
+
+    private:
+        std::string name_;
+        std::vector<PathString> paths_;
+        std::vector<std::uint64_t> sizes_;
+    };
+
+    std::string groupsText(const std::vector<std::vector<std::size_t>>& groups)
+    {
+        std::string text;
+        for (const std::vector<std::size_t>& group : groups)
+        {
+            text += "(";
+            for (std::size_t i = 0; i < group.size(); ++i)
+                text += (i ? " " : "") + std::to_string(group[i]);
+            text += ")";
+        }
+        return text;
+    }
+
+    //! Haponov: the groups find gives, as "(0 2)(1 3)"; groups of files
+    //! of one size come in the order of their hashes, so they are sorted
+    std::string findGroups(DuplicateFinder& finder, const Files& files)
+    {
+        std::vector<std::vector<std::size_t>> groups;
+        CHECK(finder.find(files.list(), groups));
+        std::sort(groups.begin(), groups.end());
+        return groupsText(groups);
+    }
+}
+
+AVID_TEST(duplicates, emptyFilesGroupTogetherUnread)
+{
+    Files files("duplicates-empty");
+    files.add(std::vector<char>());
+    files.add(pattern(1, 0));
+    files.add(std::vector<char>());
+    files.add(std::vector<char>());
+
+    DuplicateFinder finder(NULL);
+    CHECK(findGroups(finder, files) == "(0 2 3)");
+    CHECK_EQUAL(std::uint64_t(0), finder.counters().edgeHashed);
+    CHECK_EQUAL(std::uint64_t(0), finder.counters().unreadable);
+}
+
+AVID_TEST(duplicates, smallFilesAreComparedWhole)
+{
+    //! Haponov: up to 128 KB the edges are the whole file, so a byte in
+    //! the middle tells two files apart without a content stage
+    const std::size_t sizes[] = { 1, DuplicateFinder::edgeSize - 1, DuplicateFinder::edgeSize + 1,
+                                  2 * DuplicateFinder::edgeSize };
+    for (std::size_t size : sizes)
+    {
+        Files files("duplicates-small");
+        std::vector<char> content = pattern(size, 1);
+        std::vector<char> other = content;
+        other[size / 2] ^= 1;
+        files.add(content);
+        files.add(other);
+        files.add(content);
+
+        DuplicateFinder finder(NULL);
+        CHECK(findGroups(finder, files) == "(0 2)");
+        CHECK_EQUAL(std::uint64_t(3), finder.counters().edgeHashed);
+        CHECK_EQUAL(std::uint64_t(3 * size), finder.counters().edgeBytes);
+        CHECK_EQUAL(std::uint64_t(0), finder.counters().contentHashed);
+    }
+}
+
+AVID_TEST(duplicates, sameEdgesDifferentMiddlesAreToldApart)
+{
+    Files files("duplicates-middle");
+    std::vector<char> content = pattern(1 << 20, 2);
+    std::vector<char> other = content;
+    other[content.size() / 2] ^= 1;
+    files.add(content);
+    files.add(other);
+    files.add(content);
+    files.add(other);
+    files.add(pattern(1 << 20, 3));
+
+    ThreadPool pool(2);
+    DuplicateFinder finder(&pool);
+    CHECK(findGroups(finder, files) == "(0 2)(1 3)");
+    CHECK_EQUAL(std::uint64_t(5), finder.counters().edgeHashed);
+    CHECK_EQUAL(std::uint64_t(4), finder.counters().contentHashed);
+    CHECK_EQUAL(std::uint64_t(4) << 20, finder.counters().contentBytes);
+    CHECK_EQUAL(std::uint64_t(0), finder.counters().unreadable);
+}
+
+AVID_TEST(duplicates, fileWrittenSinceTheScanIsReadAtItsSizeNow)
+{
+    //! Haponov: two copies cut to 200 KB after the scan saw 300 KB, two
+    //! grown from 10 KB, and one left as it was
+    Files files("duplicates-changed");
+    std::vector<char> shrunk = pattern(200 << 10, 4);
+    std::vector<char> grown = pattern(100 << 10, 5);
+    files.add(shrunk, 300 << 10);
+    files.add(grown, 10 << 10);
+    files.add(shrunk, 300 << 10);
+    files.add(pattern(300 << 10, 6));
+    files.add(grown, 10 << 10);
+
+    DuplicateFinder finder(NULL);
+    CHECK(findGroups(finder, files) == "(0 2)(1 4)");
+    CHECK_EQUAL(std::uint64_t(0), finder.counters().unreadable);
+}
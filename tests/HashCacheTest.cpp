@@ -0,0 +1,188 @@
+
+#include "Check.h"
+#include "HashCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //! Haponov: sizes of the header and of a record of the cache file
+    const std::uint64_t headerSize = 16;
+    const std::uint64_t recordSize = 88;
+
+    //! Haponov: a file written long ago, told apart by number
+    FileIdentity identity(std::uint64_t number)
+    {
+        FileIdentity id = { 1, number, 0, 1000 + number, 1000000000ull };
+        return id;
+    }
+
+    Digest digest(std::uint64_t number)
+    {
+        Digest d = {};
+        d.algorithm = HashSha256;
+        d.length = 32;
+        for (std::size_t i = 0; i < d.length; ++i)
+            d.bytes[i] = static_cast<unsigned char>(number * 7 + i);
+        return d;
+    }
+
+    //! Haponov: whether cache has the digest of file number
+    bool has(HashCache& cache, std::uint64_t number)
+    {
+        Digest found;
+        Digest expected = digest(number);
+        return cache.lookup(identity(number), HashSha256, found) &&
+               found.length == expected.length &&
+               std::memcmp(found.bytes, expected.bytes, expected.length) == 0;
+    }
+
+    bool overwrite(const PathString& path, const std::string& content)
+    {
+        return Check::writeSparse(path, content.size(), std::vector<std::uint64_t>(1, 0),
+                                  std::vector<char>(content.begin(), content.end()));
+    }
+}
+
+AVID_TEST(hashcache, reopenedCacheHasWhatWasStored)
+{
+    PathString path = Check::tempPath("cache-reopen");
+    Check::removeFile(path);
+    {
+        HashCache cache(path);
+        cache.store(identity(1), digest(1));
+        cache.store(identity(2), digest(2));
+        CHECK(has(cache, 1));
+        CHECK_EQUAL(std::size_t(2), cache.entries());
+    }
+    CHECK_EQUAL(headerSize + 2 * recordSize, Check::readFile(path).size());
+
+    HashCache cache(path);
+    CHECK(has(cache, 1));
+    CHECK(has(cache, 2));
+    CHECK(!has(cache, 3));
+
+    //! Haponov: a file changed since has another identity
+    FileIdentity changed = identity(1);
+    ++changed.lastWriteTime;
+    Digest found;
+    CHECK(!cache.lookup(changed, HashSha256, found));
+    CHECK(!cache.lookup(identity(1), HashXxh3_64, found));
+    Check::removeFile(path);
+}
+
+AVID_TEST(hashcache, tornLastRecordIsSkipped)
+{
+    PathString path = Check::tempPath("cache-torn");
+    Check::removeFile(path);
+    {
+        HashCache cache(path);
+        cache.store(identity(1), digest(1));
+        cache.store(identity(2), digest(2));
+    }
+
+    //! Haponov: a crash in the middle of the third append
+    std::string content = Check::readFile(path);
+    content += content.substr(headerSize, recordSize / 2);
+    CHECK(overwrite(path, content));
+    {
+        HashCache cache(path);
+        CHECK(has(cache, 1));
+        CHECK(has(cache, 2));
+        CHECK_EQUAL(std::size_t(2), cache.entries());
+
+        //! Haponov: the next record goes after the torn one
+        cache.store(identity(3), digest(3));
+    }
+
+    HashCache cache(path);
+    CHECK(has(cache, 1));
+    CHECK(has(cache, 2));
+    CHECK(has(cache, 3));
+    Check::removeFile(path);
+}
+
+AVID_TEST(hashcache, recordWithABadCrcIsSkipped)
+{
+    PathString path = Check::tempPath("cache-crc");
+    Check::removeFile(path);
+    {
+        HashCache cache(path);
+        cache.store(identity(1), digest(1));
+        cache.store(identity(2), digest(2));
+        cache.store(identity(3), digest(3));
+    }
+
+    //! Haponov: one bit of the digest of the second record
+    std::string content = Check::readFile(path);
+    CHECK_EQUAL(headerSize + 3 * recordSize, content.size());
+    content[static_cast<std::size_t>(headerSize + recordSize + 56)] ^= 1;
+    CHECK(overwrite(path, content));
+
+    HashCache cache(path);
+    CHECK(has(cache, 1));
+    CHECK(!has(cache, 2));
+    CHECK(has(cache, 3));
+    CHECK_EQUAL(std::size_t(2), cache.entries());
+    Check::removeFile(path);
+}
+
+AVID_TEST(hashcache, compactionKeepsTheNewestRecords)
+{
+    //! Haponov: room for 10 records, a compaction keeps half of that
+    PathString path = Check::tempPath("cache-compact");
+    Check::removeFile(path);
+    const std::uint64_t limit = headerSize + 10 * recordSize;
+    {
+        HashCache cache(path, limit);
+        for (std::uint64_t i = 1; i <= 11; ++i)
+            cache.store(identity(i), digest(i));
+        CHECK(Check::readFile(path).size() <= limit);
+        CHECK(has(cache, 11));
+        CHECK(!has(cache, 1));
+        CHECK(cache.compact());
+    }
+
+    std::string content = Check::readFile(path);
+    CHECK(content.size() <= limit / 2);
+    CHECK_EQUAL(std::uint64_t(0), (content.size() - headerSize) % recordSize);
+
+    HashCache cache(path, limit);
+    CHECK(has(cache, 11));
+    std::size_t kept = cache.entries();
+    CHECK_EQUAL((content.size() - headerSize) / recordSize, kept);
+    for (std::uint64_t i = 1; i <= 11; ++i)
+        CHECK_EQUAL(i > 11 - kept, has(cache, i));
+    Check::removeFile(path);
+}
+
+AVID_TEST(hashcache, twoHandlesOnOneFileKeepEachOthersRecords)
+{
+    //! Haponov: two processes sharing the cache file
+    PathString path = Check::tempPath("cache-shared");
+    Check::removeFile(path);
+    {
+        HashCache first(path);
+        HashCache second(path);
+        first.store(identity(1), digest(1));
+        CHECK(has(second, 1));
+
+        //! Haponov: what the second appends is kept by the compaction of
+        //! the first, and the second goes on in the compacted file
+        second.store(identity(2), digest(2));
+        CHECK(first.compact());
+        CHECK(has(first, 2));
+        second.store(identity(3), digest(3));
+        CHECK(has(first, 1));
+        CHECK(has(second, 1));
+    }
+
+    HashCache cache(path);
+    CHECK(has(cache, 1));
+    CHECK(has(cache, 2));
+    CHECK(has(cache, 3));
+    Check::removeFile(path);
+}
@@ -0,0 +1,240 @@
+
+#include "Check.h"
+#include "Crc32c.h"
+#include "Hasher.h"
+#include "Sha256.h"
+#include "Xxh3.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct Vector
+    {
+        std::size_t length;
+        const char* digest;
+    };
+
+    typedef std::unique_ptr<Hasher> (*Factory)(std::size_t variant);
+
+    //! Haponov: the buffer of the sanity tests of xxhsum, whose values the
+    //! XXH3 vectors are
+    std::string sanityBuffer(std::size_t length)
+    {
+        std::string buffer(length, '\0');
+        std::uint64_t byteGen = 2654435761u;
+        for (char& c : buffer)
+        {
+            c = static_cast<char>(byteGen >> 56);
+            byteGen *= 11400714785074694797ull;
+        }
+        return buffer;
+    }
+
+    //! Haponov: the digest of data fed in pieces of chunk bytes, all at
+    //! once for 0
+    std::string digestOf(Hasher& hasher, const std::string& data, std::size_t chunk)
+    {
+        hasher.reset();
+        if (!chunk)
+            hasher.update(data.data(), data.size());
+        for (std::size_t done = 0; chunk && done < data.size(); done += chunk)
+            hasher.update(data.data() + done, data.size() - done < chunk ? data.size() - done : chunk);
+        Digest digest;
+        hasher.finalize(digest);
+        return digest.toString();
+    }
+
+    //! Haponov: every variant against the known digest of data, whole and
+    //! split at the block and stripe edges and off them
+    void checkDigest(const char* algorithm, Factory create,
+                     const std::vector<const char*>& variants,
+                     const std::string& data, const char* expected)
+    {
+        const std::size_t chunks[] = { 0, 1, 7, 16, 63, 64, 65, 240, 256, 1000 };
+        for (std::size_t variant = 0; variant < variants.size(); ++variant)
+        {
+            std::unique_ptr<Hasher> hasher = create(variant);
+            for (std::size_t chunk : chunks)
+            {
+                std::string actual = digestOf(*hasher, data, chunk);
+                if (actual != expected)
+                {
+                    Check::fail(__FILE__, __LINE__, std::string(algorithm) + " " +
+                                variants[variant] + " of " + std::to_string(data.size()) +
+                                " bytes in pieces of " + std::to_string(chunk) + ": " +
+                                actual + ", not " + expected);
+                    return;
+                }
+            }
+        }
+    }
+
+    void checkSanityVectors(const char* algorithm, Factory create,
+                            const std::vector<const char*>& variants,
+                            const Vector* vectors, std::size_t count)
+    {
+        std::string buffer = sanityBuffer(4096);
+        for (std::size_t i = 0; i < count; ++i)
+            checkDigest(algorithm, create, variants, buffer.substr(0, vectors[i].length),
+                        vectors[i].digest);
+    }
+
+    std::unique_ptr<Hasher> crc32c(std::size_t variant)
+    {
+        return std::unique_ptr<Hasher>(new Crc32c(variant));
+    }
+
+    std::unique_ptr<Hasher> xxh3_64(std::size_t variant)
+    {
+        return std::unique_ptr<Hasher>(new Xxh3(false, variant));
+    }
+
+    std::unique_ptr<Hasher> xxh3_128(std::size_t variant)
+    {
+        return std::unique_ptr<Hasher>(new Xxh3(true, variant));
+    }
+
+    std::unique_ptr<Hasher> sha256(std::size_t variant)
+    {
+        return std::unique_ptr<Hasher>(new Sha256(variant));
+    }
+
+    //! Haponov: the variant Hasher::create takes is the fastest one
+    void checkSelected(const std::vector<const char*>& variants, const char* first,
+                       const char* selected)
+    {
+        CHECK(!variants.empty() && std::string(variants[0]) == first);
+        CHECK(!variants.empty() && std::string(variants.back()) == selected);
+    }
+}
+
+AVID_TEST(hasher, crc32cMatchesTheIscsiVectors)
+{
+    //! Haponov: RFC 3720 B.4, and the check value of the CRC catalogue
+    std::vector<const char*> variants = Crc32c::supported();
+    CHECK(std::string(variants[0]) == "software");
+    std::string increasing, decreasing;
+    for (int i = 0; i < 32; ++i)
+    {
+        increasing += static_cast<char>(i);
+        decreasing += static_cast<char>(31 - i);
+    }
+    checkDigest("crc32c", &crc32c, variants, std::string(), "00000000");
+    checkDigest("crc32c", &crc32c, variants, "123456789", "e3069283");
+    checkDigest("crc32c", &crc32c, variants, std::string(32, '\0'), "8a9136aa");
+    checkDigest("crc32c", &crc32c, variants, std::string(32, '\xFF'), "62a8ab43");
+    checkDigest("crc32c", &crc32c, variants, increasing, "46dd794e");
+    checkDigest("crc32c", &crc32c, variants, decreasing, "113fdb5c");
+
+    //! Haponov: around the 8-byte words and the vector widths
+    const Vector vectors[] = {
+        { 1, "527d5351" }, { 7, "a89ba9fa" }, { 8, "2d7e9674" }, { 9, "7bc72cd8" },
+        { 15, "c30977db" }, { 16, "991c1f55" }, { 17, "c650da6f" }, { 63, "b460ed0e" },
+        { 64, "97587c4e" }, { 65, "d31204ce" }, { 127, "ac936fd8" }, { 128, "bfd262a5" },
+        { 129, "2546bc08" }, { 240, "051ae5d9" }, { 241, "2fd8cfd5" }, { 1024, "d6eefce6" },
+        { 4096, "6efe6bb5" }
+    };
+    checkSanityVectors("crc32c", &crc32c, variants, vectors, sizeof(vectors) / sizeof(vectors[0]));
+}
+
+AVID_TEST(hasher, xxh3MatchesTheXxhsumSanityVectors)
+{
+    //! Haponov: the short inputs, the 17-128 and 129-240 byte ones, and
+    //! the long ones around the 1 KB blocks of 16 stripes
+    std::vector<const char*> variants = Xxh3::supported();
+    checkSelected(variants, "scalar", Xxh3::selectedName());
+    const Vector vectors64[] = {
+        { 0, "2d06800538d394c2" }, { 1, "c44bdff4074eecdb" }, { 6, "27b56a84cd2d7325" },
+        { 12, "a713daf0dfbb77e7" }, { 16, "981b17d36c7498c9" }, { 17, "796f5acd3a60f862" },
+        { 24, "a3fe70bf9d3510eb" }, { 48, "397da259ecba1f11" }, { 80, "bcdefbbb2c47c90a" },
+        { 128, "fcff24126754d861" }, { 129, "98f1b0a679a2ca29" }, { 195, "cd94217ee362ec3a" },
+        { 240, "81c3c2b67f568ccf" }, { 241, "c5a639ecd2030e5e" }, { 403, "cdeb804d65c6dea4" },
+        { 512, "617e49599013cb6b" }, { 1024, "dd85c9b5c1109c5c" }, { 1025, "d870c0fa13211c6a" },
+        { 2048, "dd59e2c3a5f038e0" }, { 2240, "6e73a90539cf2948" }, { 2367, "cb37aeb9e5d361ed" },
+        { 4096, "e91206429d1f48f9" }
+    };
+    const Vector vectors128[] = {
+        { 0, "99aa06d3014798d86001c324468d497f" }, { 1, "a6cd5e9392000f6ac44bdff4074eecdb" },
+        { 6, "082afe0b8162d12a3e7039bdda43cfc6" }, { 12, "6e3efd8fc7802b18061a192713f69ad9" },
+        { 16, "c68c368ecf8a9c05562980258a998629" }, { 17, "955fa78643ed3669abbc12d11973d7db" },
+        { 24, "0ce966e4678d37611e7044d28b1b901d" }, { 48, "a002ac4e5478227ef942219aed80f67b" },
+        { 80, "fdf2cefde9eaac8a454ae6bf7a8a532d" }, { 128, "39992220e045260aebb15e34a7fb5ab1" },
+        { 129, "03815fc91f1b30b686c9e3bc8f0a3b5c" }, { 195, "7729543a26b207ee3fb593c086a66075" },
+        { 240, "aa4202daa2769dc85c9aae94c8ebe5a0" }, { 241, "99a80ecf0ecfc647c5a639ecd2030e5e" },
+        { 403, "1b6de21e332dd73dcdeb804d65c6dea4" }, { 512, "18d2d110dcc9bca1617e49599013cb6b" },
+        { 1024, "0d30d24071c64c57dd85c9b5c1109c5c" }, { 1025, "fd3ee4fe7f2954c6d870c0fa13211c6a" },
+        { 2048, "f736557fd47073a5dd59e2c3a5f038e0" }, { 2240, "ccb134fbfa7ce49d6e73a90539cf2948" },
+        { 2367, "e89c0f6ff369b427cb37aeb9e5d361ed" }, { 4096, "b9cfaea2ca5626a4e91206429d1f48f9" }
+    };
+    checkSanityVectors("xxh3-64", &xxh3_64, variants, vectors64,
+                       sizeof(vectors64) / sizeof(vectors64[0]));
+    checkSanityVectors("xxh3-128", &xxh3_128, variants, vectors128,
+                       sizeof(vectors128) / sizeof(vectors128[0]));
+
+    //! Haponov: the one-shot hashes take the same paths
+    std::string buffer = sanityBuffer(4096);
+    CHECK_EQUAL(0xcb37aeb9e5d361edull, Xxh3::hash64(buffer.data(), 2367));
+    std::uint64_t low = 0, high = 0;
+    Xxh3::hash128(buffer.data(), 195, low, high);
+    CHECK_EQUAL(0x3fb593c086a66075ull, low);
+    CHECK_EQUAL(0x7729543a26b207eeull, high);
+}
+
+AVID_TEST(hasher, sha256MatchesTheFipsVectors)
+{
+    //! Haponov: FIPS 180-4 examples; 56 bytes leave no room for the length
+    //! in the last block
+    std::vector<const char*> variants = Sha256::supported();
+    checkSelected(variants, "scalar", Sha256::selectedName());
+    checkDigest("sha256", &sha256, variants, std::string(),
+                "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    checkDigest("sha256", &sha256, variants, "abc",
+                "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    checkDigest("sha256", &sha256, variants,
+                "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    checkDigest("sha256", &sha256, variants,
+                "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+                "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+                "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1");
+    checkDigest("sha256", &sha256, variants, std::string(1000000, 'a'),
+                "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    //! Haponov: around the 64-byte blocks and the padding edge
+    const Vector vectors[] = {
+        { 1, "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d" },
+        { 55, "5b39a58741c0585914865dce2e4d3a36464014c084fbd725976ed33cbb482f0f" },
+        { 56, "0882d13811deba21bbb6c5176d22da6db6672fba8c92db7672870d3e0497631d" },
+        { 63, "1d26aea8a98b18978a7f73ba1da20b383d4c7fe481acac9e08307f57dfc40788" },
+        { 64, "151818c81c5d18649d637e2c3ad20e393d590a9fe65c6c72eb89f62b1738f940" },
+        { 65, "faec206ffcbf1a972b4b7fe39b3bcedaac1223c2327f83ec43d6ca0f070dbfd6" },
+        { 119, "21f9818bc8408e4960cf1b6f3c73c8d8887d5877db3b8a02282e43fa82ca3484" },
+        { 120, "f31a5f89434f61c64f4f36b83a6da106acffaeffc2b9c6046d848556041275b0" },
+        { 127, "2cc2992e91b751ddcd8a06cec764dc7984fe9cad834d5d2000714d582a55b850" },
+        { 128, "7c2a9f499d0c6c46bee9cde41536d6df4e99f43b70c64a1cf19eff3e54e9bf07" },
+        { 240, "ff9f7697ad0ecd666ebf6432a8caf1e7c125aba9d4fc5396db32708176e78ebe" },
+        { 1024, "7d12bccb78609fbc4d9939df9382617cb34ca6e8f89cb4ff374b5bf7c1f137f1" },
+        { 4096, "8bff163859dbd76ff3e982eaf1fc119990c09713387bddf7c231a8258d55734d" }
+    };
+    checkSanityVectors("sha256", &sha256, variants, vectors, sizeof(vectors) / sizeof(vectors[0]));
+}
+
+AVID_TEST(hasher, createdHashersUseTheSelectedVariant)
+{
+    std::string data = sanityBuffer(2367);
+    const HashAlgorithm algorithms[] = { HashCrc32c, HashXxh3_64, HashXxh3_128, HashSha256 };
+    const Factory factories[] = { &crc32c, &xxh3_64, &xxh3_128, &sha256 };
+    const std::size_t selected[] = { Crc32c::supported().size() - 1, Xxh3::supported().size() - 1,
+                                     Xxh3::supported().size() - 1, Sha256::supported().size() - 1 };
+    for (std::size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); ++i)
+    {
+        std::unique_ptr<Hasher> created = Hasher::create(algorithms[i]);
+        std::unique_ptr<Hasher> chosen = factories[i](selected[i]);
+        CHECK(digestOf(*chosen, data, 0) == digestOf(*created, data, 0));
+    }
+}
@@ -0,0 +1,66 @@
+
+#include "Check.h"
+#include "ByteSum.h"
+#include "CheckSum.h"
+#include "File.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+AVID_TEST(largefile, readsAndSumsPastFourGigabytes)
+{
+    //! Haponov: a sparse file of 5 GB and a bit, with 1 MB of data across
+    //! the 4 GB mark and 1 MB at its very end; the holes read as zeros, so
+    //! the sum is twice the sum of the data
+    const std::uint64_t size = (5ull << 30) + 4097;
+    std::vector<char> data(1 << 20);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i * 7 + 0x80);
+    std::vector<std::uint64_t> offsets;
+    offsets.push_back((4ull << 30) - 1000);
+    offsets.push_back(size - data.size());
+
+    PathString path = Check::tempPath("large");
+    if (!CHECK(Check::writeSparse(path, size, offsets, data)))
+    {
+        Check::removeFile(path);
+        return;
+    }
+
+    File file(path);
+    std::uint64_t bytes = 0;
+    FileInfo info;
+    CHECK(file.size(bytes) && bytes == size);
+    CHECK(file.info(info) && info.identity.size == size);
+
+    // 64-bit offsets reach the data past 4 GB, and past the end is nothing
+    std::vector<char> read(4096);
+    CHECK_EQUAL(4096, file.readAt(4ull << 30, read.data(), read.size()));
+    CHECK(std::memcmp(read.data(), data.data() + 1000, read.size()) == 0);
+    CHECK_EQUAL(100, file.readAt(size - 100, read.data(), read.size()));
+    CHECK(std::memcmp(read.data(), data.data() + data.size() - 100, 100) == 0);
+    CHECK_EQUAL(0, file.readAt(size, read.data(), read.size()));
+
+    // the parallel and the sequential path, and one block read of a range
+    // as small as the block read limit past 4 GB
+    std::int64_t expected = 2 * ByteSum::scalar(data.data(), data.size());
+    ThreadPool pool(4);
+    std::int64_t parallel = 0;
+    std::int64_t sequential = 0;
+    std::int64_t legacy = 0;
+    CHECK(CheckSum::ofFile(file, size, &pool, parallel, CheckSum::Exact));
+    CHECK(CheckSum::ofFile(file, size, NULL, sequential, CheckSum::Exact));
+    CHECK(CheckSum::ofFile(file, size, &pool, legacy, CheckSum::LegacyEndOfFile));
+    CHECK_EQUAL(expected, parallel);
+    CHECK_EQUAL(expected, sequential);
+    CHECK_EQUAL(expected + static_cast<signed char>(data.back()), legacy);
+
+    std::int64_t range = 0;
+    CHECK(CheckSum::sumRange(file, 4ull << 30, CheckSum::blockReadLimit, range));
+    CHECK_EQUAL(ByteSum::scalar(data.data() + 1000, CheckSum::blockReadLimit), range);
+
+    file.close();
+    Check::removeFile(path);
+}
@@ -0,0 +1,119 @@
+
+#include "Check.h"
+#include "File.h"
+#include "ReadAhead.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    //! Haponov: bytes that tell every 4 KB page of the file apart
+    std::vector<char> pattern(std::size_t size)
+    {
+        std::vector<char> content(size);
+        for (std::size_t i = 0; i < size; ++i)
+            content[i] = static_cast<char>((i >> 12) * 31 + i);
+        return content;
+    }
+
+    PathString writeFile(const char* name, const std::vector<char>& content)
+    {
+        PathString path = Check::tempPath(name);
+        File out;
+        CHECK(out.createForAppend(path) && out.append(content.data(), content.size()));
+        return path;
+    }
+
+    //! Haponov: read [offset, offset + length) and compare it with content
+    void readAll(const File& file, const std::vector<char>& content, std::uint64_t offset,
+                 std::uint64_t length, std::size_t blockSize, unsigned depth,
+                 ReadAhead::Backend backend)
+    {
+        ReadAhead reader(file, offset, length, blockSize, depth, backend);
+        const char* data;
+        std::size_t read;
+        std::uint64_t done = 0;
+        while (reader.next(data, read))
+        {
+            if (done + read > length ||
+                std::memcmp(data, content.data() + offset + done, read) != 0)
+            {
+                Check::fail(__FILE__, __LINE__, std::string(ReadAhead::name(reader.backend())) +
+                            " block at " + std::to_string(done) + " of depth " + std::to_string(depth));
+                return;
+            }
+            done += read;
+        }
+        CHECK(!reader.failed());
+        CHECK_EQUAL(length, done);
+    }
+}
+
+AVID_TEST(readahead, blocksMatchTheFileInEveryBackend)
+{
+    std::vector<char> content = pattern((5 << 20) + 123);
+    PathString path = writeFile("readahead", content);
+    File file(path);
+    const ReadAhead::Backend backends[] = { ReadAhead::Blocking, ReadAhead::Native };
+    for (ReadAhead::Backend backend : backends)
+    {
+        for (unsigned depth : { 1u, 2u, 4u, 16u, 32u })
+        {
+            readAll(file, content, 0, content.size(), 1 << 20, depth, backend);
+            readAll(file, content, 4096, content.size() - 4096, 64 << 10, depth, backend);
+            readAll(file, content, 0, 100, 1 << 20, depth, backend);
+        }
+    }
+    file.close();
+    Check::removeFile(path);
+}
+
+AVID_TEST(readahead, stoppedWithReadsInFlight)
+{
+    //! Haponov: the reads still in flight are waited for before the
+    //! buffers go; the next reader of the thread gets a clean ring
+    std::vector<char> content = pattern(8 << 20);
+    PathString path = writeFile("inflight", content);
+    File file(path);
+    for (int i = 0; i < 50; ++i)
+    {
+        {
+            ReadAhead reader(file, 0, content.size(), 256 << 10, 8, ReadAhead::Native);
+            const char* data;
+            std::size_t read;
+            CHECK(reader.next(data, read));
+            CHECK(std::memcmp(data, content.data(), read) == 0);
+        }
+        readAll(file, content, 0, content.size(), 256 << 10, 8, ReadAhead::Native);
+    }
+    file.close();
+    Check::removeFile(path);
+}
+
+AVID_TEST(readahead, threadReusesItsRing)
+{
+    if (!ReadAhead::nativeAvailable())
+        return;
+    std::vector<char> content = pattern(4 << 20);
+    PathString path = writeFile("reuse", content);
+    File file(path);
+    readAll(file, content, 0, content.size(), 1 << 20, 4, ReadAhead::Native);
+
+    // The second reader sets nothing up: only the reads and waits are
+    // counted, fewer than the blocks and the ring calls of the first
+    IoCounters before = File::counters();
+    readAll(file, content, 0, content.size(), 1 << 20, 4, ReadAhead::Native);
+    IoCounters second = File::counters().since(before);
+    before = File::counters();
+    {
+        // a deeper reader than the ring takes needs one of its own
+        readAll(file, content, 0, content.size(), 64 << 10, 64, ReadAhead::Native);
+    }
+    IoCounters deeper = File::counters().since(before);
+    CHECK(second.reads <= 5);
+    CHECK(deeper.reads > second.reads);
+    file.close();
+    Check::removeFile(path);
+}
@@ -0,0 +1,123 @@
+
+#include "Check.h"
+#include "BatchChecker.h"
+#include "MonotonicArena.h"
+#include "ResultChannel.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const std::size_t batchFiles = 8;
+
+    //! Haponov: Waiting records of paths that are never opened
+    struct Batch
+    {
+        std::vector<PathString> paths;
+        std::vector<FileRecord> files;
+
+        Batch()
+        {
+            for (std::size_t i = 0; i < batchFiles; ++i)
+                paths.push_back(Check::tempPath(("record-" + std::to_string(i)).c_str()));
+            for (const PathString& path : paths)
+                files.push_back(FileRecord::waiting(path.c_str()));
+        }
+
+        std::size_t indexOf(const FileRecord& record) const
+        {
+            for (std::size_t i = 0; i < files.size(); ++i)
+                if (files[i].path == record.path)
+                    return i;
+            return files.size();
+        }
+    };
+
+    FileInfo infoOfSize(std::uint64_t size)
+    {
+        FileInfo info = FileInfo();
+        info.identity.size = size;
+        return info;
+    }
+}
+
+AVID_TEST(results, finishedFilesAreInTheOrderTheyFinish)
+{
+    Batch batch;
+    ResultChannel results;
+    results.reset(batch.files.data(), batch.files.size());
+
+    std::size_t index = 0;
+    CHECK(!results.finishedAt(0, index));
+    Digest digest = Digest();
+    results.describe(5, infoOfSize(5));
+    CHECK(!results.finishedAt(0, index));
+    results.check(5, false, digest);
+    results.fail(2);
+    results.checkDirectory(7, TreeTotals());
+
+    const std::size_t expected[] = { 5, 2, 7 };
+    for (std::size_t position = 0; position < 3; ++position)
+    {
+        CHECK(results.finishedAt(position, index));
+        CHECK_EQUAL(expected[position], index);
+    }
+    CHECK(!results.finishedAt(3, index));
+    CHECK(!results.finishedAt(batchFiles, index));
+    CHECK_EQUAL(3u, results.progress().finished);
+}
+
+AVID_TEST(results, collectGivesEveryRecordOnce)
+{
+    Batch batch;
+    ResultChannel results;
+    ThreadPool pool(2);
+    MonotonicArena memory;
+    JobGroup jobs;
+    BatchChecker checker(pool, memory, results, jobs, NULL);
+    checker.reset(batch.files.data(), batch.files.size(), HashAlaSum);
+
+    std::vector<unsigned> given(batchFiles, 0);
+    std::vector<std::size_t> order;
+    BatchChecker::RecordFunc record = [&batch, &given, &order](const FileRecord& finished)
+    {
+        std::size_t index = batch.indexOf(finished);
+        if (CHECK(index < batchFiles))
+        {
+            ++given[index];
+            order.push_back(index);
+        }
+    };
+
+    Digest digest = Digest();
+    CHECK(!checker.collectFinished(record));
+    CHECK(order.empty());
+
+    results.describe(3, infoOfSize(3));
+    results.check(3, false, digest);
+    results.fail(0);
+    CHECK(!checker.collectFinished(record));
+    CHECK_EQUAL(2u, order.size());
+
+    //! Haponov: only what finished since the last call is given
+    results.describe(6, infoOfSize(6));
+    results.check(6, false, digest);
+    results.describe(1, infoOfSize(1));
+    CHECK(!checker.collectFinished(record));
+    CHECK_EQUAL(3u, order.size());
+
+    //! Haponov: the rest are the ones that never finished, file 1 as far
+    //! as it got
+    checker.collectRest(record);
+    CHECK_EQUAL(batchFiles, order.size());
+    CHECK_EQUAL(3u, order[0]);
+    CHECK_EQUAL(0u, order[1]);
+    CHECK_EQUAL(6u, order[2]);
+    for (unsigned count : given)
+        CHECK_EQUAL(1u, count);
+    CHECK(checker.collectFinished(record));
+    CHECK_EQUAL(batchFiles, order.size());
+}
@@ -0,0 +1,183 @@
+
+#include "Check.h"
+#include "FileRecord.h"
+#include "ResultExport.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+    //! Haponov: ASCII text as a native path
+    PathString pathOf(const char* text)
+    {
+        PathString path;
+        for (; *text; ++text)
+            path += static_cast<PathChar>(*text);
+        return path;
+    }
+
+    //! Haponov: what the export of records in format writes to a file
+    std::string exported(ExportFormat format, const std::vector<FileRecord>& records)
+    {
+        PathString path = Check::tempPath("export");
+        {
+            File out;
+            CHECK(out.createForAppend(path));
+            ResultExport writer(out, format, HashCrc32c);
+            CHECK(writer.begin());
+            for (const FileRecord& record : records)
+                CHECK(writer.write(record));
+            CHECK(writer.end());
+            CHECK_EQUAL(std::uint64_t(records.size()), writer.records());
+        }
+        std::string text = Check::readFile(path);
+        Check::removeFile(path);
+        return text;
+    }
+
+    std::string exported(ExportFormat format, const FileRecord& record)
+    {
+        return exported(format, std::vector<FileRecord>(1, record));
+    }
+
+    //! Haponov: a file checked to the CRC-32C e3069283
+    FileRecord checkedFile(const PathChar* path)
+    {
+        FileRecord record = FileRecord::waiting(path);
+        record.stage = FileRecord::Checked;
+        record.size = 9;
+        Digest digest = { HashCrc32c, 4, { 0xe3, 0x06, 0x92, 0x83 } };
+        record.setChecksum(digest);
+        return record;
+    }
+
+    const char* const csvHeader =
+        "path,name,type,status,size,created,algorithm,checksum,files,folders,unreadable\r\n";
+}
+
+AVID_TEST(export, quotesBackslashesAndControlCharactersAreEscaped)
+{
+    PathString path = pathOf("/x/a \"b\" c\\d\te\nf\x1f");
+    FileRecord record = FileRecord::waiting(path.c_str());
+
+    //! Haponov: CSV doubles the quotes and keeps the rest inside them, JSON
+    //! escapes quotes and backslashes and writes control characters as \u
+    std::string csv = exported(ExportCsv, record);
+    CHECK(csv == std::string(csvHeader) +
+                 "\"/x/a \"\"b\"\" c\\d\te\nf\x1f\",\"d\te\nf\x1f\",\"file\",\"skipped\",,,,,,,\r\n");
+    std::string ndjson = exported(ExportNdjson, record);
+    CHECK(ndjson == "{\"path\":\"/x/a \\\"b\\\" c\\\\d\\u0009e\\u000af\\u001f\","
+                    "\"name\":\"d\\u0009e\\u000af\\u001f\",\"type\":\"file\",\"status\":\"skipped\"}\n");
+}
+
+AVID_TEST(export, everyStatusHasItsWordAndFields)
+{
+    PathString paths[] = { pathOf("/x/skipped"), pathOf("/x/stopped"), pathOf("/x/ok"),
+                           pathOf("/x/unreadable"), pathOf("/x/error"), pathOf("/x/folder") };
+    std::vector<FileRecord> records;
+    records.push_back(FileRecord::waiting(paths[0].c_str()));
+
+    FileRecord stopped = FileRecord::waiting(paths[1].c_str());
+    stopped.stage = FileRecord::Described;
+    stopped.size = 7;
+    //! Haponov: 10^9 seconds after 1970
+    stopped.creationTime = 1000000000000000000ull;
+    records.push_back(stopped);
+
+    records.push_back(checkedFile(paths[2].c_str()));
+
+    FileRecord unreadable = FileRecord::waiting(paths[3].c_str());
+    unreadable.stage = FileRecord::Checked;
+    unreadable.size = 3;
+    records.push_back(unreadable);
+
+    FileRecord failed = FileRecord::waiting(paths[4].c_str());
+    failed.stage = FileRecord::Failed;
+    records.push_back(failed);
+
+    FileRecord folder = FileRecord::waiting(paths[5].c_str());
+    folder.stage = FileRecord::Checked;
+    folder.directory = true;
+    folder.size = 10;
+    folder.tree.files = 2;
+    folder.tree.directories = 1;
+    folder.tree.unreadable = 0;
+    folder.tree.checksum = 0x0123456789abcdefull;
+    records.push_back(folder);
+
+    CHECK(exported(ExportCsv, records) == std::string(csvHeader) +
+          "\"/x/skipped\",\"skipped\",\"file\",\"skipped\",,,,,,,\r\n"
+          "\"/x/stopped\",\"stopped\",\"file\",\"stopped\",7,\"2001-09-09T01:46:40Z\",,,,,\r\n"
+          "\"/x/ok\",\"ok\",\"file\",\"ok\",9,,\"crc32c\",\"e3069283\",,,\r\n"
+          "\"/x/unreadable\",\"unreadable\",\"file\",\"unreadable\",3,,,,,,\r\n"
+          "\"/x/error\",\"error\",\"file\",\"error\",,,,,,,\r\n"
+          "\"/x/folder\",\"folder\",\"folder\",\"ok\",10,,\"crc32c\",\"0123456789abcdef\",2,1,0\r\n");
+
+    //! Haponov: JSON leaves the fields without a value out
+    CHECK(exported(ExportNdjson, records) ==
+          "{\"path\":\"/x/skipped\",\"name\":\"skipped\",\"type\":\"file\",\"status\":\"skipped\"}\n"
+          "{\"path\":\"/x/stopped\",\"name\":\"stopped\",\"type\":\"file\",\"status\":\"stopped\","
+          "\"size\":7,\"created\":\"2001-09-09T01:46:40Z\"}\n"
+          "{\"path\":\"/x/ok\",\"name\":\"ok\",\"type\":\"file\",\"status\":\"ok\",\"size\":9,"
+          "\"algorithm\":\"crc32c\",\"checksum\":\"e3069283\"}\n"
+          "{\"path\":\"/x/unreadable\",\"name\":\"unreadable\",\"type\":\"file\","
+          "\"status\":\"unreadable\",\"size\":3}\n"
+          "{\"path\":\"/x/error\",\"name\":\"error\",\"type\":\"file\",\"status\":\"error\"}\n"
+          "{\"path\":\"/x/folder\",\"name\":\"folder\",\"type\":\"folder\",\"status\":\"ok\","
+          "\"size\":10,\"algorithm\":\"crc32c\",\"checksum\":\"0123456789abcdef\","
+          "\"files\":2,\"folders\":1,\"unreadable\":0}\n");
+}
+
+AVID_TEST(export, jsonArraySeparatesItsObjects)
+{
+    PathString first = pathOf("/x/first");
+    PathString second = pathOf("/x/second");
+    std::vector<FileRecord> records;
+    CHECK(exported(ExportJson, records) == "[\n]\n");
+    CHECK(exported(ExportNdjson, records).empty());
+    CHECK(exported(ExportCsv, records) == csvHeader);
+
+    records.push_back(FileRecord::waiting(first.c_str()));
+    const std::string object =
+        "{\"path\":\"/x/first\",\"name\":\"first\",\"type\":\"file\",\"status\":\"skipped\"}";
+    CHECK(exported(ExportJson, records) == "[\n" + object + "\n]\n");
+
+    records.push_back(checkedFile(second.c_str()));
+    CHECK(exported(ExportJson, records) == "[\n" + object + ",\n"
+          "{\"path\":\"/x/second\",\"name\":\"second\",\"type\":\"file\",\"status\":\"ok\",\"size\":9,"
+          "\"algorithm\":\"crc32c\",\"checksum\":\"e3069283\"}\n]\n");
+}
+
+#ifdef _WIN32
+AVID_TEST(export, longPathPrefixIsLeftOut)
+{
+    PathString share = L"\\\\?\\UNC\\server\\share\\a.txt";
+    PathString drive = L"\\\\?\\C:\\a.txt";
+    std::string csv = exported(ExportCsv, FileRecord::waiting(share.c_str()));
+    CHECK(csv.find("\"\\\\server\\share\\a.txt\",\"a.txt\"") != std::string::npos);
+    std::string json = exported(ExportNdjson, FileRecord::waiting(share.c_str()));
+    CHECK(json.find("\"path\":\"\\\\\\\\server\\\\share\\\\a.txt\"") != std::string::npos);
+    csv = exported(ExportCsv, FileRecord::waiting(drive.c_str()));
+    CHECK(csv.find("\"C:\\a.txt\",\"a.txt\"") != std::string::npos);
+}
+
+AVID_TEST(export, loneSurrogateBecomesTheReplacementCharacter)
+{
+    //! Haponov: a lone high and a lone low surrogate, then a pair
+    PathString path = L"C:\\a\xD800" L"b\xDC00" L"c\xD83D\xDE00";
+    std::string csv = exported(ExportCsv, FileRecord::waiting(path.c_str()));
+    CHECK(csv.find("\"C:\\a\xEF\xBF\xBD" "b\xEF\xBF\xBD" "c\xF0\x9F\x98\x80\"") != std::string::npos);
+}
+#else
+AVID_TEST(export, pathsAreWrittenAsTheyAre)
+{
+    //! Haponov: POSIX has no long path prefix, and its paths are UTF-8
+    //! already, valid or not
+    PathString path = "\\\\?\\UNC\\server/caf\xC3\xA9\xFF";
+    std::string csv = exported(ExportCsv, FileRecord::waiting(path.c_str()));
+    CHECK(csv == std::string(csvHeader) + "\"\\\\?\\UNC\\server/caf\xC3\xA9\xFF\",\"caf\xC3\xA9\xFF\","
+                 "\"file\",\"skipped\",,,,,,,\r\n");
+}
+#endif
@@ -0,0 +1,32 @@
+
+#include "Check.h"
+#include "TextFormat.h"
+
+#include <cstring>
+
+AVID_TEST(textformat, groupsDigitsInThrees)
+{
+    char text[TextFormat::groupedSize];
+    CHECK_EQUAL(1u, TextFormat::grouped(0, text));
+    CHECK(std::strcmp(text, "0") == 0);
+    TextFormat::grouped(999, text);
+    CHECK(std::strcmp(text, "999") == 0);
+    TextFormat::grouped(1000, text);
+    CHECK(std::strcmp(text, "1 000") == 0);
+    TextFormat::grouped(8589934592ull, text);
+    CHECK(std::strcmp(text, "8 589 934 592") == 0);
+    CHECK_EQUAL(TextFormat::groupedSize - 1, TextFormat::grouped(UINT64_MAX, text));
+    CHECK(std::strcmp(text, "18 446 744 073 709 551 615") == 0);
+}
+
+AVID_TEST(textformat, writesUtcTimes)
+{
+    char text[TextFormat::utcTimeSize];
+    CHECK_EQUAL(20u, TextFormat::utcTime(0, text));
+    CHECK(std::strcmp(text, "1970-01-01T00:00:00Z") == 0);
+    // the day after February 29th of a leap year, and one second before 2038
+    TextFormat::utcTime(951868800ull * 1000000000ull, text);
+    CHECK(std::strcmp(text, "2000-03-01T00:00:00Z") == 0);
+    TextFormat::utcTime(2147483647ull * 1000000000ull + 999999999ull, text);
+    CHECK(std::strcmp(text, "2038-01-19T03:14:07Z") == 0);
+}
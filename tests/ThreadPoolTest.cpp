@@ -0,0 +1,131 @@
+
+#include "Check.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::uint64_t nextRandom(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //! Haponov: true once done reaches count, false after a few seconds -
+    //! a job lost to a retiring thread is never run, so waiting for a
+    //! JobGroup would hang the test instead of failing it
+    bool waitFor(const std::atomic<unsigned>& done, unsigned count)
+    {
+        std::chrono::steady_clock::time_point until =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (done.load() < count)
+        {
+            if (std::chrono::steady_clock::now() > until)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    //! Haponov: true once the pool is idle, false after a few seconds - a
+    //! job has told its group it is done before its thread counts it out
+    bool waitForIdle(ThreadPool& pool)
+    {
+        std::chrono::steady_clock::time_point until =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!pool.idle())
+        {
+            if (std::chrono::steady_clock::now() > until)
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    //! Haponov: bursts of jobs with pauses around the idle timeout, so the
+    //! threads retire while jobs are being pushed; some jobs push more
+    void bursts(ThreadPool::Scheduling scheduling)
+    {
+        ThreadPool pool(3, std::chrono::milliseconds(1), scheduling);
+        std::uint64_t state = scheduling;
+        for (int burst = 0; burst < 500; ++burst)
+        {
+            std::atomic<unsigned> done(0);
+            unsigned jobs = 1 + static_cast<unsigned>(nextRandom(state) % 8);
+            unsigned expected = jobs;
+            for (unsigned j = 0; j < jobs; ++j)
+            {
+                bool nested = nextRandom(state) % 4 == 0;
+                pool.doJob([&pool, &done, nested]()
+                {
+                    if (nested)
+                        pool.doJob([&done]() { ++done; });
+                    ++done;
+                });
+                if (nested)
+                    ++expected;
+            }
+            if (!CHECK(waitFor(done, expected)))
+                return;
+
+            //! Haponov: 0-2 ms, so the threads time out at different moments
+            //! of the next burst
+            std::this_thread::sleep_for(std::chrono::microseconds(nextRandom(state) % 2000));
+        }
+    }
+}
+
+AVID_TEST(threadpool, jobsOfABatchAllRun)
+{
+    ThreadPool pool(4, ThreadPool::WorkStealing);
+    JobGroup group;
+    std::atomic<unsigned> done(0);
+    for (int i = 0; i < 1000; ++i)
+        pool.doJob(group, [&done]() { ++done; });
+    group.wait();
+    CHECK_EQUAL(1000u, done.load());
+    CHECK(waitForIdle(pool));
+}
+
+AVID_TEST(threadpool, cancelledBatchDropsQueuedJobs)
+{
+    //! Haponov: the one thread is held by a job outside the batch until the
+    //! batch is cancelled, so none of the batch jobs has started
+    ThreadPool pool(1);
+    std::atomic<bool> release(false);
+    std::atomic<bool> holding(false);
+    pool.doJob([&release, &holding]()
+    {
+        holding = true;
+        while (!release)
+            std::this_thread::yield();
+    });
+    while (!holding)
+        std::this_thread::yield();
+
+    JobGroup group;
+    std::atomic<unsigned> done(0);
+    for (int i = 0; i < 10; ++i)
+        pool.doJob(group, [&done]() { ++done; });
+    group.cancel();
+    release = true;
+    group.wait();
+    CHECK_EQUAL(0u, done.load());
+}
+
+AVID_TEST(threadpool, sharedQueueSurvivesRetiringThreads)
+{
+    bursts(ThreadPool::SharedQueue);
+}
+
+AVID_TEST(threadpool, workStealingSurvivesRetiringThreads)
+{
+    bursts(ThreadPool::WorkStealing);
+}
@@ -0,0 +1,170 @@
+/****************************** Module Header ******************************\
+Module Name:  avidtests.cpp
+Project:      CppShellExtContextMenuHandler
+
+Runs the tests of the core.
+
+    avidtests [suite ...]
+
+Every test of the named suites, or of all of them, runs in the order it was
+registered; a failed check is printed with its file and line. The exit code
+is 0 when every check passed, 1 otherwise, 2 for a suite nobody registered.
+
+\***************************************************************************/
+
+#include "Check.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct Registered
+    {
+        const char* suite;
+        const char* name;
+        Check::Test test;
+    };
+
+    //! Haponov: filled by the static Check objects before main
+    std::vector<Registered>& registered()
+    {
+        static std::vector<Registered> tests;
+        return tests;
+    }
+
+    unsigned failures = 0;
+}
+
+Check::Check(const char* suite, const char* name, Test test)
+{
+    Registered entry = { suite, name, test };
+    registered().push_back(entry);
+}
+
+bool Check::fail(const char* file, int line, const std::string& what)
+{
+    ++failures;
+    std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, what.c_str());
+    return false;
+}
+
+PathString Check::tempPath(const char* name)
+{
+#ifdef _WIN32
+    wchar_t folder[MAX_PATH + 1];
+    DWORD length = GetTempPathW(MAX_PATH + 1, folder);
+    PathString path(folder, length <= MAX_PATH ? length : 0);
+    path += L"avidtests-" + std::to_wstring(GetCurrentProcessId()) + L"-";
+    for (; *name; ++name)
+        path += static_cast<wchar_t>(*name);
+    return path;
+#else
+    const char* folder = std::getenv("TMPDIR");
+    PathString path = folder && *folder ? folder : "/tmp";
+    return path + "/avidtests-" + std::to_string(getpid()) + "-" + name;
+#endif
+}
+
+bool Check::writeSparse(const PathString& path, std::uint64_t size,
+                        const std::vector<std::uint64_t>& offsets,
+                        const std::vector<char>& data)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    DWORD returned;
+    bool ok = DeviceIoControl(file, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL) != 0;
+    for (std::size_t i = 0; ok && i < offsets.size(); ++i)
+    {
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(offsets[i]);
+        DWORD written = 0;
+        ok = SetFilePointerEx(file, position, NULL, FILE_BEGIN) &&
+             WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, NULL) &&
+             written == data.size();
+    }
+    LARGE_INTEGER end;
+    end.QuadPart = static_cast<LONGLONG>(size);
+    ok = ok && SetFilePointerEx(file, end, NULL, FILE_BEGIN) && SetEndOfFile(file);
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+    bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0;
+    for (std::size_t i = 0; ok && i < offsets.size(); ++i)
+        ok = pwrite(fd, data.data(), data.size(), static_cast<off_t>(offsets[i])) ==
+             static_cast<ssize_t>(data.size());
+    ok = ::close(fd) == 0 && ok;
+    return ok;
+#endif
+}
+
+std::string Check::readFile(const PathString& path)
+{
+    File file(path);
+    std::uint64_t size = 0;
+    if (!file.isOpen() || !file.size(size))
+        return std::string();
+    std::string content(static_cast<std::size_t>(size), '\0');
+    if (size && file.readAt(0, &content[0], content.size()) != static_cast<std::int64_t>(size))
+        return std::string();
+    return content;
+}
+
+void Check::removeFile(const PathString& path)
+{
+#ifdef _WIN32
+    DeleteFileW(path.c_str());
+#else
+    unlink(path.c_str());
+#endif
+}
+
+unsigned Check::run(int suiteCount, const char* const* suites)
+{
+    for (const Registered& test : registered())
+    {
+        bool wanted = !suiteCount;
+        for (int i = 0; i < suiteCount && !wanted; ++i)
+            wanted = std::strcmp(suites[i], test.suite) == 0;
+        if (!wanted)
+            continue;
+
+        unsigned before = failures;
+        test.test();
+        std::fprintf(stderr, "%s %s.%s\n", failures == before ? "passed" : "FAILED",
+                     test.suite, test.name);
+    }
+    return failures;
+}
+
+int main(int argc, char** argv)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        bool known = false;
+        for (const Registered& test : registered())
+            known = known || std::strcmp(argv[i], test.suite) == 0;
+        if (!known)
+        {
+            std::fprintf(stderr, "avidtests: no suite %s\n", argv[i]);
+            return 2;
+        }
+    }
+    return Check::run(argc - 1, argv + 1) ? 1 : 0;
+}